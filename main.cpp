@@ -8,11 +8,117 @@
 
 #include "TXLib.h"
 #include "mechanics/Classes.h"
+#include "mechanics/Quadtree.h"
+#include "mechanics/Ensemble.h"
+#include "mechanics/Volume.h"
+#include "mechanics/Decomposition.h"
+#include "mechanics/OutOfCore.h"
+
+//----------------------------------------------------------------------------
+//{ Defines (typedefs)
+//----------------------------------------------------------------------------
+
+    // Command line options of the simulation (see main()):
+    struct SimulationOptions
+    {
+        unsigned int threads;
+
+        double sparseEpsilon;
+
+        // 0 steps explicitly, N takes implicit steps of N * TIME_STEP:
+        unsigned int implicitSteps;
+        unsigned int implicitCycle;
+
+        // 0 steps by TIME_STEP, N advances by N * TIME_STEP with the largest stable steps,
+        // with a tolerance their local error is controlled too:
+        unsigned int advanceSteps;
+        double       advanceTolerance;
+
+        // Implicit steps are alternating direction ones instead of PCG solves:
+        bool alternatingDirections;
+
+        // The long steps are explicit RKL2 super steps instead of implicit ones:
+        bool superTimeStepping;
+
+        // The long steps are explicit ones where every tile sub-cycles at its own rate:
+        bool localTimeStepping;
+
+        // Starts from the equilibrium instead of the initial conditions:
+        bool steadyState;
+
+        // The equilibrium comes from red-black SOR in place instead of multigrid PCG:
+        bool relaxation;
+
+        // 0 starts cold, N warm starts from PREVIEW_TIME simulated on N x N blocks:
+        unsigned int previewFactor;
+
+        // Simulates on an adaptive quadtree instead of the full grid:
+        bool adaptiveMesh;
+
+        // Shape of the explicit stencil (see Field::setStencil()):
+        unsigned char stencilShape;
+
+        // 0 simulates one scene, N that many brush strengths side by side (see Ensemble.h):
+        unsigned int ensembleMembers;
+
+        // 0 simulates the map, N a volume of N layers extruded from it (see Volume.h):
+        unsigned int volumeDepth;
+
+        // 0 simulates in this process, N splits the map between N processes (see Decomposition.h);
+        // the processes rank 0 launches get their rank and the id of the run:
+        unsigned int ranks;
+        unsigned int rank;
+        unsigned int run;
+
+        // Resumes from this checkpoint when it exists and keeps it up to date (nullptr for none):
+        const char* checkpointFileName;
+
+        // Simulates from band files in this directory instead of memory (nullptr for none, see OutOfCore.h):
+        const char* bandsDirectory;
+
+        // Every screenshot also saves the temperatures within this bound (0 for none, see Snapshot.h):
+        double snapshotErrorBound;
+    };
+
+//}
+//-----------------------------------------------------------------------------
+
 
 //----------------------------------------------------------------------------
 //{ Function prototypes
 //----------------------------------------------------------------------------
 
+    template <typename Real>
+    void simulate(const SimulationOptions& options);
+
+    template <typename Real>
+    void simulateAdaptive();
+
+    template <typename Real>
+    void simulateEnsemble(const SimulationOptions& options);
+
+    template <typename Real>
+    void simulateVolume(const SimulationOptions& options);
+
+    template <typename Real>
+    void simulateDecomposed(const SimulationOptions& options);
+
+    template <typename Real>
+    void simulateOutOfCore(const SimulationOptions& options);
+
+    template <typename Real>
+    void reportScaling();
+
+    template <typename Real>
+    bool reportVerification(const unsigned int threads);
+
+    template <typename Real>
+    DWORD WINAPI stepVerifiedRank(LPVOID subdomain);
+
+    double seconds();
+
+    const char* conflictingOptions(const SimulationOptions& options, const bool scaling, const bool verify);
+
     void saveScreenshot
     (
         const char* fileName,
@@ -56,28 +162,264 @@
 
     const unsigned int ZOOM = 3;
 
+    const unsigned int SCALING_STEPS = 2000;
+
+    // --verify heats VERIFY_ROUNDS times, VERIFY_STEPS steps apart (one pass of the bands each):
+    const unsigned int VERIFY_ROUNDS = 50;
+    const unsigned int VERIFY_STEPS  = OUT_OF_CORE_DEPTH;
+
+    // Its subdomains (threads of this process), band height (the last band comes out shorter)
+    // and ensemble members (member 1 heats at half strength, so member 0 shows any cross-talk):
+    const unsigned int VERIFY_RANKS       = 3;
+    const size_t       VERIFY_BAND_HEIGHT = 64;
+    const size_t       VERIFY_MEMBERS     = 2;
+
+    // Where --verify writes its bands (left there, the next --verify overwrites them):
+    const char VERIFY_BANDS_DIRECTORY[] = "resources/verify";
+
+    // Simulated by --preview before the full grid takes over:
+    const double PREVIEW_TIME = 100000;
+
+    // Rendered frames between two checkpoints of --checkpoint:
+    const unsigned int CHECKPOINT_FRAMES = 10;
+
 //}
 //-----------------------------------------------------------------------------
 
 
-int main()
+int main(int argc, char** argv)
+{
+    // Options: --float (single precision is enough when we only look at the picture),
+    //          --threads N, --scaling (prints the thread scaling curve instead of simulating),
+    //          --verify (steps Subdomain, BandedField and Ensemble beside Field, prints how far they differ),
+    //          --sparse EPSILON (skips tiles that change by less than EPSILON per step),
+    //          --implicit N (backward Euler steps of N * TIME_STEP, stable for any N),
+    //          --multigrid V|W (multigrid cycles precondition the implicit steps),
+    //          --advance N (explicit frames of N * TIME_STEP in the largest stable steps),
+    //          --tolerance TOL (the local error of those steps stays below TOL),
+    //          --adi (implicit steps are alternating direction ones),
+    //          --rkl (the --implicit N steps are explicit super steps instead),
+    //          --local (the --implicit N steps are explicit, with local time steps per tile),
+    //          --steady (jumps to the equilibrium before simulating),
+    //          --sor (jumps to the equilibrium by over-relaxation, without extra memory),
+    //          --preview N (warm starts from a preview on N x N blocks, N is 4 or 8),
+    //          --stencil 5|9|4 (5-point, isotropic 9-point or fourth order explicit steps),
+    //          --ensemble N (N brush strengths at once, only --threads applies),
+    //          --volume N (N layers in 3D, only --threads applies, arrows pick the layer shown),
+    //          --ranks N (the map split between N processes, the other options are ignored),
+    //          --checkpoint FILE (resumes from FILE if it exists, saves to it every few frames and on Escape),
+    //          --bands DIR (the grid streamed from band files in DIR, only --threads applies),
+    //          --snapshots BOUND (every screenshot saves the temperatures compressed within BOUND degrees),
+    //          --amr (adaptive quadtree mesh, the other options are ignored).
+    //
+    //          --scaling, --verify, --amr, --ensemble, --volume, --bands and --ranks pick one mode each, --adi, --rkl
+    //          and --local one kind of --implicit step; combinations that would quietly override
+    //          each other or drop --stencil are refused (see conflictingOptions()).
+
+    bool singlePrecision = false;
+    bool scaling         = false;
+    bool verify          = false;
+
+    SimulationOptions options = {1, 0, 0, NO_MULTIGRID, 0, 0, false, false, false, false, false, 0, false, STENCIL_5_POINT, 0, 0, 0, 0, 0, nullptr, nullptr, 0};
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--float")   == 0) singlePrecision = true;
+        if (strcmp(argv[arg], "--scaling") == 0) scaling         = true;
+        if (strcmp(argv[arg], "--verify")  == 0) verify          = true;
+
+        if (strcmp(argv[arg], "--threads")  == 0 && arg + 1 < argc) options.threads       = atoi(argv[++arg]);
+        if (strcmp(argv[arg], "--sparse")   == 0 && arg + 1 < argc) options.sparseEpsilon = atof(argv[++arg]);
+        if (strcmp(argv[arg], "--implicit") == 0 && arg + 1 < argc) options.implicitSteps = atoi(argv[++arg]);
+
+        if (strcmp(argv[arg], "--advance")   == 0 && arg + 1 < argc) options.advanceSteps     = atoi(argv[++arg]);
+        if (strcmp(argv[arg], "--tolerance") == 0 && arg + 1 < argc) options.advanceTolerance = atof(argv[++arg]);
+        if (strcmp(argv[arg], "--preview")   == 0 && arg + 1 < argc) options.previewFactor    = atoi(argv[++arg]);
+        if (strcmp(argv[arg], "--ensemble")  == 0 && arg + 1 < argc) options.ensembleMembers  = atoi(argv[++arg]);
+        if (strcmp(argv[arg], "--volume")    == 0 && arg + 1 < argc) options.volumeDepth      = atoi(argv[++arg]);
+        if (strcmp(argv[arg], "--ranks")     == 0 && arg + 1 < argc) options.ranks            = atoi(argv[++arg]);
+        if (strcmp(argv[arg], "--rank")      == 0 && arg + 1 < argc) options.rank             = atoi(argv[++arg]);
+        if (strcmp(argv[arg], "--run")       == 0 && arg + 1 < argc) options.run              = atoi(argv[++arg]);
+
+        if (strcmp(argv[arg], "--checkpoint") == 0 && arg + 1 < argc) options.checkpointFileName = argv[++arg];
+        if (strcmp(argv[arg], "--bands")      == 0 && arg + 1 < argc) options.bandsDirectory     = argv[++arg];
+        if (strcmp(argv[arg], "--snapshots")  == 0 && arg + 1 < argc) options.snapshotErrorBound = atof(argv[++arg]);
+
+        if (strcmp(argv[arg], "--multigrid") == 0 && arg + 1 < argc) options.implicitCycle = (argv[++arg][0] == 'W')? MULTIGRID_W_CYCLE : MULTIGRID_V_CYCLE;
+        if (strcmp(argv[arg], "--stencil")   == 0 && arg + 1 < argc) options.stencilShape  = (argv[++arg][0] == '9')? STENCIL_9_POINT   :
+                                                                                             (argv[  arg][0] == '4')? STENCIL_4TH_ORDER : STENCIL_5_POINT;
+
+        if (strcmp(argv[arg], "--adi")    == 0) options.alternatingDirections = true;
+        if (strcmp(argv[arg], "--rkl")    == 0) options.superTimeStepping     = true;
+        if (strcmp(argv[arg], "--local")  == 0) options.localTimeStepping     = true;
+        if (strcmp(argv[arg], "--steady") == 0) options.steadyState           = true;
+        if (strcmp(argv[arg], "--sor")    == 0) options.relaxation            = true;
+        if (strcmp(argv[arg], "--amr")    == 0) options.adaptiveMesh          = true;
+    }
+
+    if (options.threads == 0) options.threads = hardwareThreads();
+
+    const char* conflict = conflictingOptions(options, scaling, verify);
+
+    if (conflict != nullptr)
+    {
+        printf("[OPTIONS REFUSED: %s]\n", conflict);
+        return 1;
+    }
+
+    // Only rank 0 renders, the processes it launches work without a window of their own:
+    if (options.ranks <= 1 || options.rank == 0)
+    {
+        txCreateWindow(ARRAY_WIDTH * ZOOM, ARRAY_HEIGHT * ZOOM);
+        txTextCursor(false);
+    }
+
+    printf("[STENCIL: %s %s, %s, %d threads]\n", stencilName(options.stencilShape), isaName(stencilIsa()), (singlePrecision)? "float" : "double", options.threads);
+
+    if (scaling)
+    {
+        if (singlePrecision) reportScaling<float>();
+        else                 reportScaling<double>();
+
+        return 0;
+    }
+
+    if (verify)
+    {
+        const bool identical = (singlePrecision)? reportVerification<float> (options.threads) :
+                                                  reportVerification<double>(options.threads);
+
+        return (identical)? 0 : 1;
+    }
+
+    if (options.adaptiveMesh)
+    {
+        if (singlePrecision) simulateAdaptive<float> ();
+        else                 simulateAdaptive<double>();
+
+        return 0;
+    }
+
+    if (options.ensembleMembers > 0)
+    {
+        if (singlePrecision) simulateEnsemble<float> (options);
+        else                 simulateEnsemble<double>(options);
+
+        return 0;
+    }
+
+    if (options.volumeDepth > 0)
+    {
+        if (singlePrecision) simulateVolume<float> (options);
+        else                 simulateVolume<double>(options);
+
+        return 0;
+    }
+
+    if (options.bandsDirectory != nullptr)
+    {
+        if (singlePrecision) simulateOutOfCore<float> (options);
+        else                 simulateOutOfCore<double>(options);
+
+        return 0;
+    }
+
+    if (options.ranks > 1)
+    {
+        if (singlePrecision) simulateDecomposed<float> (options);
+        else                 simulateDecomposed<double>(options);
+
+        return 0;
+    }
+
+    if (singlePrecision) simulate<float> (options);
+    else                 simulate<double>(options);
+
+    return 0;
+}
+
+template <typename Real>
+void simulate(const SimulationOptions& options)
 {
-    txCreateWindow(ARRAY_WIDTH * ZOOM, ARRAY_HEIGHT * ZOOM);
-    txTextCursor(false);
+    // Calculations done and time simulated, kept by checkpoints:
+    unsigned long long steps = 0;
+    double             time  = 0;
+
+    FILE* existing = (options.checkpointFileName != nullptr)? fopen(options.checkpointFileName, "rb") : nullptr;
+
+    Checkpoint<Real>* checkpoint = nullptr;
+
+    if (existing != nullptr)
+    {
+        fclose(existing);
+
+        // A checkpoint that cannot be resumed (Checkpoint reports why) is overwritten by a fresh run:
+        checkpoint = new Checkpoint<Real>(options.checkpointFileName);
+
+        if (!checkpoint->valid())
+        {
+            puts("[CHECKPOINT IGNORED, STARTING FRESH]");
+
+            delete checkpoint;
+            checkpoint = nullptr;
+        }
+    }
+
+    const bool resumed = (checkpoint != nullptr);
+
+    Field<Real>* field = (resumed)? new Field<Real>(checkpoint, "resources/images/hook.bmp", &steps, &time) :
+                                    new Field<Real>("resources/conductivity/hook.bmp", "resources/obstacles/hook.bmp", "resources/images/hook.bmp", ARRAY_WIDTH, ARRAY_HEIGHT, 0, 0, NULL);
+
+    Field<Real>& test = *field;
+
+    if (resumed) printf("[RESUMED: %llu steps, %.0f s simulated]\n", steps, time);
+
+    test.setThreads(options.threads);
 
-    Field test = Field("resources/conductivity/hook.bmp", "resources/obstacles/hook.bmp", "resources/images/hook.bmp", ARRAY_WIDTH, ARRAY_HEIGHT, 0, 0, NULL);
+    if (options.sparseEpsilon > 0) test.setSparse(options.sparseEpsilon);
+
+    // A resumed field keeps its compiled weights unless the stencil changes:
+    if (test.stencil() != options.stencilShape) test.setStencil(options.stencilShape);
+
+    test.setImplicitMultigrid(options.implicitCycle);
+
+    if (options.steadyState && !resumed) printf("[STEADY STATE: %d iterations]\n", test.solveSteadyState());
+    if (options.relaxation  && !resumed) printf("[STEADY STATE: %d sweeps]\n",     test.relaxSteadyState());
+
+    if (options.previewFactor >= 2 && !resumed)
+    {
+        printf("[PREVIEW: %d coarse steps]\n", test.preview(options.previewFactor, PREVIEW_TIME));
+
+        txBegin();
+
+        test.render(ZOOM);
+
+        txEnd();
+    }
+
+    // One implicit step or advance stands for that many explicit ones, and so does the heating:
+    const unsigned int stepsPerCalculation = (options.implicitSteps > 0)? options.implicitSteps :
+                                             (options.advanceSteps  > 0)? options.advanceSteps  : 1;
 
     puts("[SIMULATION MODE]");
 
-    for (unsigned int counter = 0, screenShotCounter = 0, screenShotNumber = 0; !GetAsyncKeyState(VK_ESCAPE); counter++)
+    for (unsigned int counter = 0, screenShotCounter = 0, screenShotNumber = 0, frames = 0; !GetAsyncKeyState(VK_ESCAPE); counter++)
     {
         // Conditions setting:
         if (GetAsyncKeyState(VK_RETURN)) test.editorMode(4, 100, ZOOM);
 
-        test.adjustTemperature(105, 150, 7, 10);
+        test.adjustTemperature(105, 150, 7, 10 * stepsPerCalculation);
 
         // Calculations:
-        test.calculate();
+        if      (options.implicitSteps > 0 && options.alternatingDirections) test.calculateAdi      (options.implicitSteps * TIME_STEP);
+        else if (options.implicitSteps > 0 && options.superTimeStepping)     test.calculateSuperStep(options.implicitSteps * TIME_STEP);
+        else if (options.implicitSteps > 0 && options.localTimeStepping)     test.calculateLocal    (options.implicitSteps * TIME_STEP);
+        else if (options.implicitSteps > 0)                                  test.calculateImplicit (options.implicitSteps * TIME_STEP);
+        else if (options.advanceSteps  > 0)                                  test.advance           (options.advanceSteps  * TIME_STEP, options.advanceTolerance);
+        else                                                                 test.calculate();
+
+        steps++;
+        time += (options.implicitSteps > 0 || options.advanceSteps > 0)? stepsPerCalculation * TIME_STEP : test.timeStep();
 
         // Rendering:
         if (counter == 500)
@@ -86,6 +428,10 @@ int main()
 
             screenShotCounter++;
 
+            frames++;
+
+            if (options.checkpointFileName != nullptr && frames % CHECKPOINT_FRAMES == 0) test.saveCheckpoint(options.checkpointFileName, steps, time);
+
             txSetFillColor(TX_BLACK);
             txClear();
 
@@ -103,11 +449,409 @@ int main()
 
             saveScreenshot("resources/screenshots/hook/screen", screenShotNumber, 3, ARRAY_WIDTH * ZOOM, ARRAY_HEIGHT * ZOOM);
 
+            if (options.snapshotErrorBound > 0)
+            {
+                char snapshotName[MAX_PATH] = "";
+                snprintf(snapshotName, sizeof(snapshotName), "resources/screenshots/hook/temperatures%u.snp", screenShotNumber);
+
+                const size_t bytes = test.saveSnapshot(snapshotName, options.snapshotErrorBound);
+
+                printf("[SNAPSHOT: %s, %u bytes, %.1fx smaller than raw doubles]\n", snapshotName, bytes, (double) ARRAY_WIDTH * ARRAY_HEIGHT * sizeof(double) / bytes);
+            }
+
             screenShotNumber++;
         }
     }
 
+    if (options.checkpointFileName != nullptr) test.saveCheckpoint(options.checkpointFileName, steps, time);
+
+    test.render(ZOOM, GetAsyncKeyState('0'));
+
+    delete field;
+}
+
+// The simulation loop of simulate() on the quadtree, which reports its leaves instead of saving screenshots:
+template <typename Real>
+void simulateAdaptive()
+{
+    QuadtreeField<Real> test("resources/conductivity/hook.bmp", "resources/obstacles/hook.bmp", "resources/images/hook.bmp", ARRAY_WIDTH, ARRAY_HEIGHT, 0, 0, NULL);
+
+    puts("[SIMULATION MODE: ADAPTIVE MESH]");
+
+    for (unsigned int counter = 0; !GetAsyncKeyState(VK_ESCAPE); counter++)
+    {
+        test.adjustTemperature(105, 150, 7, 10);
+
+        test.calculate();
+
+        if (counter == 500)
+        {
+            counter = 0;
+
+            printf("[LEAVES: %d of %d cells]\n", test.leaves(), ARRAY_WIDTH * ARRAY_HEIGHT);
+
+            txBegin();
+
+            test.render(ZOOM, GetAsyncKeyState('0'));
+
+            txEnd();
+        }
+    }
+
     test.render(ZOOM, GetAsyncKeyState('0'));
+}
+
+// Member m gets a brush of (m + 1) / N times the usual strength, the strongest one is shown:
+template <typename Real>
+void simulateEnsemble(const SimulationOptions& options)
+{
+    const size_t members = options.ensembleMembers;
+
+    Ensemble<Real> test("resources/conductivity/hook.bmp", "resources/obstacles/hook.bmp", "resources/images/hook.bmp", ARRAY_WIDTH, ARRAY_HEIGHT, members, 0, 0);
+
+    test.setThreads(options.threads);
+
+    printf("[SIMULATION MODE: ENSEMBLE OF %d]\n", members);
+
+    for (unsigned int counter = 0; !GetAsyncKeyState(VK_ESCAPE); counter++)
+    {
+        for (size_t member = 0; member < members; member++) test.adjustTemperature(member, 105, 150, 7, 10.0 * (member + 1) / members);
+
+        test.calculate();
+
+        if (counter == 500)
+        {
+            counter = 0;
+
+            printf("[T[105][165]: %.2f (weakest) .. %.2f (strongest)]\n", test.temperature(0, 105, 165), test.temperature(members - 1, 105, 165));
+
+            txBegin();
+
+            test.render(members - 1, ZOOM);
+
+            txEnd();
+        }
+    }
+
+    test.render(members - 1, ZOOM);
+}
+
+// The hook extruded to that many layers with the brush in the middle one:
+template <typename Real>
+void simulateVolume(const SimulationOptions& options)
+{
+    const size_t depth = options.volumeDepth;
+
+    Volume<Real> test("resources/conductivity/hook.bmp", "resources/obstacles/hook.bmp", ARRAY_WIDTH, ARRAY_HEIGHT, depth, 0, 0);
+
+    test.setThreads(options.threads);
+
+    printf("[SIMULATION MODE: VOLUME OF %d LAYERS]\n", depth);
+
+    size_t layer = depth / 2;
+
+    for (unsigned int counter = 0; !GetAsyncKeyState(VK_ESCAPE); counter++)
+    {
+        test.adjustTemperature(105, 150, depth / 2, 7, 10);
+
+        test.calculate();
+
+        if (GetAsyncKeyState(VK_UP)   && layer + 1 < depth) layer++;
+        if (GetAsyncKeyState(VK_DOWN) && layer > 0)         layer--;
+
+        if (counter == 100)
+        {
+            counter = 0;
+
+            printf("[LAYER %d, T[105][165]: %.2f]\n", layer, test.temperature(105, 165, layer));
+
+            txBegin();
+
+            test.render(layer, ZOOM);
+
+            txEnd();
+        }
+    }
+
+    test.render(layer, ZOOM);
+}
+
+// The hook written to band files of 64 rows, every calculation one pass over them:
+template <typename Real>
+void simulateOutOfCore(const SimulationOptions& options)
+{
+    CreateDirectory(options.bandsDirectory, nullptr);
+
+    BandedField<Real> test(options.bandsDirectory, "resources/conductivity/hook.bmp", "resources/obstacles/hook.bmp", ARRAY_WIDTH, ARRAY_HEIGHT, 64, 0, 0);
+
+    test.setThreads(options.threads);
+
+    printf("[SIMULATION MODE: OUT OF CORE, %d STEPS PER PASS]\n", test.depth());
+
+    for (unsigned int counter = 0; !GetAsyncKeyState(VK_ESCAPE); counter++)
+    {
+        test.adjustTemperature(105, 150, 7, 10 * test.depth());
+
+        test.calculate(test.depth());
+
+        if (counter == 500 / test.depth())
+        {
+            counter = 0;
+
+            txBegin();
+
+            test.render(ZOOM);
+
+            txEnd();
+        }
+    }
+
+    test.render(ZOOM);
+}
+
+// Rank 0 is the process the user started: it launches the other ranks as copies of itself,
+// renders and decides when all of them stop:
+template <typename Real>
+void simulateDecomposed(const SimulationOptions& options)
+{
+    const unsigned int ranks = options.ranks;
+    const unsigned int rank  = options.rank;
+    const unsigned int run   = (rank == 0)? (unsigned int) GetCurrentProcessId() : options.run;
+
+    PROCESS_INFORMATION* processes = nullptr;
+
+    if (rank == 0)
+    {
+        processes = (PROCESS_INFORMATION*) calloc(ranks, sizeof(*processes));
+        assert(processes);
+
+        char executable[MAX_PATH] = "";
+        GetModuleFileName(nullptr, executable, MAX_PATH);
+
+        for (unsigned int other = 1; other < ranks; other++)
+        {
+            char commandLine[2 * MAX_PATH] = "";
+            snprintf(commandLine, sizeof(commandLine), "\"%s\" --ranks %u --rank %u --run %u%s", executable, ranks, other, run, (sizeof(Real) == sizeof(float))? " --float" : "");
+
+            STARTUPINFO startup = {};
+            startup.cb = sizeof(startup);
+
+            BOOL created = CreateProcess(nullptr, commandLine, nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &processes[other]);
+            assert(created);
+        }
+    }
+
+    char runName[MAX_PATH] = "";
+    snprintf(runName, sizeof(runName), "heat-%u", run);
+
+    SharedMemoryTransport transport(runName, rank, ranks);
+
+    Subdomain<Real, SharedMemoryTransport> test(&transport, "resources/conductivity/hook.bmp", "resources/obstacles/hook.bmp", "resources/images/hook.bmp", ARRAY_WIDTH, ARRAY_HEIGHT, 0, 0);
+
+    printf("[SIMULATION MODE: RANK %u OF %u, COLUMNS %d..%d]\n", rank, ranks, test.firstColumn(), test.firstColumn() + test.columns() - 1);
+
+    for (bool running = true; running; )
+    {
+        // Between frames the heating of GRID_HALO steps goes in at once, like simulate() heats
+        // its long steps, so that each round of steps exchanges one deep halo:
+        for (unsigned int counter = 0; counter < 500; counter += (unsigned int) GRID_HALO)
+        {
+            test.adjustTemperature(105, 150, 7, 10 * GRID_HALO);
+
+            test.calculate((unsigned int) GRID_HALO);
+        }
+
+        test.gather();
+
+        if (rank == 0)
+        {
+            txBegin();
+
+            test.render(ZOOM);
+
+            txEnd();
+        }
+
+        running = test.broadcast(!GetAsyncKeyState(VK_ESCAPE));
+    }
+
+    if (rank == 0)
+    {
+        for (unsigned int other = 1; other < ranks; other++)
+        {
+            WaitForSingleObject(processes[other].hProcess, INFINITE);
+
+            CloseHandle(processes[other].hProcess);
+            CloseHandle(processes[other].hThread);
+        }
+
+        free(processes);
+    }
+}
+
+// Cell updates per second of calculate() and calculate(steps) for 1, 2, 4, ... threads,
+// against the single-threaded calculate() loop:
+template <typename Real>
+void reportScaling()
+{
+    Field<Real> test("resources/conductivity/hook.bmp", "resources/obstacles/hook.bmp", "resources/images/hook.bmp", ARRAY_WIDTH, ARRAY_HEIGHT, 0, 0, NULL);
+
+    test.adjustTemperature(105, 150, 7, 10);
+
+    const double cellUpdates = (double) ARRAY_WIDTH * ARRAY_HEIGHT * SCALING_STEPS;
+
+    double start = seconds();
+
+    for (unsigned int step = 0; step < SCALING_STEPS; step++) test.calculate();
+
+    const double baseline = cellUpdates / (seconds() - start);
+
+    puts("[SCALING]");
+    printf("threads   per-step Mcells/s  speedup   blocked Mcells/s  speedup\n");
+
+    const unsigned int maxThreads = hardwareThreads();
+
+    // 1, 2, 4, ... and finally all hardware threads:
+    for (unsigned int threads = 1; threads <= maxThreads; threads = (threads < maxThreads && threads * 2 > maxThreads)? maxThreads : threads * 2)
+    {
+        test.setThreads(threads);
+
+        start = seconds();
+
+        for (unsigned int step = 0; step < SCALING_STEPS; step++) test.calculate();
+
+        const double perStep = cellUpdates / (seconds() - start);
+
+        start = seconds();
+
+        test.calculate(SCALING_STEPS);
+
+        const double blocked = cellUpdates / (seconds() - start);
+
+        printf("%7d   %17.1f  %7.2f   %16.1f  %7.2f\n", threads, perStep / 1e6, perStep / baseline, blocked / 1e6, blocked / baseline);
+    }
+}
+
+// Field::calculate() against the grids documented to step bit-identically to it (Subdomain,
+// BandedField and member 0 of an Ensemble), all heated like simulate() heats the hook scene;
+// prints the largest difference of each and returns whether every one was 0:
+template <typename Real>
+bool reportVerification(const unsigned int threads)
+{
+    Field<Real> reference("resources/conductivity/hook.bmp", "resources/obstacles/hook.bmp", "resources/images/hook.bmp", ARRAY_WIDTH, ARRAY_HEIGHT, 0, 0, NULL);
+
+    reference.setThreads(threads);
+
+    // Every rank in a thread of its own, on rings named after this process:
+
+    char runName[MAX_PATH] = "";
+    snprintf(runName, sizeof(runName), "heat-verify-%u", (unsigned int) GetCurrentProcessId());
+
+    SharedMemoryTransport*                  transports[VERIFY_RANKS]  = {};
+    Subdomain<Real, SharedMemoryTransport>* subdomains[VERIFY_RANKS]  = {};
+    HANDLE                                  rankThreads[VERIFY_RANKS] = {};
+
+    for (unsigned int rank = 0; rank < VERIFY_RANKS; rank++)
+    {
+        transports[rank] = new SharedMemoryTransport(runName, rank, VERIFY_RANKS);
+        subdomains[rank] = new Subdomain<Real, SharedMemoryTransport>(transports[rank], "resources/conductivity/hook.bmp", "resources/obstacles/hook.bmp", "resources/images/hook.bmp", ARRAY_WIDTH, ARRAY_HEIGHT, 0, 0);
+    }
+
+    CreateDirectory(VERIFY_BANDS_DIRECTORY, nullptr);
+
+    BandedField<Real> bands(VERIFY_BANDS_DIRECTORY, "resources/conductivity/hook.bmp", "resources/obstacles/hook.bmp", ARRAY_WIDTH, ARRAY_HEIGHT, VERIFY_BAND_HEIGHT, 0, 0);
+
+    bands.setThreads(threads);
+
+    Ensemble<Real> ensemble("resources/conductivity/hook.bmp", "resources/obstacles/hook.bmp", "resources/images/hook.bmp", ARRAY_WIDTH, ARRAY_HEIGHT, VERIFY_MEMBERS, 0, 0);
+
+    ensemble.setThreads(threads);
+
+    // Stepping (rank 0 on this thread, beside the others):
+
+    for (unsigned int rank = 1; rank < VERIFY_RANKS; rank++)
+    {
+        rankThreads[rank] = CreateThread(nullptr, 0, stepVerifiedRank<Real>, subdomains[rank], 0, nullptr);
+        assert(rankThreads[rank]);
+    }
+
+    for (unsigned int round = 0; round < VERIFY_ROUNDS; round++)
+    {
+        reference     .adjustTemperature(105, 150, 7, 10);
+        bands         .adjustTemperature(105, 150, 7, 10);
+        subdomains[0]->adjustTemperature(105, 150, 7, 10);
+
+        ensemble.adjustTemperature(0, 105, 150, 7, 10);
+        ensemble.adjustTemperature(1, 105, 150, 7,  5);
+
+        for (unsigned int step = 0; step < VERIFY_STEPS; step++) reference.calculate();
+
+        bands         .calculate(VERIFY_STEPS);
+        ensemble      .calculate(VERIFY_STEPS);
+        subdomains[0]->calculate(VERIFY_STEPS);
+    }
+
+    for (unsigned int rank = 1; rank < VERIFY_RANKS; rank++)
+    {
+        WaitForSingleObject(rankThreads[rank], INFINITE);
+        CloseHandle(rankThreads[rank]);
+    }
+
+    // Comparing (a subdomain only holds its own columns):
+
+    double subdomainDifference = 0;
+    double bandsDifference     = 0;
+    double ensembleDifference  = 0;
+
+    for (unsigned int rank = 0; rank < VERIFY_RANKS; rank++)
+    {
+        const Subdomain<Real, SharedMemoryTransport>& subdomain = *subdomains[rank];
+
+        for (size_t x = subdomain.firstColumn(); x < subdomain.firstColumn() + subdomain.columns(); x++)
+        {
+            for (size_t y = 0; y < ARRAY_HEIGHT; y++)
+            {
+                subdomainDifference = std::max(subdomainDifference, fabs((double) subdomain.temperature(x, y) - reference.temperature(x, y)));
+            }
+        }
+    }
+
+    for (size_t x = 0; x < ARRAY_WIDTH; x++)
+    {
+        for (size_t y = 0; y < ARRAY_HEIGHT; y++)
+        {
+            ensembleDifference = std::max(ensembleDifference, fabs((double) ensemble.temperature(0, x, y) - reference.temperature(x, y)));
+            bandsDifference    = std::max(bandsDifference,    fabs((double) bands   .temperature(x, y)    - reference.temperature(x, y)));
+        }
+    }
+
+    for (unsigned int rank = 0; rank < VERIFY_RANKS; rank++)
+    {
+        delete subdomains[rank];
+        delete transports[rank];
+    }
+
+    puts("[VERIFICATION]");
+    printf("%u steps of the hook scene, largest difference from Field::calculate():\n", VERIFY_ROUNDS * VERIFY_STEPS);
+    printf("Subdomain, %u ranks           %g\n", VERIFY_RANKS,       subdomainDifference);
+    printf("BandedField, %u-row bands    %g\n", VERIFY_BAND_HEIGHT, bandsDifference);
+    printf("Ensemble, member 0 of %u      %g\n", VERIFY_MEMBERS,     ensembleDifference);
+
+    return subdomainDifference == 0 && bandsDifference == 0 && ensembleDifference == 0;
+}
+
+// The rounds of reportVerification() on a rank other than 0:
+template <typename Real>
+DWORD WINAPI stepVerifiedRank(LPVOID subdomain)
+{
+    Subdomain<Real, SharedMemoryTransport>* test = (Subdomain<Real, SharedMemoryTransport>*) subdomain;
+
+    for (unsigned int round = 0; round < VERIFY_ROUNDS; round++)
+    {
+        test->adjustTemperature(105, 150, 7, 10);
+
+        test->calculate(VERIFY_STEPS);
+    }
 
     return 0;
 }
@@ -184,6 +928,43 @@ int main()
         #pragma GCC diagnostic pop
     }
 
+    // Timing:
+
+    double seconds()
+    {
+        LARGE_INTEGER counter   = {};
+        LARGE_INTEGER frequency = {};
+
+        QueryPerformanceCounter  (&counter);
+        QueryPerformanceFrequency(&frequency);
+
+        return (double) counter.QuadPart / frequency.QuadPart;
+    }
+
+    // Options:
+
+    // Why the options cannot run together as given, nullptr when they can. main() dispatches
+    // on the first mode set and simulate() on the first kind of step, so anything more
+    // would be silently dropped; only calculate() and advance() use the stencil shape,
+    // every other step is 5-point:
+    const char* conflictingOptions(const SimulationOptions& options, const bool scaling, const bool verify)
+    {
+        const unsigned int modes = scaling + verify + options.adaptiveMesh + (options.ensembleMembers > 0) + (options.volumeDepth > 0) +
+                                   (options.bandsDirectory != nullptr) + (options.ranks > 1);
+
+        const unsigned int longSteps = options.alternatingDirections + options.superTimeStepping + options.localTimeStepping;
+
+        if (modes > 1)                                             return "--scaling, --verify, --amr, --ensemble, --volume, --bands and --ranks exclude each other";
+        if (longSteps > 1)                                         return "--adi, --rkl and --local exclude each other";
+        if (longSteps > 0 && options.implicitSteps == 0)           return "--adi, --rkl and --local need --implicit N";
+        if (options.implicitSteps > 0 && options.advanceSteps > 0) return "--implicit and --advance exclude each other";
+
+        if (options.stencilShape != STENCIL_5_POINT && (modes > 0 || options.implicitSteps > 0))
+            return "--stencil 9|4 only applies to explicit steps, --implicit and the other modes are 5-point";
+
+        return nullptr;
+    }
+
     // Different string operations:
 
     char* mergeStr(const char* str0, const char* str1)
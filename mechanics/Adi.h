@@ -0,0 +1,371 @@
+#pragma once
+
+
+//----------------------------------------------------------------------------
+//{ Adi
+//----------------------------------------------------------------------------
+
+    // Peaceman-Rachford alternating direction implicit steps. With h = conductivity * timeStep / (2 SPACE_STEP^2)
+    // a step is two halves that are implicit along one axis and explicit along the other:
+    //     T* - h dxx T* = T  + h dyy T,
+    //     T' - h dyy T' = T* + h dxx T*,
+    // so every half is a set of independent tridiagonal systems, one per row or column.
+    //
+    // Cells with zero weight are identity rows: walls and borders break a line into independent
+    // pieces and keep their values. The systems only depend on the scene and the time step, so
+    // the elimination factors are computed once by setup() and a half costs a few passes.
+    //
+    // The batches run across lines: the x-half walks columns and solves all rows at once along
+    // the contiguous y axis. The y-half copies blocks of LANES columns into an interleaved buffer
+    // (one cache line per y) and solves those columns at once, with the same kernels.
+
+    template <typename Real>
+    class Adi
+    {
+        public:
+
+            // Columns solved together by the y-half:
+            static const size_t LANES = GRID_ALIGNMENT / sizeof(Real);
+
+            // Constructor && destructor:
+
+                explicit Adi(const GridLayout& grid);
+
+                ~Adi();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Stepping:
+
+                    // weights * scale is conductivity * timeStep / SPACE_STEP^2:
+                    void setup(const Real* weights, const double scale);
+
+                    // next receives the step from current, with both halves split between the workers of pool:
+                    void step(const Real* current, Real* next, ThreadPool* pool);
+
+        private:
+
+            struct Sweep
+            {
+                Adi*        adi;
+                const Real* current;
+                Real*       next;
+                ThreadPool* pool;
+            };
+
+            GridLayout grid_;
+
+            size_t blocks_;
+
+            // Field layout:
+            Real* half_;
+            Real* factorX_;
+            Real* upperX_;
+
+            // T* between the halves:
+            Real* middle_;
+
+            // Interleaved layout, LANES columns of a block side by side ((block * height + y) * LANES + lane):
+            Real* halfY_;
+            Real* factorY_;
+            Real* upperY_;
+
+            // One interleaved block per worker, with a zero line above and below:
+            Real*        lines_;
+            unsigned int lineWorkers_;
+
+            ExplicitHalfKernel<Real> explicitHalf_;
+            EliminationKernel<Real>  elimination_;
+            SubstitutionKernel<Real> substitution_;
+
+            void halfX(const Real* current, const size_t start, const size_t finish);
+            void halfY(Real* next, Real* lines, const size_t block);
+
+            static void sweepTask(void* sweep, const unsigned int worker, const unsigned int workers);
+
+            Adi(const Adi&);
+            Adi& operator=(const Adi&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        Adi<Real>::Adi(const GridLayout& grid) :
+            grid_         (grid),
+            blocks_       ((grid.width + LANES - 1) / LANES),
+            half_         (nullptr),
+            factorX_      (nullptr),
+            upperX_       (nullptr),
+            middle_       (nullptr),
+            halfY_        (nullptr),
+            factorY_      (nullptr),
+            upperY_       (nullptr),
+            lines_        (nullptr),
+            lineWorkers_  (0),
+            explicitHalf_ (explicitHalfKernel<Real>(stencilIsa())),
+            elimination_  (eliminationKernel <Real>(stencilIsa())),
+            substitution_ (substitutionKernel<Real>(stencilIsa()))
+        {
+            // Creating arrays:
+
+                half_    = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+                factorX_ = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+                upperX_  = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+                middle_  = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+
+                halfY_   = (Real*) alignedCalloc(blocks_ * grid_.height * LANES, sizeof(Real));
+                factorY_ = (Real*) alignedCalloc(blocks_ * grid_.height * LANES, sizeof(Real));
+                upperY_  = (Real*) alignedCalloc(blocks_ * grid_.height * LANES, sizeof(Real));
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        Adi<Real>::~Adi()
+        {
+            assert(ok());
+
+            alignedFree(half_);
+            alignedFree(factorX_);
+            alignedFree(upperX_);
+            alignedFree(middle_);
+
+            alignedFree(halfY_);
+            alignedFree(factorY_);
+            alignedFree(upperY_);
+
+            alignedFree(lines_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        bool Adi<Real>::ok() const
+        {
+            bool everythingOk = true;
+
+            if (half_ == nullptr || factorX_ == nullptr || upperX_ == nullptr || middle_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Adi::ok(): Field layout arrays are null pointers.");
+            }
+
+            if (halfY_ == nullptr || factorY_ == nullptr || upperY_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Adi::ok(): Interleaved arrays are null pointers.");
+            }
+
+            if (blocks_ * LANES < grid_.width)
+            {
+                everythingOk = false;
+                printf("Adi::ok(): %d blocks do not cover width %d.", blocks_, grid_.width);
+            }
+
+            return everythingOk;
+        }
+
+        // Thomas elimination of the rows -h x_(i-1) + (1 + 2h) x_i - h x_(i+1) = r_i keeps
+        //     factor_i = 1 / (1 + 2h + h upper_(i-1)),  upper_i = -h factor_i,
+        // and the solve becomes r_i = (r_i + h r_(i-1)) factor_i forwards, x_i = r_i - upper_i x_(i+1) backwards:
+        template <typename Real>
+        void Adi<Real>::setup(const Real* weights, const double scale)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(weights);
+
+                assert(scale > 0);
+
+            // Main algorithm:
+
+                for (size_t x = 0; x < grid_.width; x++)
+                {
+                    for (size_t y = 0; y < grid_.height; y++)
+                    {
+                        const size_t cell = grid_.index(x, y);
+
+                        const Real half = weights[cell] * scale / 2;
+
+                        half_   [cell] = half;
+                        factorX_[cell] = 1 / (1 + 2 * half + half * upperX_[cell - grid_.pitch]);
+                        upperX_ [cell] = -half * factorX_[cell];
+                    }
+                }
+
+                // Lanes past the width solve identity rows of zeros:
+
+                for (size_t block = 0; block < blocks_; block++)
+                {
+                    for (size_t lane = 0; lane < LANES; lane++)
+                    {
+                        const size_t x = block * LANES + lane;
+
+                        for (size_t y = 0; y < grid_.height; y++)
+                        {
+                            const size_t cell = (block * grid_.height + y) * LANES + lane;
+
+                            const Real half  = (x < grid_.width)? half_[grid_.index(x, y)] : 0;
+                            const Real upper = (y > 0)? upperY_[cell - LANES] : 0;
+
+                            halfY_  [cell] = half;
+                            factorY_[cell] = 1 / (1 + 2 * half + half * upper);
+                            upperY_ [cell] = -half * factorY_[cell];
+                        }
+                    }
+                }
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        void Adi<Real>::step(const Real* current, Real* next, ThreadPool* pool)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(current && next);
+
+            // Creating resources:
+
+                const unsigned int workers = (pool != nullptr)? pool->size() : 1;
+
+                if (workers > lineWorkers_)
+                {
+                    alignedFree(lines_);
+
+                    lineWorkers_ = workers;
+                    lines_       = (Real*) alignedCalloc(lineWorkers_ * (grid_.height + 2) * LANES, sizeof(Real));
+                }
+
+            // Main algorithm:
+
+                Sweep sweep = {this, current, next, pool};
+
+                if (pool != nullptr) pool->run(sweepTask, &sweep);
+                else                 sweepTask(&sweep, 0, 1);
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        // Every worker takes a band of rows for the x-half and a range of blocks for the y-half;
+        // the y-half reads neighbouring columns of T*, so the halves are separated by a barrier:
+        template <typename Real>
+        void Adi<Real>::sweepTask(void* sweep, const unsigned int worker, const unsigned int workers)
+        {
+            Sweep* adiSweep = (Sweep*) sweep;
+            Adi*   self     = adiSweep->adi;
+
+            const size_t height = self->grid_.height;
+
+            self->halfX(adiSweep->current, height * worker / workers, height * (worker + 1) / workers);
+
+            if (adiSweep->pool != nullptr) adiSweep->pool->barrier();
+
+            Real* lines = self->lines_ + worker * (height + 2) * LANES;
+
+            for (size_t block = self->blocks_ * worker / workers; block < self->blocks_ * (worker + 1) / workers; block++)
+            {
+                self->halfY(adiSweep->next, lines, block);
+            }
+        }
+
+        // Rows [start, finish) of T*, all of them at once along y (the ghost columns of middle_ stay zero):
+        template <typename Real>
+        void Adi<Real>::halfX(const Real* current, const size_t start, const size_t finish)
+        {
+            if (start >= finish) return;
+
+            const size_t pitch = grid_.pitch;
+
+            for (size_t x = 0; x < grid_.width; x++)
+            {
+                const size_t column = grid_.index(x, start);
+
+                explicitHalf_(middle_ + column, current + column, half_ + column, 1, finish - start);
+                elimination_ (middle_ + column, middle_ + column - pitch, half_ + column, factorX_ + column, finish - start);
+            }
+
+            for (size_t x = grid_.width; x-- > 0; )
+            {
+                const size_t column = grid_.index(x, start);
+
+                substitution_(middle_ + column, middle_ + column + pitch, upperX_ + column, finish - start);
+            }
+        }
+
+        // LANES columns of T', solved side by side in lines:
+        template <typename Real>
+        void Adi<Real>::halfY(Real* next, Real* lines, const size_t block)
+        {
+            const size_t height = grid_.height;
+
+            const size_t first = block * LANES;
+            const size_t count = (first + LANES <= grid_.width)? LANES : grid_.width - first;
+
+            const size_t factors = block * height * LANES;
+
+            // Right-hand sides, interleaved:
+
+                for (size_t lane = 0; lane < count; lane++)
+                {
+                    const size_t column = grid_.index(first + lane, 0);
+
+                    explicitHalf_(next + column, middle_ + column, half_ + column, grid_.pitch, height);
+
+                    for (size_t y = 0; y < height; y++)
+                    {
+                        lines[(y + 1) * LANES + lane] = next[column + y];
+                    }
+                }
+
+            // Solving:
+
+                for (size_t y = 0; y < height; y++)
+                {
+                    elimination_(lines + (y + 1) * LANES, lines + y * LANES, halfY_ + factors + y * LANES, factorY_ + factors + y * LANES, LANES);
+                }
+
+                for (size_t y = height; y-- > 0; )
+                {
+                    substitution_(lines + (y + 1) * LANES, lines + (y + 2) * LANES, upperY_ + factors + y * LANES, LANES);
+                }
+
+            // Back to the field layout:
+
+                for (size_t lane = 0; lane < count; lane++)
+                {
+                    const size_t column = grid_.index(first + lane, 0);
+
+                    for (size_t y = 0; y < height; y++)
+                    {
+                        next[column + y] = lines[(y + 1) * LANES + lane];
+                    }
+                }
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
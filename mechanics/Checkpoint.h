@@ -0,0 +1,362 @@
+#pragma once
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    const char         CHECKPOINT_SIGNATURE[8] = "HEATCKP";
+    const unsigned int CHECKPOINT_VERSION      = 1;
+
+    // Sections start at multiples of this (the granularity of file views on Windows and
+    // a multiple of any page size), so every one of them maps straight into a buffer:
+    const unsigned long long CHECKPOINT_ALIGNMENT = 1 << 16;
+
+    // Sections, in file order:
+    const unsigned int CHECKPOINT_OBSTACLES     = 0,
+                       CHECKPOINT_CONDUCTIVITIES = 1,
+                       CHECKPOINT_WEIGHTS        = 2,
+                       CHECKPOINT_CORRECTIONS    = 3,
+                       CHECKPOINT_TEMPERATURES   = 4,
+                       CHECKPOINT_SECTIONS       = 5;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Checkpoint
+//----------------------------------------------------------------------------
+
+    // The first block of a checkpoint file; every section is a whole padded array
+    // as it lies in memory, at its offset (a multiple of CHECKPOINT_ALIGNMENT):
+    struct CheckpointHeader
+    {
+        char               signature[8];
+        unsigned int       version;
+        unsigned int       cellSize;
+
+        unsigned long long width;
+        unsigned long long height;
+        unsigned long long pitch;
+        unsigned long long origin;
+        unsigned long long cells;
+
+        unsigned long long steps;
+        double             time;
+
+        double             timeStep;
+        double             stableTimeStep;
+        double             borderTemperature;
+        unsigned int       stencilShape;
+
+        unsigned long long sections[CHECKPOINT_SECTIONS];
+        unsigned long long fileSize;
+    };
+
+    // A checkpoint file of a Field (see Field::saveCheckpoint()): write() puts the sections on disk,
+    // the constructor maps a file copy-on-write, so the views are the arrays, nothing is read before
+    // a sweep touches it and steps never change the file. The temperatures are viewed twice,
+    // calculate() needs two buffers, equal in the cells it never changes.
+    //
+    // A file is only used once every section lies whole and aligned inside it; anything else
+    // (a missing, cut short or foreign file, or one that cannot be mapped) is reported and leaves
+    // the checkpoint invalid, so the caller can start afresh instead.
+    //
+    // The file is mapped whole, so a 32-bit build only opens checkpoints that fit in its address
+    // space next to everything else.
+
+    template <typename Real>
+    class Checkpoint
+    {
+        public:
+
+            // Constructor && destructor:
+
+                explicit Checkpoint(const char* fileName);
+
+                ~Checkpoint();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Sections (of a valid checkpoint):
+
+                    // Whether the file is a whole checkpoint of Real cells, mapped:
+                    bool valid() const;
+
+                    const CheckpointHeader& header() const;
+
+                    // The section as it lies in the view:
+                    void* section(const unsigned int section) const;
+
+                    // The second view of the temperatures:
+                    Real* temperatureCopy() const;
+
+                // Writing:
+
+                    // The sections (header->cells cells each, obstacles are chars) and the header to fileName,
+                    // on the disk before it returns; fills in the offsets and the size of header,
+                    // false (reported) when the file could not be written:
+                    static bool write(const char* fileName, CheckpointHeader* header, const void* const sections[CHECKPOINT_SECTIONS]);
+
+        private:
+
+            HANDLE file_;
+            HANDLE mapping_;
+
+            // The whole file and the temperature section:
+            void* views_[2];
+
+            CheckpointHeader header_;
+
+            bool valid_;
+
+            // Whether header_ describes a whole checkpoint of Real cells in a file of fileSize bytes:
+            bool check(const unsigned long long fileSize) const;
+
+            static size_t cellSize(const unsigned int section);
+
+            Checkpoint(const Checkpoint&);
+            Checkpoint& operator=(const Checkpoint&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        Checkpoint<Real>::Checkpoint(const char* fileName) :
+            file_   (INVALID_HANDLE_VALUE),
+            mapping_(nullptr),
+            views_  (),
+            header_ (),
+            valid_  (false)
+        {
+            // Checking input:
+
+                assert(fileName != nullptr);
+
+            // Opening the file:
+
+                file_ = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+                if (file_ == INVALID_HANDLE_VALUE)
+                {
+                    printf("Checkpoint::Checkpoint(): Could not open %s.\n", fileName);
+                    return;
+                }
+
+                LARGE_INTEGER fileSize = {};
+                GetFileSizeEx(file_, &fileSize);
+
+                if ((unsigned long long) fileSize.QuadPart < CHECKPOINT_ALIGNMENT)
+                {
+                    printf("Checkpoint::Checkpoint(): %s is too short for a checkpoint.\n", fileName);
+                    return;
+                }
+
+            // Mapping the file (copy-on-write, so steps never write back to it):
+
+                mapping_ = CreateFileMapping(file_, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+
+                views_[0] = (mapping_ != nullptr)? MapViewOfFile(mapping_, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+
+                if (views_[0] == nullptr)
+                {
+                    printf("Checkpoint::Checkpoint(): Could not map %s (%llu bytes).\n", fileName, (unsigned long long) fileSize.QuadPart);
+                    return;
+                }
+
+            // Checking the header:
+
+                memcpy(&header_, views_[0], sizeof(header_));
+
+                if (!check((unsigned long long) fileSize.QuadPart))
+                {
+                    printf("Checkpoint::Checkpoint(): %s is not a whole version %d checkpoint of %d-byte cells.\n", fileName, CHECKPOINT_VERSION, sizeof(Real));
+                    return;
+                }
+
+            // Viewing the temperatures again:
+
+                const unsigned long long offset = header_.sections[CHECKPOINT_TEMPERATURES];
+
+                views_[1] = MapViewOfFile(mapping_, FILE_MAP_COPY, (DWORD) (offset >> 32), (DWORD) offset, (size_t) header_.cells * sizeof(Real));
+
+                if (views_[1] == nullptr)
+                {
+                    printf("Checkpoint::Checkpoint(): Could not map the temperatures of %s again.\n", fileName);
+                    return;
+                }
+
+                valid_ = true;
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        Checkpoint<Real>::~Checkpoint()
+        {
+            assert(ok());
+
+            if (views_[0] != nullptr) UnmapViewOfFile(views_[0]);
+            if (views_[1] != nullptr) UnmapViewOfFile(views_[1]);
+
+            if (mapping_ != nullptr)               CloseHandle(mapping_);
+            if (file_    != INVALID_HANDLE_VALUE)  CloseHandle(file_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        bool Checkpoint<Real>::ok() const
+        {
+            bool everythingOk = true;
+
+            if (valid_ && (views_[0] == nullptr || views_[1] == nullptr))
+            {
+                everythingOk = false;
+                printf("Checkpoint::ok(): A valid checkpoint is not mapped.");
+            }
+
+            return everythingOk;
+        }
+
+        // Every section must lie whole inside the file, aligned, after the header and the section before it,
+        // so no array the field points into the view reaches past the mapping:
+        template <typename Real>
+        bool Checkpoint<Real>::check(const unsigned long long fileSize) const
+        {
+            if (memcmp(header_.signature, CHECKPOINT_SIGNATURE, sizeof(header_.signature)) != 0 ||
+                header_.version  != CHECKPOINT_VERSION ||
+                header_.cellSize != sizeof(Real)) return false;
+
+            // The size comes first, so the layout below cannot overflow:
+            if (header_.fileSize > fileSize || header_.width < 3 || header_.height < 3 ||
+                header_.height > fileSize / header_.width) return false;
+
+            // The layout must be the one this build computes for the size:
+            const GridLayout grid = paddedLayout((size_t) header_.width, (size_t) header_.height, sizeof(Real));
+
+            if (header_.pitch != grid.pitch || header_.origin != grid.origin || header_.cells != grid.cells) return false;
+
+            unsigned long long end = CHECKPOINT_ALIGNMENT;
+
+            for (unsigned int section = 0; section < CHECKPOINT_SECTIONS; section++)
+            {
+                const unsigned long long offset = header_.sections[section];
+                const unsigned long long bytes  = header_.cells * cellSize(section);
+
+                if (offset % CHECKPOINT_ALIGNMENT != 0 || offset < end || offset > header_.fileSize || bytes > header_.fileSize - offset) return false;
+
+                end = offset + bytes;
+            }
+
+            return true;
+        }
+
+        template <typename Real>
+        bool Checkpoint<Real>::valid() const
+        {
+            return valid_;
+        }
+
+        template <typename Real>
+        const CheckpointHeader& Checkpoint<Real>::header() const
+        {
+            return header_;
+        }
+
+        template <typename Real>
+        void* Checkpoint<Real>::section(const unsigned int section) const
+        {
+            assert(ok() && valid_);
+            assert(section < CHECKPOINT_SECTIONS);
+
+            return (char*) views_[0] + header_.sections[section];
+        }
+
+        template <typename Real>
+        Real* Checkpoint<Real>::temperatureCopy() const
+        {
+            assert(ok() && valid_);
+
+            return (Real*) views_[1];
+        }
+
+        template <typename Real>
+        size_t Checkpoint<Real>::cellSize(const unsigned int section)
+        {
+            return (section == CHECKPOINT_OBSTACLES)? sizeof(char) : sizeof(Real);
+        }
+
+        template <typename Real>
+        bool Checkpoint<Real>::write(const char* fileName, CheckpointHeader* header, const void* const sections[CHECKPOINT_SECTIONS])
+        {
+            // Checking input:
+
+                assert(fileName != nullptr && header != nullptr && sections != nullptr);
+
+            // Creating resources:
+
+                const size_t cells = (size_t) header->cells;
+
+                // The header takes the first block:
+                unsigned long long offset = CHECKPOINT_ALIGNMENT;
+
+                for (unsigned int section = 0; section < CHECKPOINT_SECTIONS; section++)
+                {
+                    header->sections[section] = offset;
+
+                    offset += ((unsigned long long) cells * cellSize(section) + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+                }
+
+                header->fileSize = offset;
+
+            // Main algorithm (seeking past the end leaves zeros between the sections):
+
+                FILE* file = fopen(fileName, "wb");
+
+                if (file == nullptr)
+                {
+                    printf("Checkpoint::write(): Could not create %s.\n", fileName);
+                    return false;
+                }
+
+                bool written = fwrite(header, sizeof(*header), 1, file) == 1;
+
+                for (unsigned int section = 0; written && section < CHECKPOINT_SECTIONS; section++)
+                {
+                    written = _fseeki64(file, header->sections[section], SEEK_SET) == 0 &&
+                              fwrite(sections[section], cellSize(section), cells, file) == cells;
+                }
+
+                // The last section's block is whole too, every view stays inside the file:
+                written = written && _fseeki64(file, header->fileSize - 1, SEEK_SET) == 0 && fputc(0, file) == 0;
+
+                written = written && fflush(file) == 0 && _commit(_fileno(file)) == 0;
+                written = (fclose(file) == 0) && written;
+
+                if (!written) printf("Checkpoint::write(): Could not write %s.\n", fileName);
+
+                return written;
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
@@ -1,5 +1,22 @@
 #pragma once
 
+#include <malloc.h>
+#include <io.h>
+#include <limits>
+
+#include "Grid.h"
+#include "Kernels.h"
+#include "ThreadPool.h"
+#include "TileScheduler.h"
+#include "Multigrid.h"
+#include "Implicit.h"
+#include "Adi.h"
+#include "SuperTimeStepping.h"
+#include "LocalTimeStepping.h"
+#include "Preview.h"
+#include "Spectral.h"
+#include "Snapshot.h"
+#include "Checkpoint.h"
 
 //----------------------------------------------------------------------------
 //{ Defines (typedefs)
@@ -21,9 +38,20 @@
 
         const double MAX_TEMPERATURE = 2/*K*/;
 
+        // Default step of calculate(), lowered to Field::stableTimeStep() for maps that conduct too well:
         const double  TIME_STEP = 10;
         const double SPACE_STEP = 8;
 
+    // Adaptive stepping (see Field::advance()):
+
+        // Share of the stability limit taken by a step, so checkerboard modes still decay:
+        const double STABLE_STEP_FRACTION = 0.9;
+
+        // An accepted step aims at this share of the tolerance, and the step only grows
+        // (rescaling the weights) once it can grow by the factor:
+        const double ADAPTIVE_SAFETY = 0.9;
+        const double ADAPTIVE_GROWTH = 1.25;
+
     // Rendering:
 
         //COLORREF COLD_COLOR = RGB(  0, 0, 255);
@@ -32,12 +60,52 @@
 
         COLORREF WALL_COLOR = RGB(0, 0, 0);
 
+    // Stencil shapes (see Field::setStencil()):
+
+        // The fourth order stencil's largest eigenvalue is 4/3 of the 5-point one:
+        const double FOURTH_ORDER_STABILITY = 0.75;
+
     // Tile types:
 
         const unsigned char  EMPTY_TILE = 0,
                             BORDER_TILE = 1,
                               WALL_TILE = 2;
 
+    // Temporal blocking (see Field::calculate(steps)):
+
+        // Steps advanced per pass and height of the strips a pass walks through,
+        // chosen so a strip's working set (depth + 2 columns of three arrays) stays in L2:
+        const unsigned int TEMPORAL_BLOCK_DEPTH  = 8;
+        const size_t       TEMPORAL_BLOCK_HEIGHT = 512;
+
+        // With several threads strips get shorter so that every thread has a few of them:
+        const size_t       TEMPORAL_BLOCK_MIN_HEIGHT = 16;
+
+    // Red-black SOR (see Field::relaxSteadyState()):
+
+        // Sweeps between two estimates of the over-relaxation factor:
+        const unsigned int SOR_ESTIMATION_SWEEPS = 16;
+
+        const unsigned int SOR_MAX_SWEEPS = 100000;
+
+    // Sparse sweeps (see Field::setSparse()):
+
+        // Side of the square tiles whose activity is tracked:
+        const size_t TILE_SIZE = 32;
+
+        // Tile states:
+
+            const unsigned char   TILE_FIXED = 0,   // no cell of the tile is ever updated
+                              TILE_QUIESCENT = 1,   // frozen, equal in both buffers
+                                 TILE_ACTIVE = 2;
+
+        // Sides of a tile whose edge changed by more than the threshold:
+
+            const unsigned char   SIDE_LEFT = 1,
+                                 SIDE_RIGHT = 2,
+                                   SIDE_TOP = 4,
+                                SIDE_BOTTOM = 8;
+
 //}
 //----------------------------------------------------------------------------
 
@@ -154,6 +222,7 @@
 //{ Field
 //----------------------------------------------------------------------------
 
+    template <typename Real>
     class Field
     {
         public:
@@ -169,6 +238,13 @@
                       const double emptySpaceConditions,
                       double (*fillingFunction) (const unsigned int x, const unsigned int y));
 
+                // Resumes from a valid checkpoint (see Checkpoint.h), which the field takes over: the arrays
+                // are its views, steps and time receive the counters that were saved:
+                Field(Checkpoint<Real>* checkpoint,
+                      const char*      imageFileName,
+                      unsigned long long* steps,
+                      double*             time);
+
                 ~Field();
 
             // Functions:
@@ -184,10 +260,105 @@
 
                     void editorMode(const unsigned int brushRadius, double brushDeltaTemperature, const unsigned int zoom /*= 1*/);
                     void adjustTemperature(const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const double deltaTemperature);
+                    void adjustObstacles  (const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const char tile);
+
+                // Editing the scene (recompiles only the touched cell):
+
+                    void setObstacle   (const size_t x, const size_t y, const char tile);
+                    void setConductivity(const size_t x, const size_t y, const double conductivity);
 
                 // Calculations:
 
                     void calculate();
+                    void calculate(const unsigned int steps);
+
+                    // One unconditionally stable step of any length (theta is BACKWARD_EULER or CRANK_NICOLSON),
+                    // returns the number of PCG iterations it took:
+                    unsigned int calculateImplicit(const double timeStep, const double theta = BACKWARD_EULER);
+
+                    // Preconditioner of calculateImplicit(): NO_MULTIGRID (Jacobi, the default),
+                    // MULTIGRID_V_CYCLE or MULTIGRID_W_CYCLE:
+                    void setImplicitMultigrid(const unsigned int cycle);
+
+                    // One alternating direction implicit step of any length (see Adi.h),
+                    // nearly as cheap as calculate() and split between the threads:
+                    void calculateAdi(const double timeStep);
+
+                    // An explicit step of any length as one or more RKL2 super steps (see SuperTimeStepping.h),
+                    // about sqrt(timeStep / stableTimeStep()) sweeps; returns the number of stages taken:
+                    unsigned int calculateSuperStep(const double timeStep);
+
+                    // A scene without walls or borders inside the outer frame and of one conductivity (see spectralScene())
+                    // has an exact solution, advanced by any time in one sine transform forwards and one back (see Spectral.h);
+                    // any other scene is left alone and false returned:
+                    bool calculateSpectral(const double time);
+                    bool spectralScene() const;
+
+                    // An explicit step of any length where every tile sub-cycles only as much as its own
+                    // conductivities need; returns the number of tile sweeps it took:
+                    size_t calculateLocal(const double timeStep);
+
+                    // Jumps straight to the equilibrium of the current scene and fixed temperatures,
+                    // returns the number of multigrid-preconditioned CG iterations it took:
+                    unsigned int solveSteadyState(const unsigned int cycle = MULTIGRID_V_CYCLE);
+
+                    // The same equilibrium by red-black over-relaxation in place, without any extra memory;
+                    // returns the number of sweeps it took:
+                    unsigned int relaxSteadyState(const double tolerance = IMPLICIT_TOLERANCE);
+
+                    // Warm start: runs the scene for the time on blocks of factor x factor cells (4 or 8)
+                    // and interpolates the result onto the unknown cells (see Preview.h), which takes
+                    // milliseconds where calculate() would take seconds; returns the number of coarse steps:
+                    unsigned int preview(const unsigned int factor, const double time);
+
+                    // The largest explicit step the conductivity map allows (every weight at most 1/4),
+                    // the step calculate() takes (TIME_STEP unless that is unstable) and its setter:
+                    double stableTimeStep() const;
+                    double timeStep() const;
+                    void   setTimeStep(const double timeStep);
+
+                    // Advances by the physical time with the largest stable steps; with a tolerance
+                    // the step is also kept small enough for the local error of every step to stay below it.
+                    // 5-point spectral scenes take one exact step instead (see calculateSpectral()).
+                    // Returns the number of steps taken:
+                    unsigned int advance(const double time, const double tolerance = 0);
+
+                    // STENCIL_5_POINT (the default), STENCIL_9_POINT (isotropic) or STENCIL_4TH_ORDER for calculate(),
+                    // falling back to 5 points next to fixed cells; the other integrators stay 5-point:
+                    void setStencil(const unsigned char shape);
+                    unsigned char stencil() const;
+
+                    // 1 (the default) calculates on the calling thread only:
+                    void setThreads(const unsigned int threads);
+                    unsigned int threads() const;
+
+                    // Skips tiles that are all walls or changed by less than epsilon in a step,
+                    // until heat reaches them again; 0 (the default) updates every cell:
+                    void setSparse(const double epsilon);
+                    size_t activeTiles() const;
+
+                // Reading:
+
+                    // Of a cell of the map:
+                    Real temperature(const size_t x, const size_t y) const;
+
+                // Checkpoints:
+
+                    // The scene, the temperatures and the caller's step counter and simulated time, written
+                    // to fileName.tmp and renamed over fileName once on disk, so fileName always holds
+                    // a whole checkpoint (see Checkpoint.h). A resumed field lets go of its checkpoint
+                    // for the rename and then maps the new one, which holds the same arrays, so it keeps
+                    // running from views of the file; failures are reported and leave fileName as it was:
+                    void saveCheckpoint(const char* fileName, const unsigned long long steps, const double time);
+
+                // Snapshots (see Snapshot.h):
+
+                    // The temperatures, every cell within errorBound (> 0), compressed by the workers;
+                    // returns the size of the file in bytes:
+                    size_t saveSnapshot(const char* fileName, const double errorBound);
+
+                    // Temperatures from saveSnapshot() of a field of the same size:
+                    void loadSnapshot(const char* fileName);
 
                 // Rendering:
 
@@ -195,15 +366,150 @@
 
         private:
 
-            char** obstacles_;
+            // All grids share one padded layout (see index()):
+
+            char* obstacles_;
+
+            Real* conductivities_;
+
+            // Compiled scene: conductivity * timeStep_ / SPACE_STEP^2 for empty cells,
+            // 0 for walls, borders and ghosts (see compileScene()):
+            Real* weights_;
+
+            // Two buffers swapped by calculate():
+            Real* temperatures_;
+            Real* nextTemperatures_;
+
+            Real borderTemperature_;
+
+            // Step the weights are compiled for and the stability limit of the map (HUGE_VAL when nothing conducts);
+            // edits only ever lower the limit, compileScene() finds it again:
+            double timeStep_;
+            double stableTimeStep_;
+
+            // Column update for the ISA chosen at startup and the shape of setStencil() (see Kernels.h):
+            StencilKernel<Real> stencil_;
+            unsigned char       stencilShape_;
 
-            double** conductivities_;
-            double** temperatures_;
+            // Weights of the wider stencils' corrections, 0 where a cell they read is fixed (see compileCorrections()):
+            Real* corrections_;
+
+            // Workers for the sweeps (nullptr when single-threaded):
+            ThreadPool* pool_;
+
+            // Waves finished by each strip of a parallel sweepBlocked():
+            volatile LONG* stripProgress_;
+            size_t         stripCapacity_;
+
+            // Sparse sweeps (tile t = tx * tilesY_ + ty):
+            double sparseEpsilon_;
+
+            size_t tilesX_;
+            size_t tilesY_;
+
+            unsigned char* tileStates_;
+            unsigned char* tileWakes_;
+            Real*          tileChanges_;
+
+            size_t* activeList_;
+            size_t  activeCount_;
+
+            TileScheduler* scheduler_;
+
+            // Solvers of calculateImplicit() and solveSteadyState(), created by their first call:
+            ConjugateGradient<Real>* solver_;
+            Multigrid<Real>*         multigrid_;
+
+            unsigned int implicitCycle_;
+
+            // Integrator of calculateAdi() and the step its factors were set up for (0 after the scene changed):
+            Adi<Real>* adi_;
+            double     adiTimeStep_;
+
+            // Stage buffers of calculateSuperStep(), created by its first call:
+            SuperTimeStepping<Real>* superStepper_;
+
+            // Transforms of calculateSpectral(), created by its first call:
+            Spectral<Real>* spectral_;
+
+            // Coder of saveSnapshot() and loadSnapshot(), created by their first call:
+            Snapshot<Real>* snapshot_;
+
+            // Levels of calculateLocal() and the step they were set up for (0 after the scene changed):
+            LocalTimeStepping<Real>* localStepper_;
+            double                   localTimeStep_;
+
+            // The checkpoint the field was resumed from, whose views are the arrays; nullptr when built from maps:
+            Checkpoint<Real>* checkpoint_;
 
             HDC image_;
 
             size_t  width_;
             size_t height_;
+            size_t  pitch_;
+            size_t origin_;
+            size_t  cells_;
+
+            inline size_t index(const size_t x, const size_t y) const;
+
+            GridLayout layout() const;
+
+            void compileScene();
+            void compileCell(const size_t x, const size_t y);
+            void compileWeight(const size_t x, const size_t y);
+            void compileCorrections(const size_t startX, const size_t startY, const size_t finishX, const size_t finishY);
+
+            // Weights and corrections for another step of the same scene, in one pass over them
+            // (no stability search, no neighbours read), for the steps advance() tries:
+            void rescaleScene(const double timeStep);
+
+            // Cells the stencil reads away from the updated one:
+            size_t stencilReach() const;
+
+            // Local error of the step that led from nextTemperatures_ to temperatures_:
+            double stepError() const;
+
+            void sweepColumns(const size_t start, const size_t finish);
+            void sweepStrip(Real* buffers[2], const unsigned int depth, const size_t stripHeight, const size_t strip, volatile LONG* previousProgress, volatile LONG* progress);
+
+            void sweepBlocked(const unsigned int depth, const size_t stripHeight);
+
+            struct BlockedSweep
+            {
+                Field*       field;
+                Real*        buffers[2];
+                unsigned int depth;
+                size_t       stripHeight;
+                size_t       strips;
+            };
+
+            static void sweepColumnsTask(void* field, const unsigned int worker, const unsigned int workers);
+            static void sweepBlockedTask(void* sweep, const unsigned int worker, const unsigned int workers);
+
+            void sweepSparse();
+            void sweepTile(const size_t tile);
+            void classifyTile(const size_t tile);
+            void wakeTiles(const size_t startX, const size_t startY, const size_t finishX, const size_t finishY);
+
+            static void sweepTilesTask(void* field, const unsigned int worker, const unsigned int workers);
+
+            struct RelaxationSweep
+            {
+                Field*  field;
+                Real    omega;
+                double* residuals;
+                size_t  stride;
+            };
+
+            double relaxColumns(const size_t start, const size_t finish, const unsigned int color, const Real omega);
+
+            static void relaxTask(void* sweep, const unsigned int worker, const unsigned int workers);
+
+            // Points the arrays at the views of a valid checkpoint and keeps it:
+            void attachCheckpoint(Checkpoint<Real>* checkpoint);
+
+            Field(const Field&);
+            Field& operator=(const Field&);
     };
 
 
@@ -211,7 +517,8 @@
     //{ Constructor && destructor:
     //----------------------------------------------------------------------------
 
-        Field::Field(const char* conductivitiesFileName,
+        template <typename Real>
+        Field<Real>::Field(const char* conductivitiesFileName,
                      const char*      obstaclesFileName,
                      const char*          imageFileName,
                      const size_t width,
@@ -219,12 +526,46 @@
                      const double wallConditions,
                      const double emptySpaceConditions,
                      double (*fillingFunction) (const unsigned int x, const unsigned int y)) :
-            obstacles_      (nullptr),
-            conductivities_ (nullptr),
-            temperatures_   (nullptr),
-            image_          (nullptr),
-            width_          (width),
-            height_         (height)
+            obstacles_        (nullptr),
+            conductivities_   (nullptr),
+            weights_          (nullptr),
+            temperatures_     (nullptr),
+            nextTemperatures_ (nullptr),
+            borderTemperature_(wallConditions),
+            timeStep_         (TIME_STEP),
+            stableTimeStep_   (HUGE_VAL),
+            stencil_          (stencilKernel<Real>(stencilIsa())),
+            stencilShape_     (STENCIL_5_POINT),
+            corrections_      (nullptr),
+            pool_             (nullptr),
+            stripProgress_    (nullptr),
+            stripCapacity_    (0),
+            sparseEpsilon_    (0),
+            tilesX_           ((width  + TILE_SIZE - 1) / TILE_SIZE),
+            tilesY_           ((height + TILE_SIZE - 1) / TILE_SIZE),
+            tileStates_       (nullptr),
+            tileWakes_        (nullptr),
+            tileChanges_      (nullptr),
+            activeList_       (nullptr),
+            activeCount_      (0),
+            scheduler_        (nullptr),
+            solver_           (nullptr),
+            multigrid_        (nullptr),
+            implicitCycle_    (NO_MULTIGRID),
+            adi_              (nullptr),
+            adiTimeStep_      (0),
+            superStepper_     (nullptr),
+            spectral_         (nullptr),
+            snapshot_         (nullptr),
+            localStepper_     (nullptr),
+            localTimeStep_    (0),
+            checkpoint_       (nullptr),
+            image_            (nullptr),
+            width_            (width),
+            height_           (height),
+            pitch_            (0),
+            origin_           (0),
+            cells_            (0)
         {
             // Checking input:
 
@@ -237,51 +578,25 @@
                 image_ = txLoadImage(imageFileName);
                 assert(image_);
 
-            // Creating obstacles_ array:
-
-                obstacles_ = (char**) calloc(width_, sizeof(*obstacles_));
-                assert(obstacles_);
-
-                for (size_t x = 0; x < width_; x++)
-                {
-                    assert(0 <= x && x < width_);
-
-                    obstacles_[x] = (char*) calloc(height_, sizeof(*obstacles_[x]));
-                    assert(obstacles_[x]);
-                }
-
-            // Creating conductivities_ array:
-
-                conductivities_ = (double**) calloc(width_, sizeof(*conductivities_));
-                assert(conductivities_);
-
-                for (size_t x = 0; x < width_; x++)
-                {
-                    assert(0 <= x && x < width_);
-
-                    conductivities_[x] = (double*) calloc(height_, sizeof(*conductivities_[x]));
-                    assert(conductivities_[x]);
-                }
+            // Computing layout (see paddedLayout()):
 
-            // Creating temperatures_ array;
+                GridLayout grid = paddedLayout(width_, height_, sizeof(Real));
 
-                temperatures_ = (double**) calloc(width_, sizeof(*temperatures_));
-                assert(temperatures_);
+                pitch_  = grid.pitch;
+                origin_ = grid.origin;
+                cells_  = grid.cells;
 
-                for (size_t x = 0; x < width_; x++)
-                {
-                    assert(0 <= x && x < width_);
+            // Creating arrays (ghost cells are zero-temperature walls):
 
-                    temperatures_[x] = (double*) calloc(height_, sizeof(*temperatures_[x]));
-                    assert(temperatures_[x]);
+                obstacles_ = (char*) alignedCalloc(cells_, sizeof(*obstacles_));
+                memset(obstacles_, WALL_TILE, cells_ * sizeof(*obstacles_));
 
-                    for (size_t y = 0; y < height_; y++)
-                    {
-                        assert(0 <= y && y < height_);
+                conductivities_ = (Real*) alignedCalloc(cells_, sizeof(*conductivities_));
+                weights_        = (Real*) alignedCalloc(cells_, sizeof(*weights_));
+                corrections_    = (Real*) alignedCalloc(cells_, sizeof(*corrections_));
 
-                        temperatures_[x][y] = emptySpaceConditions;
-                    }
-                }
+                temperatures_     = (Real*) alignedCalloc(cells_, sizeof(*temperatures_));
+                nextTemperatures_ = (Real*) alignedCalloc(cells_, sizeof(*nextTemperatures_));
 
             // Filling obstacles_ array:
 
@@ -298,9 +613,14 @@
 
                         COLORREF currentColor = GetPixel(obstaclesMap, x, y);
 
-                        obstacles_[x][y] = (currentColor == RGB(  0, 0, 0))?   WALL_TILE :
-                                           (currentColor == RGB(255, 0, 0))? BORDER_TILE :
-                                                                              EMPTY_TILE;
+                        obstacles_[index(x, y)] = (currentColor == RGB(  0, 0, 0))?   WALL_TILE :
+                                                  (currentColor == RGB(255, 0, 0))? BORDER_TILE :
+                                                                                     EMPTY_TILE;
+
+                        // The outermost cells have always been fixed:
+                        bool edge = (x == 0 || y == 0 || x == width_ - 1 || y == height_ - 1);
+
+                        if (edge && obstacles_[index(x, y)] == EMPTY_TILE) obstacles_[index(x, y)] = BORDER_TILE;
                     }
                 }
 
@@ -319,7 +639,7 @@
                     {
                         assert(0 <= y && y < height_);
 
-                        conductivities_[x][y] = THERMAL_CONDUCTIVITY_COEFFICIENT * lerp(0.0, 1.0, (double) txExtractColor(GetPixel(conductivitiesMap, x, y), TX_RED) / 255);
+                        conductivities_[index(x, y)] = THERMAL_CONDUCTIVITY_COEFFICIENT * lerp(0.0, 1.0, (double) txExtractColor(GetPixel(conductivitiesMap, x, y), TX_RED) / 255);
                     }
                 }
 
@@ -328,47 +648,169 @@
 
                 txDeleteDC(conductivitiesMap);
 
+            // Compiling scene:
+
+                compileScene();
+
             // Filling temperatures_ array:
 
+                for (size_t x = 0; x < width_; x++)
+                {
+                    assert(0 <= x && x < width_);
+
+                    for (size_t y = 0; y < height_; y++)
+                    {
+                        assert(0 <= y && y < height_);
+
+                        // Walls are always seen as zero by their neighbours:
+                        temperatures_[index(x, y)] = (obstacles_[index(x, y)] == WALL_TILE)? 0 : emptySpaceConditions;
+                    }
+                }
+
                 setWallConditions(wallConditions);
 
                 if (fillingFunction != nullptr) setFieldConditions(fillingFunction);
 
+                // Cells that calculate() never changes must be equal in both buffers:
+                memcpy(nextTemperatures_, temperatures_, cells_ * sizeof(*temperatures_));
+
             // Checking output:
 
                 assert(ok());
         }
 
-        Field::~Field()
+        template <typename Real>
+        Field<Real>::Field(Checkpoint<Real>* checkpoint,
+                           const char*      imageFileName,
+                           unsigned long long* steps,
+                           double*             time) :
+            obstacles_        (nullptr),
+            conductivities_   (nullptr),
+            weights_          (nullptr),
+            temperatures_     (nullptr),
+            nextTemperatures_ (nullptr),
+            borderTemperature_(0),
+            timeStep_         (TIME_STEP),
+            stableTimeStep_   (HUGE_VAL),
+            stencil_          (stencilKernel<Real>(stencilIsa())),
+            stencilShape_     (STENCIL_5_POINT),
+            corrections_      (nullptr),
+            pool_             (nullptr),
+            stripProgress_    (nullptr),
+            stripCapacity_    (0),
+            sparseEpsilon_    (0),
+            tilesX_           (0),
+            tilesY_           (0),
+            tileStates_       (nullptr),
+            tileWakes_        (nullptr),
+            tileChanges_      (nullptr),
+            activeList_       (nullptr),
+            activeCount_      (0),
+            scheduler_        (nullptr),
+            solver_           (nullptr),
+            multigrid_        (nullptr),
+            implicitCycle_    (NO_MULTIGRID),
+            adi_              (nullptr),
+            adiTimeStep_      (0),
+            superStepper_     (nullptr),
+            spectral_         (nullptr),
+            snapshot_         (nullptr),
+            localStepper_     (nullptr),
+            localTimeStep_    (0),
+            checkpoint_       (nullptr),
+            image_            (nullptr),
+            width_            (0),
+            height_           (0),
+            pitch_            (0),
+            origin_           (0),
+            cells_            (0)
         {
-            assert(ok());
+            // Checking input:
 
-            for (size_t x = 0; x < width_; x++)
-            {
-                assert(0 <= x && x < width_);
+                assert(checkpoint != nullptr && checkpoint->valid());
+                assert(imageFileName != nullptr);
+                assert(steps != nullptr && time != nullptr);
 
-                free(obstacles_[x]);
-            }
+            // Creating image:
+
+                image_ = txLoadImage(imageFileName);
+                assert(image_);
 
-            free(obstacles_);
+            // Computing layout (the checkpoint checked it is the one this build computes for the size):
 
-            for (size_t x = 0; x < width_; x++)
-            {
-                assert(0 <= x && x < width_);
+                const CheckpointHeader& header = checkpoint->header();
 
-                free(conductivities_[x]);
-            }
+                const GridLayout grid = paddedLayout((size_t) header.width, (size_t) header.height, sizeof(Real));
+
+                width_  = grid.width;
+                height_ = grid.height;
+                pitch_  = grid.pitch;
+                origin_ = grid.origin;
+                cells_  = grid.cells;
+
+                tilesX_ = (width_  + TILE_SIZE - 1) / TILE_SIZE;
+                tilesY_ = (height_ + TILE_SIZE - 1) / TILE_SIZE;
+
+            // Pointing arrays at the sections:
+
+                attachCheckpoint(checkpoint);
+
+            // Restoring state (the weights were compiled for it, nothing is recompiled):
+
+                borderTemperature_ = (Real) header.borderTemperature;
+
+                timeStep_       = header.timeStep;
+                stableTimeStep_ = header.stableTimeStep;
+
+                stencilShape_ = (unsigned char) header.stencilShape;
+                stencil_      = stencilKernel<Real>(stencilIsa(), stencilShape_);
+
+                *steps = header.steps;
+                *time  = header.time;
+
+            // Checking output:
+
+                assert(ok());
+        }
 
-            free(conductivities_);
+        template <typename Real>
+        Field<Real>::~Field()
+        {
+            assert(ok());
 
-            for (size_t x = 0; x < width_; x++)
+            if (checkpoint_ != nullptr)
             {
-                assert(0 <= x && x < width_);
+                delete checkpoint_;
+            }
+            else
+            {
+                alignedFree(obstacles_);
+                alignedFree(conductivities_);
+                alignedFree(weights_);
+                alignedFree(corrections_);
 
-                free(temperatures_[x]);
+                alignedFree(temperatures_);
+                alignedFree(nextTemperatures_);
             }
 
-            free(temperatures_);
+            delete pool_;
+            free((void*) stripProgress_);
+
+            free(tileStates_);
+            free(tileWakes_);
+            free(tileChanges_);
+            free(activeList_);
+
+            delete scheduler_;
+
+            delete solver_;
+            delete multigrid_;
+
+            delete adi_;
+            delete superStepper_;
+            delete spectral_;
+            delete snapshot_;
+            delete localStepper_;
 
             txDeleteDC(image_);
         }
@@ -385,7 +827,8 @@
         //{ Debugging
         //----------------------------------------------------------------------------
 
-            bool Field::ok() const
+            template <typename Real>
+            bool Field<Real>::ok() const
             {
                 bool everythingOk = true;
 
@@ -395,21 +838,15 @@
                     printf("Field::ok(): Obstacles array is a null pointer.");
                 }
 
-                for (size_t x = 0; x < width_; x++)
+                for (size_t x = 0; obstacles_ != nullptr && x < width_; x++)
                 {
                     assert(0 <= x && x < width_);
 
-                    if (obstacles_[x] == nullptr)
-                    {
-                        everythingOk = false;
-                        printf("Field::ok(): obstacles_[%02d] is a null pointer.", x);
-                    }
-
                     for (size_t y = 0; y < height_; y++)
                     {
                         assert(0 <= y && y < height_);
 
-                        if (obstacles_[x][y] > 2)
+                        if (obstacles_[index(x, y)] > 2)
                         {
                             everythingOk = false;
                             printf("Field::ok(): obstacles_[%02d][%02d] is invalid tile type.", x, y);
@@ -423,32 +860,34 @@
                     printf("Field::ok(): Conductivities array is a null pointer.");
                 }
 
-                for (size_t x = 0; x < width_; x++)
+                if (weights_ == nullptr || corrections_ == nullptr)
                 {
-                    assert(0 <= x && x < width_);
+                    everythingOk = false;
+                    printf("Field::ok(): Weights array is a null pointer.");
+                }
 
-                    if (conductivities_[x] == nullptr)
-                    {
-                        everythingOk = false;
-                        printf("Field::ok(): conductivities_[%02d] is a null pointer.", x);
-                    }
+                if (stencilShape_ > STENCIL_4TH_ORDER)
+                {
+                    everythingOk = false;
+                    printf("Field::ok(): Stencil shape %d is invalid.", stencilShape_);
                 }
 
-                if (temperatures_ == nullptr)
+                if (temperatures_ == nullptr || nextTemperatures_ == nullptr)
                 {
                     everythingOk = false;
-                    printf("Field::ok(): Temperature array is a null pointer.");
+                    printf("Field::ok(): Temperature buffer is a null pointer.");
                 }
 
-                for (size_t x = 0; x < width_; x++)
+                if (pitch_ < height_ + 2 * GRID_HALO || pitch_ % (GRID_ALIGNMENT/sizeof(Real)) != 0)
                 {
-                    assert(0 <= x && x < width_);
+                    everythingOk = false;
+                    printf("Field::ok(): Pitch %d is invalid for height %d.", pitch_, height_);
+                }
 
-                    if (temperatures_[x] == nullptr)
-                    {
-                        everythingOk = false;
-                        printf("Field::ok(): temperature_[%02d] is a null pointer.", x);
-                    }
+                if (origin_ % (GRID_ALIGNMENT/sizeof(Real)) != 0 || index(width_, height_) >= cells_)
+                {
+                    everythingOk = false;
+                    printf("Field::ok(): Origin %d is invalid for %d cells.", origin_, cells_);
                 }
 
                 if (image_ == nullptr)
@@ -477,103 +916,349 @@
 
 
         //----------------------------------------------------------------------------
-        //{ Conditions setting
+        //{ Memory layout
         //----------------------------------------------------------------------------
 
-            void Field::setWallConditions(const double borderTemperature /*= 1.0*/)
+            template <typename Real>
+            inline size_t Field<Real>::index(const size_t x, const size_t y) const
             {
-                // Checking input:
+                return origin_ + x * pitch_ + y;
+            }
 
-                    assert(ok());
+            template <typename Real>
+            GridLayout Field<Real>::layout() const
+            {
+                GridLayout grid = {width_, height_, pitch_, origin_, cells_};
 
-                // Main algorithm:
+                return grid;
+            }
 
-                    for (size_t x = 0; x < width_; x++)
-                    {
-                        assert(0 <= x && x < width_);
+        //}
+        //----------------------------------------------------------------------------
 
-                        // Upper wall:
-                        temperatures_[x][0] = borderTemperature;
 
-                        // Bottom wall:
-                        temperatures_[x][height_ - 1] = borderTemperature;
-                    }
+        //----------------------------------------------------------------------------
+        //{ Scene compilation
+        //----------------------------------------------------------------------------
 
-                    for (size_t y = 0; y < height_; y++)
-                    {
-                        assert(0 <= y && y < height_);
+            // Geometry and conductivity only change through the constructor and the editor,
+            // so everything calculate() needs besides temperatures is folded into weights_ here.
 
-                        // Left wall:
-                        temperatures_[0][y] = borderTemperature;
+            template <typename Real>
+            void Field<Real>::compileScene()
+            {
+                // An explicit step keeps the maximum principle while 1 - 4 * weight >= 0
+                // (the fourth order stencil is only stable for 3/4 of that step, see setStencil()):
 
-                        // Right wall:
-                        temperatures_[width_ - 1][y] = borderTemperature;
-                    }
+                const double stability = (stencilShape_ == STENCIL_4TH_ORDER)? FOURTH_ORDER_STABILITY : 1;
 
-                    for (size_t x = 1; x < width_ - 1; x++)
+                stableTimeStep_ = HUGE_VAL;
+
+                for (size_t x = 0; x < width_; x++)
+                {
+                    for (size_t y = 0; y < height_; y++)
                     {
-                        assert(1 <= x && x < width_ - 1);
+                        const double conductivity = conductivities_[index(x, y)];
 
-                        for (size_t y = 1; y < height_ - 1; y++)
+                        if (obstacles_[index(x, y)] == EMPTY_TILE && conductivity > 0)
                         {
-                            assert(1 <= y && y < height_ - 1);
-
-                            if (obstacles_[x][y] == BORDER_TILE) temperatures_[x][y] = borderTemperature;
+                            stableTimeStep_ = std::min(stableTimeStep_, stability * SPACE_STEP * SPACE_STEP / (4 * conductivity));
                         }
                     }
+                }
 
-                // Checking output;
+                if (timeStep_ > stableTimeStep_) timeStep_ = stableTimeStep_;
 
-                    assert(ok());
+                for (size_t x = 0; x < width_; x++)
+                {
+                    assert(0 <= x && x < width_);
+
+                    for (size_t y = 0; y < height_; y++)
+                    {
+                        assert(0 <= y && y < height_);
+
+                        compileWeight(x, y);
+                    }
+                }
+
+                compileCorrections(0, 0, width_, height_);
             }
 
-            void Field::setFieldConditions(double (*gradientFunction) (const unsigned int x, const unsigned int y))
+            // A cell's weight changes the corrections of every cell whose stencil reads it:
+            template <typename Real>
+            void Field<Real>::compileCell(const size_t x, const size_t y)
             {
-                // Checking input:
+                assert(0 <= x && x <  width_);
+                assert(0 <= y && y < height_);
 
-                    assert(ok());
+                const size_t reach = stencilReach();
 
-                // Main algorithm:
+                compileWeight(x, y);
 
-                    for (size_t x = 1; x < width_ - 1; x++)
-                    {
-                        assert(1 <= x && x < width_ - 1);
+                compileCorrections((x < reach)? 0 : x - reach, (y < reach)? 0 : y - reach,
+                                   std::min(x + reach + 1, width_), std::min(y + reach + 1, height_));
+            }
 
-                        for (size_t y = 1; y < height_ - 1; y++)
-                        {
-                            assert(1 <= y && y < height_ - 1);
+            template <typename Real>
+            void Field<Real>::compileWeight(const size_t x, const size_t y)
+            {
+                assert(0 <= x && x <  width_);
+                assert(0 <= y && y < height_);
 
-                            if (obstacles_[x][y] == EMPTY_TILE) temperatures_[x][y] = gradientFunction(x, y);
-                        }
-                    }
+                const double conductivity = conductivities_[index(x, y)];
 
-                // Checking output:
+                weights_[index(x, y)] = (obstacles_[index(x, y)] == EMPTY_TILE)?
+                                        conductivity * timeStep_ / (SPACE_STEP * SPACE_STEP) : 0;
 
-                    assert(ok());
+                if (obstacles_[index(x, y)] == EMPTY_TILE && conductivity > 0)
+                {
+                    const double stability = (stencilShape_ == STENCIL_4TH_ORDER)? FOURTH_ORDER_STABILITY : 1;
+
+                    stableTimeStep_ = std::min(stableTimeStep_, stability * SPACE_STEP * SPACE_STEP / (4 * conductivity));
+                }
+
+                adiTimeStep_   = 0;
+                localTimeStep_ = 0;
             }
 
-            // Hate it
-            // Mixed style -___-
-            void Field::editorMode(const unsigned int brushRadius, double brushDeltaTemperature, const unsigned int zoom /*= 1*/)
+            // A wider stencil only knows how to reach across unknown cells: a wall or border one cell away
+            // is the boundary itself and anything beyond it is the other side. So a cell gets its
+            // correction (weight / 6 or weight / 12) only when every cell the stencil reads conducts,
+            // and stays 5-point, still second order, next to fixed cells:
+            template <typename Real>
+            void Field<Real>::compileCorrections(const size_t startX, const size_t startY, const size_t finishX, const size_t finishY)
             {
-                // Checking input:
+                assert(startX <= finishX && finishX <= width_);
+                assert(startY <= finishY && finishY <= height_);
 
-                    assert(ok());
-
-                // Main algorithm:
+                // Offsets of the extra cells each shape reads:
 
-                    txClearConsole();
-                    puts("[EDITOR MODE]");
+                    const int diagonals [4][2] = {{-1, -1}, {-1, 1}, { 1, -1}, {1, 1}};
+                    const int secondRing[4][2] = {{-2,  0}, { 2, 0}, { 0, -2}, {0, 2}};
+                    const int sides     [4][2] = {{-1,  0}, { 1, 0}, { 0, -1}, {0, 1}};
 
-                    while (!GetAsyncKeyState(VK_RSHIFT) && !GetAsyncKeyState(VK_ESCAPE))
+                for (size_t x = startX; x < finishX; x++)
+                {
+                    for (size_t y = startY; y < finishY; y++)
                     {
-                        if (txMouseButtons() == 1)
+                        const size_t cell = index(x, y);
+
+                        corrections_[cell] = 0;
+
+                        if (stencilShape_ == STENCIL_5_POINT || weights_[cell] <= 0) continue;
+
+                        const int (*extra)[2] = (stencilShape_ == STENCIL_9_POINT)? diagonals : secondRing;
+
+                        bool inside = true;
+
+                        for (unsigned int n = 0; n < 4; n++)
                         {
-                            adjustTemperature(txMouseX()/zoom, txMouseY()/zoom, brushRadius, brushDeltaTemperature);
+                            // Ghosts have zero weight, so the reads never need bounds:
+                            inside = inside && weights_[cell + sides[n][0] * (int) pitch_ + sides[n][1]] > 0
+                                            && weights_[cell + extra[n][0] * (int) pitch_ + extra[n][1]] > 0;
                         }
 
-                        if (GetAsyncKeyState('S')) brushDeltaTemperature -= 1;
-                        if (GetAsyncKeyState('W')) brushDeltaTemperature += 1;
+                        if (inside) corrections_[cell] = weights_[cell] / ((stencilShape_ == STENCIL_9_POINT)? 6 : 12);
+                    }
+                }
+            }
+
+            // Weights are linear in the step and a correction is a fixed share of its weight, so both
+            // come out exactly as compileScene() would make them:
+            template <typename Real>
+            void Field<Real>::rescaleScene(const double timeStep)
+            {
+                assert(0 < timeStep && timeStep <= stableTimeStep_);
+
+                if (timeStep == timeStep_) return;
+
+                timeStep_ = timeStep;
+
+                const Real divisor = (stencilShape_ == STENCIL_9_POINT)? 6 : 12;
+
+                for (size_t cell = 0; cell < cells_; cell++)
+                {
+                    if (weights_[cell] == 0) continue;
+
+                    weights_[cell] = (Real) ((double) conductivities_[cell] * timeStep_ / (SPACE_STEP * SPACE_STEP));
+
+                    if (corrections_[cell] != 0) corrections_[cell] = weights_[cell] / divisor;
+                }
+
+                adiTimeStep_   = 0;
+                localTimeStep_ = 0;
+            }
+
+            template <typename Real>
+            size_t Field<Real>::stencilReach() const
+            {
+                return (stencilShape_ == STENCIL_4TH_ORDER)? 2 : 1;
+            }
+
+            template <typename Real>
+            void Field<Real>::setObstacle(const size_t x, const size_t y, const char tile)
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                    assert(0 < x && x <  width_ - 1);
+                    assert(0 < y && y < height_ - 1);
+
+                    assert(tile == EMPTY_TILE || tile == BORDER_TILE || tile == WALL_TILE);
+
+                // Main algorithm:
+
+                    obstacles_[index(x, y)] = tile;
+
+                    if (tile ==   WALL_TILE) temperatures_[index(x, y)] = nextTemperatures_[index(x, y)] = 0;
+                    if (tile == BORDER_TILE) temperatures_[index(x, y)] = nextTemperatures_[index(x, y)] = borderTemperature_;
+
+                    compileCell(x, y);
+
+                    // A better conductor than any before may need a smaller step:
+                    if (timeStep_ > stableTimeStep_) setTimeStep(stableTimeStep_);
+
+                    if (tileStates_ != nullptr)
+                    {
+                        classifyTile((x / TILE_SIZE) * tilesY_ + y / TILE_SIZE);
+                        wakeTiles(x, y, x + 1, y + 1);
+                    }
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+            template <typename Real>
+            void Field<Real>::setConductivity(const size_t x, const size_t y, const double conductivity)
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                    assert(0 <= x && x <  width_);
+                    assert(0 <= y && y < height_);
+
+                    assert(0 <= conductivity);
+
+                // Main algorithm:
+
+                    conductivities_[index(x, y)] = conductivity;
+
+                    compileCell(x, y);
+
+                    // A better conductor than any before may need a smaller step:
+                    if (timeStep_ > stableTimeStep_) setTimeStep(stableTimeStep_);
+
+                    if (tileStates_ != nullptr)
+                    {
+                        classifyTile((x / TILE_SIZE) * tilesY_ + y / TILE_SIZE);
+                        wakeTiles(x, y, x + 1, y + 1);
+                    }
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+
+        //----------------------------------------------------------------------------
+        //{ Conditions setting
+        //----------------------------------------------------------------------------
+
+            template <typename Real>
+            void Field<Real>::setWallConditions(const double borderTemperature /*= 1.0*/)
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                // Main algorithm:
+
+                    borderTemperature_ = borderTemperature;
+
+                    // The picture's outer frame was marked as BORDER_TILE by the constructor:
+
+                    for (size_t x = 0; x < width_; x++)
+                    {
+                        assert(0 <= x && x < width_);
+
+                        for (size_t y = 0; y < height_; y++)
+                        {
+                            assert(0 <= y && y < height_);
+
+                            if (obstacles_[index(x, y)] == BORDER_TILE) temperatures_[index(x, y)] = nextTemperatures_[index(x, y)] = borderTemperature;
+                        }
+                    }
+
+                    if (tileStates_ != nullptr) wakeTiles(0, 0, width_, height_);
+
+                // Checking output;
+
+                    assert(ok());
+            }
+
+            template <typename Real>
+            void Field<Real>::setFieldConditions(double (*gradientFunction) (const unsigned int x, const unsigned int y))
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                // Main algorithm:
+
+                    for (size_t x = 1; x < width_ - 1; x++)
+                    {
+                        assert(1 <= x && x < width_ - 1);
+
+                        for (size_t y = 1; y < height_ - 1; y++)
+                        {
+                            assert(1 <= y && y < height_ - 1);
+
+                            if (obstacles_[index(x, y)] == EMPTY_TILE) temperatures_[index(x, y)] = gradientFunction(x, y);
+                        }
+                    }
+
+                    if (tileStates_ != nullptr) wakeTiles(0, 0, width_, height_);
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+            // Hate it
+            // Mixed style -___-
+            template <typename Real>
+            void Field<Real>::editorMode(const unsigned int brushRadius, double brushDeltaTemperature, const unsigned int zoom /*= 1*/)
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                // Main algorithm:
+
+                    txClearConsole();
+                    puts("[EDITOR MODE]");
+
+                    while (!GetAsyncKeyState(VK_RSHIFT) && !GetAsyncKeyState(VK_ESCAPE))
+                    {
+                        if (txMouseButtons() == 1)
+                        {
+                            adjustTemperature(txMouseX()/zoom, txMouseY()/zoom, brushRadius, brushDeltaTemperature);
+                        }
+
+                        // Right button draws walls, with 'E' held it erases them:
+                        if (txMouseButtons() == 2)
+                        {
+                            adjustObstacles(txMouseX()/zoom, txMouseY()/zoom, brushRadius, (GetAsyncKeyState('E'))? EMPTY_TILE : WALL_TILE);
+                        }
+
+                        if (GetAsyncKeyState('S')) brushDeltaTemperature -= 1;
+                        if (GetAsyncKeyState('W')) brushDeltaTemperature += 1;
 
                         if (GetAsyncKeyState(VK_SPACE))
                         {
@@ -601,7 +1286,8 @@
 
             }
 
-            void Field::adjustTemperature(const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const double deltaTemperature)
+            template <typename Real>
+            void Field<Real>::adjustTemperature(const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const double deltaTemperature)
             {
                 // Checking input:
 
@@ -627,17 +1313,51 @@
                     {
                         for (size_t y = startY; y < finishY; y++)
                         {
-                            if (obstacles_[x][y] == EMPTY_TILE)
+                            if (obstacles_[index(x, y)] == EMPTY_TILE)
                             {
                                 if (pow((signed) roundX - (signed) x, 2) + pow((signed) roundY - (signed) y, 2) < pow(radius, 2))
                                 {
-                                    if  (temperatures_[x][y] + deltaTemperature < 0) temperatures_[x][y] = 0;
-                                    else temperatures_[x][y] += deltaTemperature;
+                                    if  (temperatures_[index(x, y)] + deltaTemperature < 0) temperatures_[index(x, y)] = 0;
+                                    else temperatures_[index(x, y)] += deltaTemperature;
+
+                                    // Sparse sweeps never rewrite fixed tiles, so both buffers must hold the new value:
+                                    nextTemperatures_[index(x, y)] = temperatures_[index(x, y)];
                                 }
                             }
                         }
                     }
 
+                    if (tileStates_ != nullptr) wakeTiles(startX, startY, finishX, finishY);
+
+            }
+
+            template <typename Real>
+            void Field<Real>::adjustObstacles(const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const char tile)
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                // Creating resources (the outer frame stays fixed):
+
+                    unsigned int startX = (roundX < radius + 1)? 1 : roundX - radius;
+                    unsigned int startY = (roundY < radius + 1)? 1 : roundY - radius;
+
+                    unsigned int finishX = (roundX + radius <  width_ - 1)? roundX + radius :  width_ - 1;
+                    unsigned int finishY = (roundY + radius < height_ - 1)? roundY + radius : height_ - 1;
+
+                // Main algorithm:
+
+                    for (size_t x = startX; x < finishX; x++)
+                    {
+                        for (size_t y = startY; y < finishY; y++)
+                        {
+                            if (pow((signed) roundX - (signed) x, 2) + pow((signed) roundY - (signed) y, 2) < pow(radius, 2))
+                            {
+                                if (obstacles_[index(x, y)] != tile) setObstacle(x, y, tile);
+                            }
+                        }
+                    }
             }
 
         //}
@@ -648,7 +1368,8 @@
         //{ Calculations
         //----------------------------------------------------------------------------
 
-            void Field::calculate()
+            template <typename Real>
+            void Field<Real>::calculate()
             {
                 // Checking input:
 
@@ -662,79 +1383,1348 @@
                         txSetFillColor(TX_BLUE);
                         txSetColor    (TX_BLUE);
 
-                        printf("T[105][150] == %f     \n", temperatures_[105][150]); txCircle(105 * 3, 150 * 3, 6);
-                        printf("T[105][160] == %f     \n", temperatures_[105][170]); txCircle(105 * 3, 160 * 3, 6);
-                        printf("T[105][165] == %f     \n", temperatures_[105][165]); txCircle(105 * 3, 165 * 3, 6);
-                        printf("T[110][175] == %f     \n", temperatures_[110][175]); txCircle(110 * 3, 175 * 3, 6);
-                        printf("T[115][180] == %f     \n", temperatures_[115][180]); txCircle(115 * 3, 180 * 3, 6);
-                        printf("T[165][190] == %f     \n", temperatures_[165][190]); txCircle(165 * 3, 190 * 3, 6);
+                        printf("T[105][150] == %f     \n", temperatures_[index(105, 150)]); txCircle(105 * 3, 150 * 3, 6);
+                        printf("T[105][160] == %f     \n", temperatures_[index(105, 170)]); txCircle(105 * 3, 160 * 3, 6);
+                        printf("T[105][165] == %f     \n", temperatures_[index(105, 165)]); txCircle(105 * 3, 165 * 3, 6);
+                        printf("T[110][175] == %f     \n", temperatures_[index(110, 175)]); txCircle(110 * 3, 175 * 3, 6);
+                        printf("T[115][180] == %f     \n", temperatures_[index(115, 180)]); txCircle(115 * 3, 180 * 3, 6);
+                        printf("T[165][190] == %f     \n", temperatures_[index(165, 190)]); txCircle(165 * 3, 190 * 3, 6);
 
                         txSleep(100);
                     }
 
                     if (txMouseButtons() == 1)
                         printf("Temperature[%02d][%02d] == %.2f     \r",
-                               txMouseX()/3, txMouseY()/3, temperatures_[txMouseX()/3][txMouseY()/3] * 10);
+                               txMouseX()/3, txMouseY()/3, temperatures_[index(txMouseX()/3, txMouseY()/3)] * 10);
+
 
+                // Main algorithm:
 
-                    double** nextTemperatures_ = (double**) calloc(width_, sizeof(*nextTemperatures_));
-                    assert(temperatures_);
+                    // Walls hold zero and every fixed cell has zero weight,
+                    // so each column is one branch-free multiply-add sweep:
 
-                    for (size_t x = 0; x < width_; x++)
+                    if (sparseEpsilon_ > 0)
                     {
-                        assert(0 <= x && x < width_);
+                        sweepSparse();
+                        return;
+                    }
+
+                    if (pool_ != nullptr) pool_->run(sweepColumnsTask, this);
+                    else                  sweepColumns(0, width_);
+
+                    Real* currentTemperatures = temperatures_;
+
+                    temperatures_     = nextTemperatures_;
+                    nextTemperatures_ = currentTemperatures;
+
+                // Checking input:
+
+                    assert(ok());
+            }
+
+            template <typename Real>
+            void Field<Real>::calculate(const unsigned int steps)
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                // Main algorithm:
+
+                    // Sparse sweeps decide activity every step, they cannot be blocked in time:
+                    if (sparseEpsilon_ > 0)
+                    {
+                        for (unsigned int step = 0; step < steps; step++) sweepSparse();
+                        return;
+                    }
+
+                    // The wavefront of sweepBlocked() leans back one cell per step, too little for a stencil reaching two:
+                    if (stencilReach() > 1)
+                    {
+                        for (unsigned int step = 0; step < steps; step++) calculate();
+                        return;
+                    }
+
+                    size_t stripHeight = TEMPORAL_BLOCK_HEIGHT;
+
+                    if (pool_ != nullptr)
+                    {
+                        size_t sharedHeight = (height_ + 2 * pool_->size() - 1) / (2 * pool_->size());
 
-                        nextTemperatures_[x] = (double*) calloc(height_, sizeof(*nextTemperatures_[x]));
-                        assert(nextTemperatures_[x]);
+                        if (sharedHeight < stripHeight)               stripHeight = sharedHeight;
+                        if (stripHeight  < TEMPORAL_BLOCK_MIN_HEIGHT) stripHeight = TEMPORAL_BLOCK_MIN_HEIGHT;
                     }
 
+                    for (unsigned int done = 0; done < steps; done += TEMPORAL_BLOCK_DEPTH)
+                    {
+                        unsigned int depth = (steps - done < TEMPORAL_BLOCK_DEPTH)? steps - done : TEMPORAL_BLOCK_DEPTH;
+
+                        sweepBlocked(depth, stripHeight);
+                    }
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+            // With a = conductivity * timeStep / SPACE_STEP^2 the theta scheme is
+            //     T' - theta a lap T' = T + (1 - theta) a lap T,
+            // and dividing every row by theta a makes the system symmetric:
+            //     (1/(theta a) + 4) T' - sum of unknown neighbours T' = T/(theta a) + (1 - theta)/theta lap T + sum of fixed neighbours T.
+            // Cells with zero weight keep their value, exactly like in calculate().
+            template <typename Real>
+            unsigned int Field<Real>::calculateImplicit(const double timeStep, const double theta /*= BACKWARD_EULER*/)
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                    assert(timeStep > 0);
+                    assert(0 < theta && theta <= 1);
+
+                // Creating resources:
+
+                    if (solver_ == nullptr) solver_ = new ConjugateGradient<Real>(layout());
+
+                    if (implicitCycle_ != NO_MULTIGRID && multigrid_ == nullptr) multigrid_ = new Multigrid<Real>(layout());
+
+                    Real* diagonal = solver_->diagonal();
+                    Real* rhs      = solver_->rhs();
+
+                    const Real* current = temperatures_;
+
+                    // weights_ were compiled for timeStep_:
+                    const double scale = timeStep / timeStep_;
+
                 // Main algorithm:
 
-                    for (size_t x = 1; x < width_ - 1; x++)
+                    for (size_t x = 0; x < width_; x++)
                     {
-                        assert(1 <= x && x < width_ - 1);
+                        const size_t column = index(x, 0);
 
-                        for (size_t y = 1; y < height_ - 1; y++)
+                        for (size_t cell = column; cell < column + height_; cell++)
                         {
-                            assert(1 <= y && y < height_ - 1);
+                            const double a = weights_[cell] * scale;
 
-                            if (obstacles_[x][y] == EMPTY_TILE)
+                            if (a <= 0)
                             {
-                                double nextTemperature  = (obstacles_[x - 1][y] != WALL_TILE)? temperatures_[x - 1][y] : 0;
-                                       nextTemperature += (obstacles_[x + 1][y] != WALL_TILE)? temperatures_[x + 1][y] : 0;
+                                diagonal[cell] = 0;
+                                rhs     [cell] = 0;
+
+                                continue;
+                            }
 
-                                       nextTemperature += -4 * temperatures_[x][y];
+                            const Real left = current[cell - pitch_], right = current[cell + pitch_],
+                                       up   = current[cell - 1],      down  = current[cell + 1];
 
-                                       nextTemperature += (obstacles_[x][y - 1] != WALL_TILE)? temperatures_[x][y - 1] : 0;
-                                       nextTemperature += (obstacles_[x][y + 1] != WALL_TILE)? temperatures_[x][y + 1] : 0;
+                            const double laplacian = (left + right) + (up + down) - 4.0 * current[cell];
 
-                                       nextTemperature *= conductivities_[x][y];
-                                       nextTemperature *= TIME_STEP;
-                                       nextTemperature /= SPACE_STEP * SPACE_STEP;
+                            const double fixed = ((weights_[cell - pitch_] > 0)? 0 : left) + ((weights_[cell + pitch_] > 0)? 0 : right) +
+                                                 ((weights_[cell - 1]      > 0)? 0 : up)   + ((weights_[cell + 1]      > 0)? 0 : down);
 
-                                       nextTemperature += temperatures_[x][y];
+                            const double inverse = 1 / (theta * a);
 
-                                nextTemperatures_[x][y] = nextTemperature;
-                            }
+                            diagonal[cell] = inverse + 4;
+                            rhs     [cell] = current[cell] * inverse + (1 - theta) / theta * laplacian + fixed;
                         }
                     }
 
-                    for (size_t x = 0; x < width_; x++)
+                    // Fixed cells are equal in both buffers, the current values are the initial guess:
+                    memcpy(nextTemperatures_, temperatures_, cells_ * sizeof(*temperatures_));
+
+                    if (implicitCycle_ != NO_MULTIGRID) multigrid_->setCycle(implicitCycle_);
+
+                    unsigned int iterations = solver_->solve(nextTemperatures_, IMPLICIT_TOLERANCE, IMPLICIT_MAX_ITERATIONS,
+                                                             (implicitCycle_ != NO_MULTIGRID)? multigrid_ : nullptr);
+
+                    Real* currentTemperatures = temperatures_;
+
+                    temperatures_     = nextTemperatures_;
+                    nextTemperatures_ = currentTemperatures;
+
+                    // Every unknown moved, frozen tiles would hold stale values in the other buffer:
+                    if (tileStates_ != nullptr) wakeTiles(0, 0, width_, height_);
+
+                // Checking output:
+
+                    assert(ok());
+
+                    return iterations;
+            }
+
+            template <typename Real>
+            void Field<Real>::calculateAdi(const double timeStep)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(timeStep > 0);
+
+                // Creating resources:
+
+                    if (adi_ == nullptr) adi_ = new Adi<Real>(layout());
+
+                    if (adiTimeStep_ != timeStep)
                     {
-                        assert(0 <= x && x < width_);
+                        adi_->setup(weights_, timeStep / timeStep_);
 
-                        free(temperatures_[x]);
+                        adiTimeStep_ = timeStep;
                     }
 
-                    free(temperatures_);
+                // Main algorithm:
 
-                    temperatures_ = nextTemperatures_;
+                    adi_->step(temperatures_, nextTemperatures_, pool_);
 
-                // Checking input:
+                    Real* currentTemperatures = temperatures_;
+
+                    temperatures_     = nextTemperatures_;
+                    nextTemperatures_ = currentTemperatures;
+
+                    if (tileStates_ != nullptr) wakeTiles(0, 0, width_, height_);
+
+                // Checking output:
 
                     assert(ok());
             }
 
+            template <typename Real>
+            double Field<Real>::stableTimeStep() const
+            {
+                return stableTimeStep_;
+            }
+
+            template <typename Real>
+            double Field<Real>::timeStep() const
+            {
+                return timeStep_;
+            }
+
+            template <typename Real>
+            void Field<Real>::setTimeStep(const double timeStep)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(0 < timeStep && timeStep <= stableTimeStep_);
+
+                // Main algorithm:
+
+                    timeStep_ = timeStep;
+
+                    compileScene();
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+            // The 5-point Laplacian is second order with an error that depends on direction, so fronts
+            // on a coarse grid turn into squares. The 9-point one mixes in the diagonals to make the
+            // leading error isotropic, the fourth order one reads the cells two away and is accurate
+            // to h^4, but its largest eigenvalue is 4/3 of the 5-point one, so the stable step shrinks
+            // to 3/4 of it. Each shape is its own kernel (see Kernels.h), the choice costs nothing per cell.
+            template <typename Real>
+            void Field<Real>::setStencil(const unsigned char shape)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(shape == STENCIL_5_POINT || shape == STENCIL_9_POINT || shape == STENCIL_4TH_ORDER);
+
+                // Main algorithm:
+
+                    stencilShape_ = shape;
+                    stencil_      = stencilKernel<Real>(stencilIsa(), shape);
+
+                    // Corrections and, for the fourth order stencil, a smaller step:
+                    compileScene();
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+            template <typename Real>
+            unsigned char Field<Real>::stencil() const
+            {
+                return stencilShape_;
+            }
+
+            template <typename Real>
+            Real Field<Real>::temperature(const size_t x, const size_t y) const
+            {
+                assert(x < width_ && y < height_);
+
+                return temperatures_[index(x, y)];
+            }
+
+            // Without a tolerance the time is split into equal steps just below the stability limit,
+            // which calculate(steps) takes with all its blocking. With a tolerance every step is checked:
+            // forward Euler makes a local error of dt^2/2 T'' = (w lap)^2 T / 2, and since the step's
+            // change d already is w lap T, that is w lap d / 2, read off the two buffers. A step over
+            // the tolerance is undone, and the error growing as dt^2 tells the next step to try.
+            // Fixed temperatures are the only sources, so the error never grows back once the limit caps the step.
+            // The steps tried only rescale the weights (see rescaleScene()), and the field's own step
+            // is back when advance() returns.
+            template <typename Real>
+            unsigned int Field<Real>::advance(const double time, const double tolerance /*= 0*/)
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                    assert(time >= 0);
+                    assert(tolerance >= 0);
+
+                // Nothing conducts, nothing changes:
+
+                    if (stableTimeStep_ == HUGE_VAL || time == 0) return 0;
+
+                // Exact solution, which makes the tolerance moot:
+
+                    if (stencilShape_ == STENCIL_5_POINT && calculateSpectral(time)) return 1;
+
+                // Creating resources:
+
+                    const double largestStep = STABLE_STEP_FRACTION * stableTimeStep_;
+
+                    const double fieldStep = timeStep_;
+
+                // Main algorithm:
+
+                    if (tolerance == 0)
+                    {
+                        const unsigned int steps = (unsigned int) ceil(time / largestStep);
+
+                        rescaleScene(time / steps);
+
+                        calculate(steps);
+
+                        rescaleScene(fieldStep);
+
+                        return steps;
+                    }
+
+                    unsigned int steps = 0;
+
+                    double elapsed = 0;
+
+                    // The step the tolerance allows, kept apart from the last one, which only finishes the time:
+                    double trialStep = std::min(timeStep_, largestStep);
+
+                    while (time - elapsed > time * std::numeric_limits<double>::epsilon() * 16)
+                    {
+                        const double remaining = time - elapsed;
+
+                        rescaleScene(std::min(trialStep, remaining));
+
+                        calculate();
+
+                        const double error = stepError();
+
+                        // The step that would just meet the tolerance, a little less:
+                        const double proposed = (error > 0)? std::min(timeStep_ * ADAPTIVE_SAFETY * sqrt(tolerance / error), largestStep) : largestStep;
+
+                        if (error > tolerance)
+                        {
+                            // Undoing the step (frozen tiles equal in both buffers stay as they were):
+
+                            Real* currentTemperatures = temperatures_;
+
+                            temperatures_     = nextTemperatures_;
+                            nextTemperatures_ = currentTemperatures;
+
+                            if (tileStates_ != nullptr) wakeTiles(0, 0, width_, height_);
+
+                            trialStep = proposed;
+
+                            continue;
+                        }
+
+                        elapsed += timeStep_;
+                        steps++;
+
+                        // Once stability rather than accuracy bounds the step, the error only decays as heat spreads,
+                        // and the rest goes in blocked steps:
+                        if (timeStep_ == largestStep && proposed == largestStep)
+                        {
+                            steps += advance(time - elapsed);
+                            break;
+                        }
+
+                        if (proposed >= ADAPTIVE_GROWTH * timeStep_) trialStep = proposed;
+                    }
+
+                    rescaleScene(fieldStep);
+
+                // Checking output:
+
+                    assert(ok());
+
+                    return steps;
+            }
+
+            template <typename Real>
+            double Field<Real>::stepError() const
+            {
+                const Real* next    = temperatures_;
+                const Real* current = nextTemperatures_;
+
+                double error = 0;
+
+                for (size_t x = 0; x < width_; x++)
+                {
+                    const size_t column = index(x, 0);
+
+                    for (size_t cell = column; cell < column + height_; cell++)
+                    {
+                        if (weights_[cell] <= 0) continue;
+
+                        const double change = (next[cell - pitch_] - current[cell - pitch_]) + (next[cell + pitch_] - current[cell + pitch_]) +
+                                              (next[cell - 1]      - current[cell - 1])      + (next[cell + 1]      - current[cell + 1]) -
+                                          4 * (next[cell]          - current[cell]);
+
+                        error = std::max(error, fabs(weights_[cell] * change) / 2);
+                    }
+                }
+
+                return error;
+            }
+
+            template <typename Real>
+            unsigned int Field<Real>::calculateSuperStep(const double timeStep)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(timeStep > 0);
+
+                // Creating resources:
+
+                    if (superStepper_ == nullptr) superStepper_ = new SuperTimeStepping<Real>(layout());
+
+                    // Equal super steps of at most SUPER_STEP_MAX_STAGES stages each:
+
+                    const double ratio = timeStep / (STABLE_STEP_FRACTION * stableTimeStep_);
+
+                    unsigned int steps  = 1;
+                    unsigned int stages = SuperTimeStepping<Real>::stages(ratio);
+
+                    if (stages > SUPER_STEP_MAX_STAGES)
+                    {
+                        const double longest = (SUPER_STEP_MAX_STAGES * SUPER_STEP_MAX_STAGES + SUPER_STEP_MAX_STAGES - 2) / 4.0;
+
+                        steps  = (unsigned int) ceil(ratio / longest);
+                        stages = SuperTimeStepping<Real>::stages(ratio / steps);
+                    }
+
+                // Main algorithm:
+
+                    for (unsigned int step = 0; step < steps; step++)
+                    {
+                        superStepper_->step(temperatures_, nextTemperatures_, weights_, timeStep / steps / timeStep_, stages, pool_);
+
+                        Real* currentTemperatures = temperatures_;
+
+                        temperatures_     = nextTemperatures_;
+                        nextTemperatures_ = currentTemperatures;
+                    }
+
+                    if (tileStates_ != nullptr) wakeTiles(0, 0, width_, height_);
+
+                // Checking output:
+
+                    assert(ok());
+
+                    return steps * stages;
+            }
+
+            template <typename Real>
+            bool Field<Real>::spectralScene() const
+            {
+                const double conductivity = conductivities_[index(1, 1)];
+
+                if (conductivity <= 0) return false;
+
+                for (size_t x = 1; x < width_ - 1; x++)
+                {
+                    for (size_t y = 1; y < height_ - 1; y++)
+                    {
+                        if (obstacles_[index(x, y)] != EMPTY_TILE || conductivities_[index(x, y)] != conductivity) return false;
+                    }
+                }
+
+                return true;
+            }
+
+            // The outer frame is always fixed, so the cells inside it are all the unknowns:
+            template <typename Real>
+            bool Field<Real>::calculateSpectral(const double time)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(time >= 0);
+
+                    if (!spectralScene()) return false;
+
+                // Creating resources:
+
+                    if (spectral_ == nullptr) spectral_ = new Spectral<Real>(layout());
+
+                // Main algorithm:
+
+                    spectral_->advance(temperatures_, conductivities_[index(1, 1)] / (SPACE_STEP * SPACE_STEP), time, pool_);
+
+                    memcpy(nextTemperatures_, temperatures_, cells_ * sizeof(*temperatures_));
+
+                    if (tileStates_ != nullptr) wakeTiles(0, 0, width_, height_);
+
+                // Checking output:
+
+                    assert(ok());
+
+                    return true;
+            }
+
+            template <typename Real>
+            void Field<Real>::setImplicitMultigrid(const unsigned int cycle)
+            {
+                assert(cycle == NO_MULTIGRID || cycle == MULTIGRID_V_CYCLE || cycle == MULTIGRID_W_CYCLE);
+
+                implicitCycle_ = cycle;
+            }
+
+            // calculate() stops changing once every cell with a weight equals the mean of its neighbours
+            // (conductivity only sets the pace), so the equilibrium solves
+            //     4 T - sum of unknown neighbours T = sum of fixed neighbours T
+            // with the same solver as calculateImplicit().
+            template <typename Real>
+            unsigned int Field<Real>::solveSteadyState(const unsigned int cycle /*= MULTIGRID_V_CYCLE*/)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(cycle == MULTIGRID_V_CYCLE || cycle == MULTIGRID_W_CYCLE);
+
+                // Creating resources:
+
+                    if (solver_    == nullptr) solver_    = new ConjugateGradient<Real>(layout());
+                    if (multigrid_ == nullptr) multigrid_ = new Multigrid<Real>(layout());
+
+                    Real* diagonal = solver_->diagonal();
+                    Real* rhs      = solver_->rhs();
+
+                    const Real* current = temperatures_;
+
+                // Main algorithm:
+
+                    for (size_t x = 0; x < width_; x++)
+                    {
+                        const size_t column = index(x, 0);
+
+                        for (size_t cell = column; cell < column + height_; cell++)
+                        {
+                            if (weights_[cell] <= 0)
+                            {
+                                diagonal[cell] = 0;
+                                rhs     [cell] = 0;
+
+                                continue;
+                            }
+
+                            diagonal[cell] = 4;
+                            rhs     [cell] = ((weights_[cell - pitch_] > 0)? 0 : current[cell - pitch_]) + ((weights_[cell + pitch_] > 0)? 0 : current[cell + pitch_]) +
+                                             ((weights_[cell - 1]      > 0)? 0 : current[cell - 1])      + ((weights_[cell + 1]      > 0)? 0 : current[cell + 1]);
+                        }
+                    }
+
+                    multigrid_->setCycle(cycle);
+
+                    unsigned int iterations = solver_->solve(temperatures_, IMPLICIT_TOLERANCE, IMPLICIT_MAX_ITERATIONS, multigrid_);
+
+                    // An equilibrium is the same in both buffers:
+                    memcpy(nextTemperatures_, temperatures_, cells_ * sizeof(*temperatures_));
+
+                    if (tileStates_ != nullptr) wakeTiles(0, 0, width_, height_);
+
+                // Checking output:
+
+                    assert(ok());
+
+                    return iterations;
+            }
+
+            // Red cells ((x + y) % 2 == 0) only have black neighbours and vice versa, so each colour
+            // is updated in place in any order. The optimal factor is omega = 2 / (1 + sqrt(1 - mu^2)),
+            // mu being the Jacobi convergence rate, which walls and conductivities make unknown. So the
+            // relaxation starts as Gauss-Seidel and every SOR_ESTIMATION_SWEEPS sweeps turns the measured
+            // rate lambda into mu^2 = (lambda + omega - 1)^2 / (lambda omega^2), raising omega towards the optimum.
+            // A window right after a change is a transient and is skipped. Fixed cells only lower mu, so
+            // the optimum of the bounding rectangle caps omega: past the optimum lambda stops telling anything.
+            template <typename Real>
+            unsigned int Field<Real>::relaxSteadyState(const double tolerance /*= IMPLICIT_TOLERANCE*/)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(tolerance > 0);
+
+                // Creating resources:
+
+                    // One cache line per worker:
+                    const size_t stride = SCHEDULER_LINE / sizeof(double);
+
+                    double* residuals = (double*) calloc(threads() * stride, sizeof(*residuals));
+                    assert(residuals);
+
+                    RelaxationSweep sweep = {this, 1, residuals, stride};
+
+                    // Sum of squares of the fixed temperatures seen by unknowns, the scale of the residual:
+                    double rhsNorm = 0;
+
+                    // No temperature exceeds the hottest fixed one, so rounding the five terms of a residual
+                    // (and the update, amplified by omega close to 2) leaves every unknown a residual
+                    // of some epsilon * hottest, which stops float grids above small tolerances:
+                    double hottest  = 0;
+                    double unknowns = 0;
+
+                    for (size_t x = 0; x < width_; x++)
+                    {
+                        for (size_t cell = index(x, 0); cell < index(x, height_); cell++)
+                        {
+                            if (weights_[cell] <= 0)
+                            {
+                                hottest = std::max(hottest, fabs((double) temperatures_[cell]));
+                                continue;
+                            }
+
+                            unknowns++;
+
+                            double rhs = ((weights_[cell - pitch_] > 0)? 0 : temperatures_[cell - pitch_]) + ((weights_[cell + pitch_] > 0)? 0 : temperatures_[cell + pitch_]) +
+                                         ((weights_[cell - 1]      > 0)? 0 : temperatures_[cell - 1])      + ((weights_[cell + 1]      > 0)? 0 : temperatures_[cell + 1]);
+
+                            rhsNorm += rhs * rhs;
+                        }
+                    }
+
+                    const double roundoff = 32 * std::numeric_limits<Real>::epsilon() * hottest;
+
+                    const double target = std::max(tolerance * tolerance * rhsNorm, roundoff * roundoff * unknowns);
+
+                // Main algorithm:
+
+                    // Jacobi rate of the width x height rectangle:
+                    const double pi       = 3.14159265358979323846;
+                    const double mu       = (cos(pi / (width_ + 1)) + cos(pi / (height_ + 1))) / 2;
+                    const double maxOmega = 2 / (1 + sqrt(1 - mu * mu));
+
+                    double windowResidual = 0;
+                    bool   omegaChanged   = false;
+
+                    unsigned int sweeps = 0;
+
+                    for (; sweeps < SOR_MAX_SWEEPS; sweeps++)
+                    {
+                        if (pool_ != nullptr) pool_->run(relaxTask, &sweep);
+                        else                  relaxTask(&sweep, 0, 1);
+
+                        double residual = 0;
+
+                        for (unsigned int worker = 0; worker < threads(); worker++)
+                        {
+                            residual += residuals[worker * stride];
+                        }
+
+                        if (residual <= target) break;
+
+                        if (sweeps % SOR_ESTIMATION_SWEEPS != 0) continue;
+
+                        // The sums are squares, lambda is the rate of the norm:
+                        const Real omega = sweep.omega;
+
+                        if (windowResidual > 0 && residual < windowResidual && !omegaChanged)
+                        {
+                            const double lambda = pow(residual / windowResidual, 0.5 / SOR_ESTIMATION_SWEEPS);
+
+                            const double jacobi = (lambda + omega - 1) * (lambda + omega - 1) / (lambda * omega * omega);
+
+                            const double estimate = (jacobi < 1)? std::min(2 / (1 + sqrt(1 - jacobi)), maxOmega) : maxOmega;
+
+                            if (estimate > omega) sweep.omega = estimate;
+                        }
+
+                        omegaChanged   = sweep.omega != omega;
+                        windowResidual = residual;
+                    }
+
+                    free(residuals);
+
+                    if (tileStates_ != nullptr) wakeTiles(0, 0, width_, height_);
+
+                // Checking output:
+
+                    assert(ok());
+
+                    return sweeps;
+            }
+
+            template <typename Real>
+            unsigned int Field<Real>::preview(const unsigned int factor, const double time)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(factor >= 2);
+                    assert(time >= 0);
+
+                // Main algorithm:
+
+                    Preview<Real> coarse(layout(), factor);
+
+                    coarse.restrictField(temperatures_, weights_);
+
+                    unsigned int steps = coarse.run(time / timeStep_);
+
+                    coarse.prolongField(temperatures_, weights_);
+
+                    memcpy(nextTemperatures_, temperatures_, cells_ * sizeof(*temperatures_));
+
+                    if (tileStates_ != nullptr) wakeTiles(0, 0, width_, height_);
+
+                // Checking output:
+
+                    assert(ok());
+
+                    return steps;
+            }
+
+            // Updates one colour of columns [start, finish) and returns the sum of squared residuals met:
+            template <typename Real>
+            double Field<Real>::relaxColumns(const size_t start, const size_t finish, const unsigned int color, const Real omega)
+            {
+                Real* temperatures = temperatures_;
+
+                double residuals = 0;
+
+                for (size_t x = start; x < finish; x++)
+                {
+                    const size_t column = index(x, 0);
+
+                    for (size_t cell = column + (x + color) % 2; cell < column + height_; cell += 2)
+                    {
+                        if (weights_[cell] <= 0) continue;
+
+                        Real residual = temperatures[cell - pitch_] + temperatures[cell + pitch_] + temperatures[cell - 1] + temperatures[cell + 1] - 4 * temperatures[cell];
+
+                        temperatures[cell] += omega / 4 * residual;
+
+                        residuals += (double) residual * residual;
+                    }
+                }
+
+                return residuals;
+            }
+
+            // Every worker relaxes a band of columns, the barrier keeps the colours apart:
+            template <typename Real>
+            void Field<Real>::relaxTask(void* sweep, const unsigned int worker, const unsigned int workers)
+            {
+                RelaxationSweep* relaxation = (RelaxationSweep*) sweep;
+                Field*           self       = relaxation->field;
+
+                const size_t start  = self->width_ *  worker      / workers;
+                const size_t finish = self->width_ * (worker + 1) / workers;
+
+                double residuals = self->relaxColumns(start, finish, 0, relaxation->omega);
+
+                if (self->pool_ != nullptr) self->pool_->barrier();
+
+                residuals += self->relaxColumns(start, finish, 1, relaxation->omega);
+
+                relaxation->residuals[worker * relaxation->stride] = residuals;
+            }
+
+            template <typename Real>
+            void Field<Real>::setThreads(const unsigned int threads)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(threads > 0);
+
+                // Main algorithm:
+
+                    delete pool_;
+                    pool_ = (threads > 1)? new ThreadPool(threads) : nullptr;
+
+                    if (scheduler_ != nullptr)
+                    {
+                        delete scheduler_;
+                        scheduler_ = new TileScheduler(threads);
+                    }
+
+                    // Enough counters for the shortest strips calculate(steps) may pick:
+                    if (pool_ != nullptr && stripProgress_ == nullptr)
+                    {
+                        stripCapacity_ = (height_ + TEMPORAL_BLOCK_DEPTH + TEMPORAL_BLOCK_MIN_HEIGHT - 1) / TEMPORAL_BLOCK_MIN_HEIGHT + 1;
+
+                        stripProgress_ = (volatile LONG*) calloc(stripCapacity_, sizeof(*stripProgress_));
+                        assert(stripProgress_);
+                    }
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+            template <typename Real>
+            unsigned int Field<Real>::threads() const
+            {
+                return (pool_ != nullptr)? pool_->size() : 1;
+            }
+
+            template <typename Real>
+            void Field<Real>::sweepColumns(const size_t start, const size_t finish)
+            {
+                for (size_t x = start; x < finish; x++)
+                {
+                    assert(0 <= x && x < width_);
+
+                    stencil_(nextTemperatures_ + index(x, 0), temperatures_ + index(x, 0), weights_ + index(x, 0), corrections_ + index(x, 0), pitch_, height_);
+                }
+            }
+
+            // Every worker sweeps one band of columns, run() returning is the barrier between steps:
+            template <typename Real>
+            void Field<Real>::sweepColumnsTask(void* field, const unsigned int worker, const unsigned int workers)
+            {
+                Field* self = (Field*) field;
+
+                self->sweepColumns(self->width_ *  worker      / workers,
+                                   self->width_ * (worker + 1) / workers);
+            }
+
+            // Advances depth steps in one pass over memory, bit-identical to depth calls of calculate().
+            //
+            // Step s reads the buffer of parity s and writes the other one. The y axis is cut into strips
+            // that lean back by one cell per step, and inside a strip the steps form a wavefront along x:
+            // at wave p step s updates column p - s. Each update then finds its inputs already computed
+            // and not yet overwritten, so two buffers suffice while a strip stays in cache for all steps.
+            //
+            // With a pool strips are dealt round-robin and pipelined: a strip may run wave p once the
+            // strip before it has finished wave p, which is when both its inputs are ready and the
+            // values the previous strip still reads can no longer be overwritten.
+            template <typename Real>
+            void Field<Real>::sweepBlocked(const unsigned int depth, const size_t stripHeight)
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                    assert(depth > 0);
+                    assert(stripHeight > 0);
+
+                // Creating resources:
+
+                    BlockedSweep sweep = {this, {temperatures_, nextTemperatures_}, depth, stripHeight, 0};
+
+                    // The last strip has to reach height_ even after leaning back depth - 1 cells:
+                    sweep.strips = (height_ + depth - 1 + stripHeight - 1) / stripHeight;
+
+                // Main algorithm:
+
+                    if (pool_ != nullptr && sweep.strips > 1)
+                    {
+                        assert(sweep.strips <= stripCapacity_);
+
+                        for (size_t strip = 0; strip < sweep.strips; strip++)
+                        {
+                            stripProgress_[strip] = 0;
+                        }
+
+                        pool_->run(sweepBlockedTask, &sweep);
+                    }
+                    else
+                    {
+                        for (size_t strip = 0; strip < sweep.strips; strip++)
+                        {
+                            sweepStrip(sweep.buffers, depth, stripHeight, strip, nullptr, nullptr);
+                        }
+                    }
+
+                    temperatures_     = sweep.buffers[depth % 2];
+                    nextTemperatures_ = sweep.buffers[(depth + 1) % 2];
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+            template <typename Real>
+            void Field<Real>::sweepBlockedTask(void* sweep, const unsigned int worker, const unsigned int workers)
+            {
+                BlockedSweep* blocked = (BlockedSweep*) sweep;
+                Field*        self    = blocked->field;
+
+                for (size_t strip = worker; strip < blocked->strips; strip += workers)
+                {
+                    self->sweepStrip(blocked->buffers, blocked->depth, blocked->stripHeight, strip,
+                                     (strip > 0)? &self->stripProgress_[strip - 1] : nullptr, &self->stripProgress_[strip]);
+                }
+            }
+
+            template <typename Real>
+            void Field<Real>::sweepStrip(Real* buffers[2], const unsigned int depth, const size_t stripHeight, const size_t strip,
+                                         volatile LONG* previousProgress, volatile LONG* progress)
+            {
+                for (size_t wave = 0; wave < width_ + depth - 1; wave++)
+                {
+                    if (previousProgress != nullptr)
+                    {
+                        unsigned int spins = 0;
+
+                        while ((size_t) atomicRead(previousProgress) < wave + 1)
+                        {
+                            spinWait(&spins);
+                        }
+                    }
+
+                    for (unsigned int step = 0; step < depth && step <= wave; step++)
+                    {
+                        size_t x = wave - step;
+
+                        if (x >= width_) continue;
+
+                        size_t start  = (strip * stripHeight < step)? 0 : strip * stripHeight - step;
+                        size_t finish = ((strip + 1) * stripHeight - step > height_)? height_ : (strip + 1) * stripHeight - step;
+
+                        if (start >= finish) continue;
+
+                        const Real* current = buffers[step % 2];
+                              Real* next    = buffers[(step + 1) % 2];
+
+                        stencil_(next + index(x, start), current + index(x, start), weights_ + index(x, start), corrections_ + index(x, start), pitch_, finish - start);
+                    }
+
+                    if (progress != nullptr) InterlockedExchange(progress, wave + 1);
+                }
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+
+        //----------------------------------------------------------------------------
+        //{ Sparse sweeps
+        //----------------------------------------------------------------------------
+
+            // Most of a scene is usually walls, zero conductivity or cells that reached equilibrium.
+            // The field is cut into TILE_SIZE x TILE_SIZE tiles: fixed tiles (no cell with a weight)
+            // are never swept, and an active tile whose cells all changed by less than epsilon in a
+            // step is frozen, with both buffers made equal so the frozen values are seen by whichever
+            // buffer is current. A frozen tile is woken again when an edge of a neighbouring tile
+            // changes by epsilon or more, or when the scene or temperatures are edited over it.
+
+            template <typename Real>
+            void Field<Real>::setSparse(const double epsilon)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(0 <= epsilon);
+
+                // Creating resources:
+
+                    if (tileStates_ == nullptr)
+                    {
+                        tileStates_  = (unsigned char*) calloc(tilesX_ * tilesY_, sizeof(*tileStates_));
+                        tileWakes_   = (unsigned char*) calloc(tilesX_ * tilesY_, sizeof(*tileWakes_));
+                        tileChanges_ = (Real*)          calloc(tilesX_ * tilesY_, sizeof(*tileChanges_));
+                        activeList_  = (size_t*)        calloc(tilesX_ * tilesY_, sizeof(*activeList_));
+
+                        assert(tileStates_ && tileWakes_ && tileChanges_ && activeList_);
+
+                        scheduler_ = new TileScheduler(threads());
+                    }
+
+                // Main algorithm:
+
+                    sparseEpsilon_ = epsilon;
+
+                    // Every tile that can change starts active:
+                    activeCount_ = 0;
+
+                    for (size_t tile = 0; tile < tilesX_ * tilesY_; tile++)
+                    {
+                        tileStates_[tile] = TILE_FIXED;
+
+                        classifyTile(tile);
+
+                        if (tileStates_[tile] == TILE_ACTIVE) activeCount_++;
+                    }
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+            template <typename Real>
+            size_t Field<Real>::activeTiles() const
+            {
+                return activeCount_;
+            }
+
+            template <typename Real>
+            void Field<Real>::classifyTile(const size_t tile)
+            {
+                assert(tile < tilesX_ * tilesY_);
+
+                size_t startX = (tile / tilesY_) * TILE_SIZE;
+                size_t startY = (tile % tilesY_) * TILE_SIZE;
+
+                size_t finishX = (startX + TILE_SIZE <  width_)? startX + TILE_SIZE :  width_;
+                size_t finishY = (startY + TILE_SIZE < height_)? startY + TILE_SIZE : height_;
+
+                bool fixed = true;
+
+                for (size_t x = startX; fixed && x < finishX; x++)
+                {
+                    for (size_t y = startY; y < finishY; y++)
+                    {
+                        if (weights_[index(x, y)] > 0)
+                        {
+                            fixed = false;
+                            break;
+                        }
+                    }
+                }
+
+                if (fixed)                               tileStates_[tile] = TILE_FIXED;
+                else if (tileStates_[tile] == TILE_FIXED) tileStates_[tile] = TILE_ACTIVE;
+            }
+
+            // Cells [startX, finishX) x [startY, finishY) were changed outside calculate(),
+            // their tiles and the tiles of their neighbours have to look again:
+            template <typename Real>
+            void Field<Real>::wakeTiles(const size_t startX, const size_t startY, const size_t finishX, const size_t finishY)
+            {
+                size_t firstX = ((startX > 0)? startX - 1 : 0) / TILE_SIZE;
+                size_t firstY = ((startY > 0)? startY - 1 : 0) / TILE_SIZE;
+
+                size_t lastX = ((finishX <  width_)? finishX :  width_ - 1) / TILE_SIZE;
+                size_t lastY = ((finishY < height_)? finishY : height_ - 1) / TILE_SIZE;
+
+                for (size_t tileX = firstX; tileX <= lastX; tileX++)
+                {
+                    for (size_t tileY = firstY; tileY <= lastY; tileY++)
+                    {
+                        size_t tile = tileX * tilesY_ + tileY;
+
+                        if (tileStates_[tile] == TILE_QUIESCENT) tileStates_[tile] = TILE_ACTIVE;
+                    }
+                }
+            }
+
+            template <typename Real>
+            void Field<Real>::sweepSparse()
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(tileStates_);
+
+                // Creating resources:
+
+                    activeCount_ = 0;
+
+                    for (size_t tile = 0; tile < tilesX_ * tilesY_; tile++)
+                    {
+                        if (tileStates_[tile] == TILE_ACTIVE) activeList_[activeCount_++] = tile;
+                    }
+
+                // Main algorithm:
+
+                    if (pool_ != nullptr)
+                    {
+                        scheduler_->reset(activeCount_);
+
+                        pool_->run(sweepTilesTask, this);
+                    }
+                    else
+                    {
+                        for (size_t active = 0; active < activeCount_; active++)
+                        {
+                            sweepTile(activeList_[active]);
+                        }
+                    }
+
+                    // Freezing settled tiles first, so a wake below is never undone by a later freeze:
+
+                    for (size_t active = 0; active < activeCount_; active++)
+                    {
+                        size_t tile = activeList_[active];
+
+                        if (tileChanges_[tile] >= sparseEpsilon_) continue;
+
+                        tileStates_[tile] = TILE_QUIESCENT;
+
+                        size_t startX = (tile / tilesY_) * TILE_SIZE;
+                        size_t startY = (tile % tilesY_) * TILE_SIZE;
+
+                        size_t finishX = (startX + TILE_SIZE <  width_)? startX + TILE_SIZE :  width_;
+                        size_t finishY = (startY + TILE_SIZE < height_)? startY + TILE_SIZE : height_;
+
+                        for (size_t x = startX; x < finishX; x++)
+                        {
+                            memcpy(temperatures_ + index(x, startY), nextTemperatures_ + index(x, startY), (finishY - startY) * sizeof(*temperatures_));
+                        }
+                    }
+
+                    for (size_t active = 0; active < activeCount_; active++)
+                    {
+                        size_t tile  = activeList_[active];
+                        size_t tileX = tile / tilesY_;
+                        size_t tileY = tile % tilesY_;
+
+                        size_t neighbours[4] = {};
+                        size_t count = 0;
+
+                        if ((tileWakes_[tile] & SIDE_LEFT)   && tileX > 0)           neighbours[count++] = tile - tilesY_;
+                        if ((tileWakes_[tile] & SIDE_RIGHT)  && tileX < tilesX_ - 1) neighbours[count++] = tile + tilesY_;
+                        if ((tileWakes_[tile] & SIDE_TOP)    && tileY > 0)           neighbours[count++] = tile - 1;
+                        if ((tileWakes_[tile] & SIDE_BOTTOM) && tileY < tilesY_ - 1) neighbours[count++] = tile + 1;
+
+                        for (size_t neighbour = 0; neighbour < count; neighbour++)
+                        {
+                            if (tileStates_[neighbours[neighbour]] == TILE_QUIESCENT) tileStates_[neighbours[neighbour]] = TILE_ACTIVE;
+                        }
+                    }
+
+                    Real* currentTemperatures = temperatures_;
+
+                    temperatures_     = nextTemperatures_;
+                    nextTemperatures_ = currentTemperatures;
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+            // Sweeps one tile and records how much it and each of its edges changed:
+            template <typename Real>
+            void Field<Real>::sweepTile(const size_t tile)
+            {
+                size_t startX = (tile / tilesY_) * TILE_SIZE;
+                size_t startY = (tile % tilesY_) * TILE_SIZE;
+
+                size_t finishX = (startX + TILE_SIZE <  width_)? startX + TILE_SIZE :  width_;
+                size_t finishY = (startY + TILE_SIZE < height_)? startY + TILE_SIZE : height_;
+
+                const Real epsilon = sparseEpsilon_;
+
+                // A change this close to a side reaches the tile across it in one step:
+                const size_t reach = stencilReach();
+
+                Real change = 0;
+                unsigned char wakes = 0;
+
+                for (size_t x = startX; x < finishX; x++)
+                {
+                    stencil_(nextTemperatures_ + index(x, startY), temperatures_ + index(x, startY), weights_ + index(x, startY), corrections_ + index(x, startY), pitch_, finishY - startY);
+
+                    for (size_t y = startY; y < finishY; y++)
+                    {
+                        Real delta = fabs(nextTemperatures_[index(x, y)] - temperatures_[index(x, y)]);
+
+                        if (delta > change) change = delta;
+
+                        if (delta < epsilon) continue;
+
+                        if (x <  startX  + reach) wakes |= SIDE_LEFT;
+                        if (x >= finishX - reach) wakes |= SIDE_RIGHT;
+                        if (y <  startY  + reach) wakes |= SIDE_TOP;
+                        if (y >= finishY - reach) wakes |= SIDE_BOTTOM;
+                    }
+                }
+
+                tileChanges_[tile] = change;
+                tileWakes_  [tile] = wakes;
+            }
+
+            // Workers claim active tiles from the scheduler until none are left:
+            template <typename Real>
+            void Field<Real>::sweepTilesTask(void* field, const unsigned int worker, const unsigned int /*workers*/)
+            {
+                Field* self = (Field*) field;
+
+                size_t active = 0;
+
+                while (self->scheduler_->next(worker, &active))
+                {
+                    self->sweepTile(self->activeList_[active]);
+                }
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+
+        //----------------------------------------------------------------------------
+        //{ Local time stepping
+        //----------------------------------------------------------------------------
+
+            // Tile levels and interfaces live in LocalTimeStepping (see LocalTimeStepping.h):
+            template <typename Real>
+            size_t Field<Real>::calculateLocal(const double timeStep)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(timeStep > 0);
+
+                // Creating resources:
+
+                    if (localStepper_ == nullptr) localStepper_ = new LocalTimeStepping<Real>(layout());
+
+                    // A tile's stiffest cell allows steps of timeStep_ * STABLE_STEP_FRACTION / (4 * weight):
+                    if (localTimeStep_ != timeStep)
+                    {
+                        localStepper_->setup(weights_, timeStep / timeStep_, STABLE_STEP_FRACTION / 4);
+
+                        localTimeStep_ = timeStep;
+                    }
+
+                // Main algorithm:
+
+                    const size_t sweeps = localStepper_->step(temperatures_, nextTemperatures_, weights_, pool_);
+
+                    if (tileStates_ != nullptr) wakeTiles(0, 0, width_, height_);
+
+                // Checking output:
+
+                    assert(ok());
+
+                    return sweeps;
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+
+        //----------------------------------------------------------------------------
+        //{ Checkpoints
+        //----------------------------------------------------------------------------
+
+            template <typename Real>
+            void Field<Real>::saveCheckpoint(const char* fileName, const unsigned long long steps, const double time)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(fileName != nullptr);
+
+                // Creating resources:
+
+                    CheckpointHeader header = {};
+
+                    memcpy(header.signature, CHECKPOINT_SIGNATURE, sizeof(header.signature));
+
+                    header.version  = CHECKPOINT_VERSION;
+                    header.cellSize = sizeof(Real);
+
+                    header.width  = width_;
+                    header.height = height_;
+                    header.pitch  = pitch_;
+                    header.origin = origin_;
+                    header.cells  = cells_;
+
+                    header.steps = steps;
+                    header.time  = time;
+
+                    header.timeStep          = timeStep_;
+                    header.stableTimeStep    = stableTimeStep_;
+                    header.borderTemperature = borderTemperature_;
+                    header.stencilShape      = stencilShape_;
+
+                    const void* sections[CHECKPOINT_SECTIONS] = {obstacles_, conductivities_, weights_, corrections_, temperatures_};
+
+                    char temporaryName[MAX_PATH] = "";
+                    snprintf(temporaryName, sizeof(temporaryName), "%s.tmp", fileName);
+
+                // Main algorithm:
+
+                    if (!Checkpoint<Real>::write(temporaryName, &header, sections)) return;
+
+                    // Windows keeps a file that is open or mapped from being replaced:
+                    const bool resumed = (checkpoint_ != nullptr);
+
+                    delete checkpoint_;
+                    checkpoint_ = nullptr;
+
+                    // A crash before this line leaves the previous checkpoint as it was:
+                    BOOL replaced = MoveFileEx(temporaryName, fileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+
+                    if (!replaced) printf("Field::saveCheckpoint(): Could not replace %s with %s (error %lu).\n", fileName, temporaryName, GetLastError());
+
+                    // Either file holds the arrays now, as they were:
+                    if (resumed)
+                    {
+                        Checkpoint<Real>* checkpoint = new Checkpoint<Real>((replaced)? fileName : temporaryName);
+
+                        if (!checkpoint->valid()) printf("Field::saveCheckpoint(): Could not map the checkpoint just written back.\n");
+                        assert(checkpoint->valid());
+
+                        attachCheckpoint(checkpoint);
+                    }
+            }
+
+            template <typename Real>
+            void Field<Real>::attachCheckpoint(Checkpoint<Real>* checkpoint)
+            {
+                assert(checkpoint != nullptr && checkpoint->valid());
+                assert(checkpoint->header().cells == cells_);
+
+                checkpoint_ = checkpoint;
+
+                obstacles_        = (char*) checkpoint_->section(CHECKPOINT_OBSTACLES);
+                conductivities_   = (Real*) checkpoint_->section(CHECKPOINT_CONDUCTIVITIES);
+                weights_          = (Real*) checkpoint_->section(CHECKPOINT_WEIGHTS);
+                corrections_      = (Real*) checkpoint_->section(CHECKPOINT_CORRECTIONS);
+                temperatures_     = (Real*) checkpoint_->section(CHECKPOINT_TEMPERATURES);
+                nextTemperatures_ = checkpoint_->temperatureCopy();
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+
+        //----------------------------------------------------------------------------
+        //{ Snapshots
+        //----------------------------------------------------------------------------
+
+            template <typename Real>
+            size_t Field<Real>::saveSnapshot(const char* fileName, const double errorBound)
+            {
+                assert(ok());
+
+                if (snapshot_ == nullptr) snapshot_ = new Snapshot<Real>(layout());
+
+                return snapshot_->save(fileName, temperatures_, errorBound, pool_);
+            }
+
+            template <typename Real>
+            void Field<Real>::loadSnapshot(const char* fileName)
+            {
+                assert(ok());
+
+                if (snapshot_ == nullptr) snapshot_ = new Snapshot<Real>(layout());
+
+                snapshot_->load(fileName, temperatures_, pool_);
+
+                memcpy(nextTemperatures_, temperatures_, cells_ * sizeof(Real));
+            }
+
         //}
         //----------------------------------------------------------------------------
 
@@ -743,7 +2733,8 @@
         //{ Rendering
         //----------------------------------------------------------------------------
 
-            void Field::render(const unsigned int zoom /*= 1*/, bool grid /*= false*/) const
+            template <typename Real>
+            void Field<Real>::render(const unsigned int zoom /*= 1*/, bool grid /*= false*/) const
             {
                 // Checking input:
 
@@ -758,9 +2749,9 @@
                     {
                         for (size_t y = 0; y < height_; y++)
                         {
-                            //COLORREF currentColor = (obstacles_[x][y] == WALL_TILE)? WALL_COLOR : colorLerp(temperatures_[x][y], COLD_COLOR, MID_COLOR, WARM_COLOR);
+                            //COLORREF currentColor = (obstacles_[index(x, y)] == WALL_TILE)? WALL_COLOR : colorLerp(temperatures_[index(x, y)], COLD_COLOR, MID_COLOR, WARM_COLOR);
 
-                            COLORREF currentColor = colorLerp(log(log(temperatures_[x][y] + 1) + 1), GetPixel(image_, x, y), MID_COLOR, WARM_COLOR);
+                            COLORREF currentColor = colorLerp(log(log(temperatures_[index(x, y)] + 1) + 1), GetPixel(image_, x, y), MID_COLOR, WARM_COLOR);
 
                             if (zoom >= 3)
                             {
@@ -0,0 +1,567 @@
+#pragma once
+
+#include "Classes.h"
+#include "HaloExchange.h"
+
+
+//----------------------------------------------------------------------------
+//{ Subdomain
+//----------------------------------------------------------------------------
+
+    // One process's share of a Field split across processes: rank r of ranks owns the columns
+    // [width * r / ranks, width * (r + 1) / ranks) of the map, and the GRID_HALO ghost columns
+    // of the padded layout on each side hold copies of its neighbours' columns. Every rank steps
+    // only its own columns and ghosts, and steps are bit-identical to Field::calculate() with
+    // the 5-point stencil. The grid arrays of a rank are its columns only, but every rank still
+    // reads both maps whole while it is constructed and rank 0 keeps a whole frame for render(),
+    // so the split shares the work, not the memory of the maps.
+    //
+    // Columns are contiguous, so a halo is depth whole columns sent as they lie in memory. calculate(steps)
+    // exchanges GRID_HALO columns once per GRID_HALO steps and also updates the ghost columns that the
+    // following steps still read (the overlap shrinks by one column per step), which halves the messages
+    // at the price of two extra columns of work per step; calculate() alone exchanges one column a step.
+    //
+    // Transport is anything with the interface of SharedMemoryTransport (see HaloExchange.h).
+
+    template <typename Real, typename Transport>
+    class Subdomain
+    {
+        public:
+
+            // Constructor && destructor:
+
+                // Every rank reads both maps whole, its columns of them and the whole conductivity map
+                // for the stable step, so all of them step alike without a reduction; only rank 0
+                // loads the image, it renders:
+                Subdomain(Transport* transport,
+                          const char* conductivitiesFileName,
+                          const char*      obstaclesFileName,
+                          const char*          imageFileName,
+                          const size_t width,
+                          const size_t height,
+                          const double wallConditions,
+                          const double emptySpaceConditions);
+
+                ~Subdomain();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Setting conditions (in map coordinates, every rank applies its own columns):
+
+                    void adjustTemperature(const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const double deltaTemperature);
+
+                // Calculations (every rank calls them together):
+
+                    void calculate();
+                    void calculate(const unsigned int steps);
+
+                    double stableTimeStep() const;
+                    double timeStep() const;
+
+                    // The owned columns [firstColumn(), firstColumn() + columns()) of the map:
+                    size_t firstColumn() const;
+                    size_t columns() const;
+
+                    // Of an owned cell, in map coordinates:
+                    Real temperature(const size_t x, const size_t y) const;
+
+                // Collectives (every rank calls them together):
+
+                    // Rank 0 collects every column for render(), the others pass theirs and their right
+                    // neighbours' on towards it:
+                    void gather();
+
+                    // Rank 0's value on every rank (whether to go on, for example):
+                    bool broadcast(const bool value);
+
+                // Rendering (rank 0, what the last gather() collected):
+
+                    void render(const unsigned int zoom = 1) const;
+
+        private:
+
+            Transport* transport_;
+
+            char* obstacles_;
+
+            // conductivity * timeStep_ / SPACE_STEP^2 for empty cells, 0 for fixed cells and outside the map:
+            Real* weights_;
+
+            // Two buffers swapped by calculate():
+            Real* temperatures_;
+            Real* nextTemperatures_;
+
+            // The whole map on rank 0 (column-major and dense), nullptr elsewhere:
+            Real* frame_;
+
+            HDC image_;
+
+            double timeStep_;
+            double stableTimeStep_;
+
+            StencilKernel<Real> stencil_;
+
+            size_t mapWidth_;
+            size_t firstX_;
+
+            size_t  width_;
+            size_t height_;
+            size_t  pitch_;
+            size_t origin_;
+            size_t  cells_;
+
+            // Owned columns are 0 .. width_ - 1, ghosts -GRID_HALO .. -1 and width_ .. width_ + GRID_HALO - 1:
+            inline size_t column(const ptrdiff_t x) const;
+
+            // Sends depth edge columns to each neighbour and receives theirs into the ghosts:
+            void exchange(const size_t depth);
+
+            Subdomain(const Subdomain&);
+            Subdomain& operator=(const Subdomain&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real, typename Transport>
+        Subdomain<Real, Transport>::Subdomain(Transport* transport,
+                                              const char* conductivitiesFileName,
+                                              const char*      obstaclesFileName,
+                                              const char*          imageFileName,
+                                              const size_t width,
+                                              const size_t height,
+                                              const double wallConditions,
+                                              const double emptySpaceConditions) :
+            transport_        (transport),
+            obstacles_        (nullptr),
+            weights_          (nullptr),
+            temperatures_     (nullptr),
+            nextTemperatures_ (nullptr),
+            frame_            (nullptr),
+            image_            (nullptr),
+            timeStep_         (TIME_STEP),
+            stableTimeStep_   (HUGE_VAL),
+            stencil_          (stencilKernel<Real>(stencilIsa(), STENCIL_5_POINT)),
+            mapWidth_         (width),
+            firstX_           (0),
+            width_            (0),
+            height_           (height),
+            pitch_            (0),
+            origin_           (0),
+            cells_            (0)
+        {
+            // Checking input:
+
+                assert(transport != nullptr);
+
+                assert(obstaclesFileName != nullptr);
+                assert(conductivitiesFileName != nullptr);
+                assert(imageFileName != nullptr);
+
+                const unsigned int rank  = transport->rank();
+                const unsigned int ranks = transport->ranks();
+
+                assert(width >= ranks * GRID_HALO);
+
+            // Computing layout (see paddedLayout()):
+
+                firstX_ = width *  rank      / ranks;
+                width_  = width * (rank + 1) / ranks - firstX_;
+
+                GridLayout grid = paddedLayout(width_, height_, sizeof(Real));
+
+                pitch_  = grid.pitch;
+                origin_ = grid.origin;
+                cells_  = grid.cells;
+
+            // Creating arrays (cells outside the map are zero-temperature walls):
+
+                obstacles_ = (char*) alignedCalloc(cells_, sizeof(*obstacles_));
+                memset(obstacles_, WALL_TILE, cells_ * sizeof(*obstacles_));
+
+                weights_          = (Real*) alignedCalloc(cells_, sizeof(*weights_));
+                temperatures_     = (Real*) alignedCalloc(cells_, sizeof(*temperatures_));
+                nextTemperatures_ = (Real*) alignedCalloc(cells_, sizeof(*nextTemperatures_));
+
+                if (rank == 0)
+                {
+                    frame_ = (Real*) alignedCalloc(mapWidth_ * height_, sizeof(*frame_));
+
+                    image_ = txLoadImage(imageFileName);
+                    assert(image_);
+                }
+
+            // Reading the maps (weights_ holds the conductivities until the step is known):
+
+                HDC obstaclesMap      = txLoadImage(obstaclesFileName);
+                HDC conductivitiesMap = txLoadImage(conductivitiesFileName);
+
+                assert(obstaclesMap && conductivitiesMap);
+
+                for (size_t mapX = 0; mapX < mapWidth_; mapX++)
+                {
+                    const ptrdiff_t x = (ptrdiff_t) mapX - (ptrdiff_t) firstX_;
+
+                    const bool local = (-(ptrdiff_t) GRID_HALO <= x && x < (ptrdiff_t) (width_ + GRID_HALO));
+
+                    for (size_t y = 0; y < height_; y++)
+                    {
+                        COLORREF currentColor = GetPixel(obstaclesMap, mapX, y);
+
+                        char tile = (currentColor == RGB(  0, 0, 0))?   WALL_TILE :
+                                    (currentColor == RGB(255, 0, 0))? BORDER_TILE :
+                                                                       EMPTY_TILE;
+
+                        // The outermost cells of the map are fixed, like in Field:
+                        bool edge = (mapX == 0 || y == 0 || mapX == mapWidth_ - 1 || y == height_ - 1);
+
+                        if (edge && tile == EMPTY_TILE) tile = BORDER_TILE;
+
+                        // Rounded like Field's conductivities_, for the same step and weights:
+                        const Real conductivity = (Real) (THERMAL_CONDUCTIVITY_COEFFICIENT * lerp(0.0, 1.0, (double) txExtractColor(GetPixel(conductivitiesMap, mapX, y), TX_RED) / 255));
+
+                        if (tile == EMPTY_TILE && conductivity > 0)
+                        {
+                            stableTimeStep_ = std::min(stableTimeStep_, SPACE_STEP * SPACE_STEP / (4 * (double) conductivity));
+                        }
+
+                        if (!local) continue;
+
+                        obstacles_[column(x) + y] = tile;
+                        weights_  [column(x) + y] = conductivity;
+                    }
+                }
+
+                txDeleteDC(obstaclesMap);
+                txDeleteDC(conductivitiesMap);
+
+            // Compiling scene and filling temperatures (ghosts included, the first exchange overwrites them):
+
+                if (timeStep_ > stableTimeStep_) timeStep_ = stableTimeStep_;
+
+                for (ptrdiff_t x = -(ptrdiff_t) GRID_HALO; x < (ptrdiff_t) (width_ + GRID_HALO); x++)
+                {
+                    for (size_t y = 0; y < height_; y++)
+                    {
+                        const size_t cell = column(x) + y;
+                        const char   tile = obstacles_[cell];
+
+                        weights_[cell] = (tile == EMPTY_TILE)? (Real) (weights_[cell] * timeStep_ / (SPACE_STEP * SPACE_STEP)) : 0;
+
+                        temperatures_[cell] = (tile ==   WALL_TILE)? 0 :
+                                              (tile == BORDER_TILE)? (Real) wallConditions :
+                                                                     (Real) emptySpaceConditions;
+                    }
+                }
+
+                // Cells that calculate() never changes must be equal in both buffers:
+                memcpy(nextTemperatures_, temperatures_, cells_ * sizeof(*temperatures_));
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real, typename Transport>
+        Subdomain<Real, Transport>::~Subdomain()
+        {
+            assert(ok());
+
+            alignedFree(obstacles_);
+            alignedFree(weights_);
+
+            alignedFree(temperatures_);
+            alignedFree(nextTemperatures_);
+
+            if (frame_ != nullptr) alignedFree(frame_);
+            if (image_ != nullptr) txDeleteDC(image_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real, typename Transport>
+        bool Subdomain<Real, Transport>::ok() const
+        {
+            bool everythingOk = true;
+
+            if (transport_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Subdomain::ok(): Transport is a null pointer.");
+            }
+
+            if (obstacles_ == nullptr || weights_ == nullptr || temperatures_ == nullptr || nextTemperatures_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Subdomain::ok(): Arrays are null pointers.");
+            }
+
+            if (width_ < GRID_HALO || firstX_ + width_ > mapWidth_)
+            {
+                everythingOk = false;
+                printf("Subdomain::ok(): Columns %d..%d do not fit the map of %d.", firstX_, firstX_ + width_, mapWidth_);
+            }
+
+            return everythingOk;
+        }
+
+        template <typename Real, typename Transport>
+        inline size_t Subdomain<Real, Transport>::column(const ptrdiff_t x) const
+        {
+            return (size_t) ((ptrdiff_t) origin_ + x * (ptrdiff_t) pitch_);
+        }
+
+        template <typename Real, typename Transport>
+        void Subdomain<Real, Transport>::adjustTemperature(const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const double deltaTemperature)
+        {
+            // Checking input:
+
+                assert(ok());
+
+            // Creating resources (the brush of Field::adjustTemperature(), cut to the owned columns):
+
+                const size_t startX = std::max((size_t) ((roundX < radius)? 0 : roundX - radius), firstX_);
+                const size_t startY =                    (roundY < radius)? 0 : roundY - radius;
+
+                const size_t finishX = std::min((size_t) ((roundX + radius < mapWidth_)? roundX + radius : mapWidth_ - 1), firstX_ + width_);
+                const size_t finishY =                    (roundY + radius <   height_)? roundY + radius :   height_ - 1;
+
+            // Main algorithm:
+
+                for (size_t x = startX; x < finishX; x++)
+                {
+                    for (size_t y = startY; y < finishY; y++)
+                    {
+                        const size_t cell = column(x - firstX_) + y;
+
+                        if (obstacles_[cell] != EMPTY_TILE) continue;
+
+                        if (pow((signed) roundX - (signed) x, 2) + pow((signed) roundY - (signed) y, 2) < pow(radius, 2))
+                        {
+                            if  (temperatures_[cell] + deltaTemperature < 0) temperatures_[cell] = 0;
+                            else temperatures_[cell] += deltaTemperature;
+                        }
+                    }
+                }
+        }
+
+        template <typename Real, typename Transport>
+        void Subdomain<Real, Transport>::exchange(const size_t depth)
+        {
+            assert(depth <= GRID_HALO);
+
+            const unsigned int rank  = transport_->rank();
+            const unsigned int ranks = transport_->ranks();
+
+            const size_t bytes = height_ * sizeof(*temperatures_);
+
+            // Rightwards first, then leftwards: a halo larger than a ring only waits for the
+            // receiver downstream, which never waits for it, so the exchange cannot deadlock:
+
+            if (rank + 1 < ranks)
+            {
+                for (size_t x = width_ - depth; x < width_; x++) transport_->send(rank + 1, temperatures_ + column(x), bytes);
+            }
+
+            if (rank > 0)
+            {
+                for (ptrdiff_t x = -(ptrdiff_t) depth; x < 0; x++) transport_->receive(rank - 1, temperatures_ + column(x), bytes);
+            }
+
+            if (rank > 0)
+            {
+                for (size_t x = 0; x < depth; x++) transport_->send(rank - 1, temperatures_ + column(x), bytes);
+            }
+
+            if (rank + 1 < ranks)
+            {
+                for (size_t x = width_; x < width_ + depth; x++) transport_->receive(rank + 1, temperatures_ + column(x), bytes);
+            }
+        }
+
+        template <typename Real, typename Transport>
+        void Subdomain<Real, Transport>::calculate()
+        {
+            calculate(1);
+        }
+
+        template <typename Real, typename Transport>
+        void Subdomain<Real, Transport>::calculate(const unsigned int steps)
+        {
+            // Checking input:
+
+                assert(ok());
+
+            // Main algorithm:
+
+                for (unsigned int step = 0; step < steps; )
+                {
+                    const size_t depth = std::min((size_t) (steps - step), GRID_HALO);
+
+                    exchange(depth);
+
+                    // Step s of the round also updates the depth - 1 - s ghost columns on each side that the
+                    // next steps read (ghosts outside the map have zero weight and stay zero):
+
+                    for (size_t s = 0; s < depth; s++)
+                    {
+                        const ptrdiff_t overlap = (ptrdiff_t) (depth - 1 - s);
+
+                        for (ptrdiff_t x = -overlap; x < (ptrdiff_t) width_ + overlap; x++)
+                        {
+                            stencil_(nextTemperatures_ + column(x), temperatures_ + column(x), weights_ + column(x), nullptr, pitch_, height_);
+                        }
+
+                        Real* currentTemperatures = temperatures_;
+
+                        temperatures_     = nextTemperatures_;
+                        nextTemperatures_ = currentTemperatures;
+                    }
+
+                    step += (unsigned int) depth;
+                }
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real, typename Transport>
+        double Subdomain<Real, Transport>::stableTimeStep() const
+        {
+            return stableTimeStep_;
+        }
+
+        template <typename Real, typename Transport>
+        double Subdomain<Real, Transport>::timeStep() const
+        {
+            return timeStep_;
+        }
+
+        template <typename Real, typename Transport>
+        size_t Subdomain<Real, Transport>::firstColumn() const
+        {
+            return firstX_;
+        }
+
+        template <typename Real, typename Transport>
+        size_t Subdomain<Real, Transport>::columns() const
+        {
+            return width_;
+        }
+
+        template <typename Real, typename Transport>
+        Real Subdomain<Real, Transport>::temperature(const size_t x, const size_t y) const
+        {
+            assert(firstX_ <= x && x < firstX_ + width_ && y < height_);
+
+            return temperatures_[column(x - firstX_) + y];
+        }
+
+        // Columns travel in map order: a rank sends its own, then relays the rest of the map
+        // as its right neighbour sends it:
+        template <typename Real, typename Transport>
+        void Subdomain<Real, Transport>::gather()
+        {
+            // Checking input:
+
+                assert(ok());
+
+            // Creating resources:
+
+                const unsigned int rank  = transport_->rank();
+                const unsigned int ranks = transport_->ranks();
+
+                const size_t bytes = height_ * sizeof(*temperatures_);
+
+                Real* relay = (rank > 0 && rank + 1 < ranks)? (Real*) alignedCalloc(height_, sizeof(*relay)) : nullptr;
+
+            // Main algorithm:
+
+                if (rank == 0)
+                {
+                    for (size_t x = 0; x < width_; x++) memcpy(frame_ + x * height_, temperatures_ + column(x), bytes);
+
+                    for (size_t x = width_; x < mapWidth_; x++) transport_->receive(1, frame_ + x * height_, bytes);
+                }
+                else
+                {
+                    for (size_t x = 0; x < width_; x++) transport_->send(rank - 1, temperatures_ + column(x), bytes);
+
+                    for (size_t x = firstX_ + width_; x < mapWidth_; x++)
+                    {
+                        transport_->receive(rank + 1, relay, bytes);
+                        transport_->send   (rank - 1, relay, bytes);
+                    }
+                }
+
+            // Deleting resources:
+
+                if (relay != nullptr) alignedFree(relay);
+        }
+
+        template <typename Real, typename Transport>
+        bool Subdomain<Real, Transport>::broadcast(const bool value)
+        {
+            const unsigned int rank  = transport_->rank();
+            const unsigned int ranks = transport_->ranks();
+
+            char message = (char) value;
+
+            if (rank > 0)         transport_->receive(rank - 1, &message, sizeof(message));
+            if (rank + 1 < ranks) transport_->send   (rank + 1, &message, sizeof(message));
+
+            return message != 0;
+        }
+
+        template <typename Real, typename Transport>
+        void Subdomain<Real, Transport>::render(const unsigned int zoom /*= 1*/) const
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(frame_ != nullptr && image_ != nullptr);
+
+            // Main algorithm:
+
+                txSetFillColor (TX_BLACK);
+                txClear();
+
+                for (size_t x = 0; x < mapWidth_; x++)
+                {
+                    for (size_t y = 0; y < height_; y++)
+                    {
+                        COLORREF currentColor = colorLerp(log(log(frame_[x * height_ + y] + 1) + 1), GetPixel(image_, x, y), MID_COLOR, WARM_COLOR);
+
+                        if (zoom >= 3)
+                        {
+                            txSetColor    (currentColor);
+                            txSetFillColor(currentColor);
+
+                            txRectangle(x * zoom, y * zoom, (x + 1) * zoom, (y + 1) * zoom);
+                        }
+                        else
+                        {
+                            txSetPixel(x * zoom, y * zoom, currentColor);
+                        }
+                    }
+                }
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
@@ -0,0 +1,601 @@
+#pragma once
+
+#include "Classes.h"
+
+
+//----------------------------------------------------------------------------
+//{ Ensemble
+//----------------------------------------------------------------------------
+
+    // Many scenarios of one scene side by side: every cell holds LANES temperatures in one cache line,
+    // one per member (array of structures of arrays), and blocks of LANES members follow each other.
+    // A sweep reads the geometry and the weights once per cell for all members of a block and updates
+    // them with full-width vector operations (see ensembleAvx512()), so a parameter sweep runs as one
+    // job instead of a process per member.
+    //
+    // Members share the obstacles, the conductivity map and the time step and differ in their
+    // temperatures (brushes are applied per member) and in a scale of the conductivity map.
+    // The step is the one the best conductor of all members allows, so a member with scale 1
+    // follows a Field of the same scene exactly unless another member lowered the step.
+    //
+    // A block moves a whole cache line per cell and step, so calculate(steps) blocks in time like
+    // Field::sweepBlocked(), with whole columns instead of strips: at wave p step s updates column
+    // p - s, and the depth + 2 columns in flight stay in cache for all steps of a pass.
+
+    template <typename Real>
+    class Ensemble
+    {
+        public:
+
+            // Members updated by one register-wide operation per cell:
+            static const size_t LANES = GRID_ALIGNMENT / sizeof(Real);
+
+            // Constructor && destructor:
+
+                Ensemble(const char* conductivitiesFileName,
+                         const char*      obstaclesFileName,
+                         const char*          imageFileName,
+                         const size_t width,
+                         const size_t height,
+                         const size_t members,
+                         const double wallConditions,
+                         const double emptySpaceConditions);
+
+                ~Ensemble();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Members:
+
+                    size_t members() const;
+
+                    // The member's conductivities are scale times the map's (1 for every member at first):
+                    void setConductivityScale(const size_t member, const double scale);
+
+                    void adjustTemperature(const size_t member, const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const double deltaTemperature);
+
+                    Real temperature(const size_t member, const size_t x, const size_t y) const;
+
+                // Calculations:
+
+                    void calculate();
+                    void calculate(const unsigned int steps);
+
+                    double stableTimeStep() const;
+                    double timeStep() const;
+
+                    // 1 (the default) calculates on the calling thread only:
+                    void setThreads(const unsigned int threads);
+
+                // Rendering:
+
+                    void render(const size_t member, const unsigned int zoom = 1) const;
+
+        private:
+
+            // Geometry in the padded layout of a Field (see Field::index()):
+
+            char* obstacles_;
+
+            Real* conductivities_;
+
+            // conductivity * timeStep_ / SPACE_STEP^2 for empty cells, 0 for walls, borders and ghosts:
+            Real* weights_;
+
+            // Scales of the members, padded with zeros to whole blocks:
+            Real* scales_;
+
+            // Interleaved temperatures, ((block * cells_ + cell) * LANES + lane), swapped by calculate():
+            Real* temperatures_;
+            Real* nextTemperatures_;
+
+            double timeStep_;
+            double stableTimeStep_;
+
+            EnsembleKernel<Real> kernel_;
+
+            ThreadPool* pool_;
+
+            HDC image_;
+
+            GridLayout grid_;
+
+            size_t members_;
+            size_t blocks_;
+
+            inline Real* cell(Real* temperatures, const size_t member, const size_t x, const size_t y) const;
+
+            void compileScene();
+
+            void sweepColumns(const size_t start, const size_t finish);
+            void sweepBlock(const size_t block, const unsigned int depth);
+
+            struct BlockedSweep
+            {
+                Ensemble*    ensemble;
+                unsigned int depth;
+            };
+
+            static void sweepColumnsTask(void* ensemble, const unsigned int worker, const unsigned int workers);
+            static void sweepBlocksTask (void* sweep,    const unsigned int worker, const unsigned int workers);
+
+            Ensemble(const Ensemble&);
+            Ensemble& operator=(const Ensemble&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        Ensemble<Real>::Ensemble(const char* conductivitiesFileName,
+                                 const char*      obstaclesFileName,
+                                 const char*          imageFileName,
+                                 const size_t width,
+                                 const size_t height,
+                                 const size_t members,
+                                 const double wallConditions,
+                                 const double emptySpaceConditions) :
+            obstacles_        (nullptr),
+            conductivities_   (nullptr),
+            weights_          (nullptr),
+            scales_           (nullptr),
+            temperatures_     (nullptr),
+            nextTemperatures_ (nullptr),
+            timeStep_         (TIME_STEP),
+            stableTimeStep_   (HUGE_VAL),
+            kernel_           (ensembleKernel<Real>(stencilIsa())),
+            pool_             (nullptr),
+            image_            (nullptr),
+            grid_             (paddedLayout(width, height, sizeof(Real))),
+            members_          (members),
+            blocks_           ((members + LANES - 1) / LANES)
+        {
+            // Checking input:
+
+                assert(conductivitiesFileName != nullptr);
+                assert(obstaclesFileName != nullptr);
+                assert(imageFileName != nullptr);
+
+                assert(members > 0);
+
+            // Creating image:
+
+                image_ = txLoadImage(imageFileName);
+                assert(image_);
+
+            // Creating arrays (ghost cells are zero-temperature walls):
+
+                obstacles_ = (char*) alignedCalloc(grid_.cells, sizeof(*obstacles_));
+                memset(obstacles_, WALL_TILE, grid_.cells * sizeof(*obstacles_));
+
+                conductivities_ = (Real*) alignedCalloc(grid_.cells, sizeof(*conductivities_));
+                weights_        = (Real*) alignedCalloc(grid_.cells, sizeof(*weights_));
+                scales_         = (Real*) alignedCalloc(blocks_ * LANES, sizeof(*scales_));
+
+                temperatures_     = (Real*) alignedCalloc(blocks_ * grid_.cells * LANES, sizeof(*temperatures_));
+                nextTemperatures_ = (Real*) alignedCalloc(blocks_ * grid_.cells * LANES, sizeof(*nextTemperatures_));
+
+                for (size_t member = 0; member < members_; member++) scales_[member] = 1;
+
+            // Filling the geometry like a Field does:
+
+                HDC obstaclesMap      = txLoadImage(obstaclesFileName);
+                HDC conductivitiesMap = txLoadImage(conductivitiesFileName);
+
+                assert(obstaclesMap && conductivitiesMap);
+
+                for (size_t x = 0; x < width; x++)
+                {
+                    for (size_t y = 0; y < height; y++)
+                    {
+                        const size_t index = grid_.index(x, y);
+
+                        COLORREF currentColor = GetPixel(obstaclesMap, x, y);
+
+                        obstacles_[index] = (currentColor == RGB(  0, 0, 0))?   WALL_TILE :
+                                            (currentColor == RGB(255, 0, 0))? BORDER_TILE :
+                                                                               EMPTY_TILE;
+
+                        // The outermost cells have always been fixed:
+                        bool edge = (x == 0 || y == 0 || x == width - 1 || y == height - 1);
+
+                        if (edge && obstacles_[index] == EMPTY_TILE) obstacles_[index] = BORDER_TILE;
+
+                        conductivities_[index] = THERMAL_CONDUCTIVITY_COEFFICIENT * lerp(0.0, 1.0, (double) txExtractColor(GetPixel(conductivitiesMap, x, y), TX_RED) / 255);
+                    }
+                }
+
+                txDeleteDC(obstaclesMap);
+                txDeleteDC(conductivitiesMap);
+
+            // Compiling scene:
+
+                compileScene();
+
+            // Filling temperatures (walls hold zero, borders the wall conditions):
+
+                for (size_t member = 0; member < members_; member++)
+                {
+                    for (size_t x = 0; x < width; x++)
+                    {
+                        for (size_t y = 0; y < height; y++)
+                        {
+                            const char tile = obstacles_[grid_.index(x, y)];
+
+                            *cell(temperatures_, member, x, y) = (tile ==   WALL_TILE)? 0 :
+                                                                 (tile == BORDER_TILE)? (Real) wallConditions :
+                                                                                        (Real) emptySpaceConditions;
+                        }
+                    }
+                }
+
+                // Cells that calculate() never changes must be equal in both buffers:
+                memcpy(nextTemperatures_, temperatures_, blocks_ * grid_.cells * LANES * sizeof(*temperatures_));
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        Ensemble<Real>::~Ensemble()
+        {
+            assert(ok());
+
+            alignedFree(obstacles_);
+            alignedFree(conductivities_);
+            alignedFree(weights_);
+            alignedFree(scales_);
+
+            alignedFree(temperatures_);
+            alignedFree(nextTemperatures_);
+
+            delete pool_;
+
+            txDeleteDC(image_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        bool Ensemble<Real>::ok() const
+        {
+            bool everythingOk = true;
+
+            if (obstacles_ == nullptr || conductivities_ == nullptr || weights_ == nullptr || scales_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Ensemble::ok(): Scene arrays are null pointers.");
+            }
+
+            if (temperatures_ == nullptr || nextTemperatures_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Ensemble::ok(): Temperature buffers are null pointers.");
+            }
+
+            if (blocks_ * LANES < members_)
+            {
+                everythingOk = false;
+                printf("Ensemble::ok(): %d blocks do not hold %d members.", blocks_, members_);
+            }
+
+            if (image_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Ensemble::ok(): Image array is a null pointer.");
+            }
+
+            return everythingOk;
+        }
+
+        template <typename Real>
+        inline Real* Ensemble<Real>::cell(Real* temperatures, const size_t member, const size_t x, const size_t y) const
+        {
+            return temperatures + ((member / LANES) * grid_.cells + grid_.index(x, y)) * LANES + member % LANES;
+        }
+
+        template <typename Real>
+        size_t Ensemble<Real>::members() const
+        {
+            return members_;
+        }
+
+        // The best conductor of any member bounds the shared step, as in Field::compileScene():
+        template <typename Real>
+        void Ensemble<Real>::compileScene()
+        {
+            Real largestScale = 0;
+
+            for (size_t member = 0; member < members_; member++) largestScale = std::max(largestScale, scales_[member]);
+
+            stableTimeStep_ = HUGE_VAL;
+
+            for (size_t x = 0; x < grid_.width; x++)
+            {
+                for (size_t y = 0; y < grid_.height; y++)
+                {
+                    const double conductivity = conductivities_[grid_.index(x, y)] * largestScale;
+
+                    if (obstacles_[grid_.index(x, y)] == EMPTY_TILE && conductivity > 0)
+                    {
+                        stableTimeStep_ = std::min(stableTimeStep_, SPACE_STEP * SPACE_STEP / (4 * conductivity));
+                    }
+                }
+            }
+
+            if (timeStep_ > stableTimeStep_) timeStep_ = stableTimeStep_;
+
+            for (size_t x = 0; x < grid_.width; x++)
+            {
+                for (size_t y = 0; y < grid_.height; y++)
+                {
+                    const size_t index = grid_.index(x, y);
+
+                    weights_[index] = (obstacles_[index] == EMPTY_TILE)? conductivities_[index] * timeStep_ / (SPACE_STEP * SPACE_STEP) : 0;
+                }
+            }
+        }
+
+        template <typename Real>
+        void Ensemble<Real>::setConductivityScale(const size_t member, const double scale)
+        {
+            // Checking input:
+
+                assert(ok());
+
+                assert(member < members_);
+                assert(scale >= 0);
+
+            // Main algorithm:
+
+                scales_[member] = (Real) scale;
+
+                compileScene();
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        // Field::adjustTemperature() for one member:
+        template <typename Real>
+        void Ensemble<Real>::adjustTemperature(const size_t member, const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const double deltaTemperature)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(member < members_);
+
+            // Creating resources:
+
+                unsigned int startX = (roundX < radius)? 0 : roundX - radius;
+                unsigned int startY = (roundY < radius)? 0 : roundY - radius;
+
+                unsigned int finishX = (roundX + radius <  grid_.width)? roundX + radius :  grid_.width - 1;
+                unsigned int finishY = (roundY + radius < grid_.height)? roundY + radius : grid_.height - 1;
+
+            // Main algorithm:
+
+                for (size_t x = startX; x < finishX; x++)
+                {
+                    for (size_t y = startY; y < finishY; y++)
+                    {
+                        if (obstacles_[grid_.index(x, y)] != EMPTY_TILE) continue;
+
+                        if (pow((signed) roundX - (signed) x, 2) + pow((signed) roundY - (signed) y, 2) < pow(radius, 2))
+                        {
+                            Real* temperature = cell(temperatures_, member, x, y);
+
+                            if  (*temperature + deltaTemperature < 0) *temperature = 0;
+                            else *temperature += deltaTemperature;
+                        }
+                    }
+                }
+        }
+
+        template <typename Real>
+        Real Ensemble<Real>::temperature(const size_t member, const size_t x, const size_t y) const
+        {
+            assert(member < members_);
+            assert(x < grid_.width && y < grid_.height);
+
+            return *cell(temperatures_, member, x, y);
+        }
+
+        template <typename Real>
+        void Ensemble<Real>::calculate()
+        {
+            // Checking input:
+
+                assert(ok());
+
+            // Main algorithm:
+
+                if (pool_ != nullptr) pool_->run(sweepColumnsTask, this);
+                else                  sweepColumns(0, grid_.width);
+
+                Real* currentTemperatures = temperatures_;
+
+                temperatures_     = nextTemperatures_;
+                nextTemperatures_ = currentTemperatures;
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        // Bit-identical to steps calls of calculate(). Workers take whole blocks, with fewer blocks
+        // than workers they share the columns of every step instead:
+        template <typename Real>
+        void Ensemble<Real>::calculate(const unsigned int steps)
+        {
+            // Checking input:
+
+                assert(ok());
+
+            // Main algorithm:
+
+                if (pool_ != nullptr && blocks_ < pool_->size())
+                {
+                    for (unsigned int step = 0; step < steps; step++) calculate();
+                    return;
+                }
+
+                for (unsigned int done = 0; done < steps; done += TEMPORAL_BLOCK_DEPTH)
+                {
+                    BlockedSweep sweep = {this, (steps - done < TEMPORAL_BLOCK_DEPTH)? steps - done : TEMPORAL_BLOCK_DEPTH};
+
+                    if (pool_ != nullptr) pool_->run(sweepBlocksTask, &sweep);
+                    else                  sweepBlocksTask(&sweep, 0, 1);
+
+                    // Step s wrote buffer s + 1 (mod 2):
+                    if (sweep.depth % 2 != 0)
+                    {
+                        Real* currentTemperatures = temperatures_;
+
+                        temperatures_     = nextTemperatures_;
+                        nextTemperatures_ = currentTemperatures;
+                    }
+                }
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        double Ensemble<Real>::stableTimeStep() const
+        {
+            return stableTimeStep_;
+        }
+
+        template <typename Real>
+        double Ensemble<Real>::timeStep() const
+        {
+            return timeStep_;
+        }
+
+        template <typename Real>
+        void Ensemble<Real>::setThreads(const unsigned int threads)
+        {
+            assert(ok());
+            assert(threads > 0);
+
+            delete pool_;
+            pool_ = (threads > 1)? new ThreadPool(threads) : nullptr;
+        }
+
+        // Columns [start, finish) of every block:
+        template <typename Real>
+        void Ensemble<Real>::sweepColumns(const size_t start, const size_t finish)
+        {
+            for (size_t block = 0; block < blocks_; block++)
+            {
+                const size_t offset = block * grid_.cells * LANES;
+
+                for (size_t x = start; x < finish; x++)
+                {
+                    const size_t column = grid_.index(x, 0);
+
+                    kernel_(nextTemperatures_ + offset + column * LANES, temperatures_ + offset + column * LANES,
+                            weights_ + column, scales_ + block * LANES, grid_.pitch, grid_.height);
+                }
+            }
+        }
+
+        // Step s reads buffer s (mod 2) and writes the other; column p - s at wave p finds its neighbours
+        // of step s - 1 done and the values it overwrites read by every step that needed them:
+        template <typename Real>
+        void Ensemble<Real>::sweepBlock(const size_t block, const unsigned int depth)
+        {
+            const size_t offset = block * grid_.cells * LANES;
+
+            Real* buffers[2] = {temperatures_ + offset, nextTemperatures_ + offset};
+
+            for (size_t wave = 0; wave < grid_.width + depth - 1; wave++)
+            {
+                for (unsigned int step = 0; step < depth; step++)
+                {
+                    if (wave < step || wave - step >= grid_.width) continue;
+
+                    const size_t column = grid_.index(wave - step, 0);
+
+                    kernel_(buffers[(step + 1) % 2] + column * LANES, buffers[step % 2] + column * LANES,
+                            weights_ + column, scales_ + block * LANES, grid_.pitch, grid_.height);
+                }
+            }
+        }
+
+        template <typename Real>
+        void Ensemble<Real>::sweepBlocksTask(void* sweep, const unsigned int worker, const unsigned int workers)
+        {
+            BlockedSweep* blockedSweep = (BlockedSweep*) sweep;
+
+            for (size_t block = worker; block < blockedSweep->ensemble->blocks_; block += workers)
+            {
+                blockedSweep->ensemble->sweepBlock(block, blockedSweep->depth);
+            }
+        }
+
+        template <typename Real>
+        void Ensemble<Real>::sweepColumnsTask(void* ensemble, const unsigned int worker, const unsigned int workers)
+        {
+            Ensemble* self = (Ensemble*) ensemble;
+
+            self->sweepColumns(self->grid_.width *  worker      / workers,
+                               self->grid_.width * (worker + 1) / workers);
+        }
+
+        // Field::render() for one member:
+        template <typename Real>
+        void Ensemble<Real>::render(const size_t member, const unsigned int zoom /*= 1*/) const
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(member < members_);
+
+            // Main algorithm:
+
+                txSetFillColor (TX_BLACK);
+                txClear();
+
+                for (size_t x = 0; x < grid_.width; x++)
+                {
+                    for (size_t y = 0; y < grid_.height; y++)
+                    {
+                        COLORREF currentColor = colorLerp(log(log(*cell(temperatures_, member, x, y) + 1) + 1), GetPixel(image_, x, y), MID_COLOR, WARM_COLOR);
+
+                        if (zoom >= 3)
+                        {
+                            txSetColor    (currentColor);
+                            txSetFillColor(currentColor);
+
+                            txRectangle(x * zoom, y * zoom, (x + 1) * zoom, (y + 1) * zoom);
+                        }
+                        else
+                        {
+                            txSetPixel(x * zoom, y * zoom, currentColor);
+                        }
+                    }
+                }
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
@@ -0,0 +1,83 @@
+#pragma once
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // Grid columns are padded to a multiple of this many bytes (one cache line):
+    const size_t GRID_ALIGNMENT = 64;
+
+    // Width of the ghost ring around the picture (the fourth order stencil reads two cells away):
+    const size_t GRID_HALO = 2;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Defines (typedefs)
+//----------------------------------------------------------------------------
+
+    // Padded column-major layout shared by a Field and the solvers working on its grids:
+    // cell (x, y) lives at origin + x * pitch + y, everything else of the cells is ghost or padding.
+    struct GridLayout
+    {
+        size_t  width;
+        size_t height;
+        size_t  pitch;
+        size_t origin;
+        size_t  cells;
+
+        inline size_t index(const size_t x, const size_t y) const
+        {
+            return origin + x * pitch + y;
+        }
+    };
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Additional functions
+//----------------------------------------------------------------------------
+
+    // Aligned memory:
+
+    void* alignedCalloc(const size_t count, const size_t size)
+    {
+        void* memory = _aligned_malloc(count * size, GRID_ALIGNMENT);
+        assert(memory);
+
+        memset(memory, 0, count * size);
+
+        return memory;
+    }
+
+    inline void alignedFree(void* memory)
+    {
+        _aligned_free(memory);
+    }
+
+    // Layout of a width x height picture with its ghost ring: every column starts with an aligned
+    // block that holds its upper ghost cells, so cell (x, 0) is aligned and columns are whole cache lines:
+
+    GridLayout paddedLayout(const size_t width, const size_t height, const size_t cellSize)
+    {
+        const size_t alignedCells = GRID_ALIGNMENT / cellSize;
+
+        GridLayout grid = {};
+
+        grid.width  = width;
+        grid.height = height;
+
+        grid.pitch  = (alignedCells + height + GRID_HALO + alignedCells - 1) / alignedCells * alignedCells;
+        grid.origin = GRID_HALO * grid.pitch + alignedCells;
+        grid.cells  = (width + 2 * GRID_HALO) * grid.pitch;
+
+        return grid;
+    }
+
+//}
+//----------------------------------------------------------------------------
@@ -0,0 +1,371 @@
+#pragma once
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // Bytes of one ring (a power of two): messages of any length stream through it,
+    // so this only bounds how far a sender may run ahead of its receiver:
+    const size_t HALO_RING_CAPACITY = 1 << 20;
+
+    // The head and the tail of a ring sit on cache lines of their own in front of the data:
+    const size_t HALO_RING_HEADER = 2 * GRID_ALIGNMENT;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ HaloRing
+//----------------------------------------------------------------------------
+
+    // A single-producer single-consumer byte ring in named shared memory, the same name opening
+    // the same ring in any process of the session. head and tail count the bytes ever written and
+    // read modulo 2^32 (the capacity divides it), so the pages being zero is an empty ring and
+    // whichever side maps it first needs no initialization. Each side only ever writes its own
+    // counter, after the data it covers, and the other reads it with a full barrier.
+
+    class HaloRing
+    {
+        public:
+
+            // Constructor && destructor:
+
+                explicit HaloRing(const char* name);
+
+                ~HaloRing();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Streaming (both block while the ring is full or empty):
+
+                    void send(const void* data, const size_t bytes);
+                    void receive(void* data, const size_t bytes);
+
+        private:
+
+            struct Header
+            {
+                volatile LONG head;
+                char          headLine[HALO_RING_HEADER / 2 - sizeof(LONG)];
+
+                volatile LONG tail;
+                char          tailLine[HALO_RING_HEADER / 2 - sizeof(LONG)];
+            };
+
+            HANDLE  mapping_;
+            Header* header_;
+            char*   data_;
+
+            HaloRing(const HaloRing&);
+            HaloRing& operator=(const HaloRing&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        HaloRing::HaloRing(const char* name) :
+            mapping_ (nullptr),
+            header_  (nullptr),
+            data_    (nullptr)
+        {
+            // Checking input:
+
+                assert(name != nullptr);
+                assert((HALO_RING_CAPACITY & (HALO_RING_CAPACITY - 1)) == 0);
+
+            // Creating resources (opens the mapping when the other side created it already):
+
+                mapping_ = CreateFileMapping(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD) (HALO_RING_HEADER + HALO_RING_CAPACITY), name);
+                assert(mapping_);
+
+                header_ = (Header*) MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, HALO_RING_HEADER + HALO_RING_CAPACITY);
+                assert(header_);
+
+                data_ = (char*) header_ + HALO_RING_HEADER;
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        HaloRing::~HaloRing()
+        {
+            assert(ok());
+
+            UnmapViewOfFile(header_);
+            CloseHandle(mapping_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        bool HaloRing::ok() const
+        {
+            bool everythingOk = true;
+
+            if (mapping_ == nullptr || header_ == nullptr || data_ == nullptr)
+            {
+                everythingOk = false;
+                printf("HaloRing::ok(): Shared memory is not mapped.");
+            }
+
+            return everythingOk;
+        }
+
+        void HaloRing::send(const void* data, const size_t bytes)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(data != nullptr || bytes == 0);
+
+            // Main algorithm:
+
+                const char* source = (const char*) data;
+
+                size_t sent = 0;
+
+                while (sent < bytes)
+                {
+                    const ULONG head = (ULONG) header_->head;
+
+                    size_t space = 0;
+
+                    for (unsigned int spins = 0; (space = HALO_RING_CAPACITY - (ULONG) (head - (ULONG) atomicRead(&header_->tail))) == 0; )
+                    {
+                        spinWait(&spins);
+                    }
+
+                    const size_t offset = head & (HALO_RING_CAPACITY - 1);
+                    const size_t chunk  = std::min(std::min(bytes - sent, space), HALO_RING_CAPACITY - offset);
+
+                    memcpy(data_ + offset, source + sent, chunk);
+
+                    InterlockedExchangeAdd(&header_->head, (LONG) chunk);
+
+                    sent += chunk;
+                }
+        }
+
+        void HaloRing::receive(void* data, const size_t bytes)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(data != nullptr || bytes == 0);
+
+            // Main algorithm:
+
+                char* destination = (char*) data;
+
+                size_t received = 0;
+
+                while (received < bytes)
+                {
+                    const ULONG tail = (ULONG) header_->tail;
+
+                    size_t ready = 0;
+
+                    for (unsigned int spins = 0; (ready = (ULONG) ((ULONG) atomicRead(&header_->head) - tail)) == 0; )
+                    {
+                        spinWait(&spins);
+                    }
+
+                    const size_t offset = tail & (HALO_RING_CAPACITY - 1);
+                    const size_t chunk  = std::min(std::min(bytes - received, ready), HALO_RING_CAPACITY - offset);
+
+                    memcpy(destination + received, data_ + offset, chunk);
+
+                    InterlockedExchangeAdd(&header_->tail, (LONG) chunk);
+
+                    received += chunk;
+                }
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ SharedMemoryTransport
+//----------------------------------------------------------------------------
+
+    // Point-to-point messages between the local processes of a run, ranks 0 .. ranks - 1, in the
+    // shape of blocking MPI_Send() and MPI_Recv(): anything that has rank(), ranks(), send() and
+    // receive() like these can carry a Subdomain (see Decomposition.h), an MPI communicator included.
+    //
+    // Only neighbouring ranks are connected, by one HaloRing each way named after the run,
+    // which is all a decomposition into strips ever talks to.
+
+    class SharedMemoryTransport
+    {
+        public:
+
+            // Constructor && destructor:
+
+                // Every process of the run passes the same name and ranks and its own rank:
+                SharedMemoryTransport(const char* name, const unsigned int rank, const unsigned int ranks);
+
+                ~SharedMemoryTransport();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Messages (to and from rank - 1 or rank + 1 only, in order):
+
+                    void send   (const unsigned int to,   const void* data, const size_t bytes);
+                    void receive(const unsigned int from, void*       data, const size_t bytes);
+
+                    unsigned int rank () const;
+                    unsigned int ranks() const;
+
+        private:
+
+            // Rings towards and from the left (rank - 1) and right (rank + 1) neighbours, nullptr at the ends:
+            HaloRing* toLeft_;
+            HaloRing* toRight_;
+            HaloRing* fromLeft_;
+            HaloRing* fromRight_;
+
+            unsigned int rank_;
+            unsigned int ranks_;
+
+            static HaloRing* connect(const char* name, const unsigned int from, const unsigned int to);
+
+            SharedMemoryTransport(const SharedMemoryTransport&);
+            SharedMemoryTransport& operator=(const SharedMemoryTransport&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        SharedMemoryTransport::SharedMemoryTransport(const char* name, const unsigned int rank, const unsigned int ranks) :
+            toLeft_    (nullptr),
+            toRight_   (nullptr),
+            fromLeft_  (nullptr),
+            fromRight_ (nullptr),
+            rank_      (rank),
+            ranks_     (ranks)
+        {
+            // Checking input:
+
+                assert(name != nullptr);
+                assert(rank < ranks);
+
+            // Creating rings:
+
+                if (rank > 0)
+                {
+                    toLeft_   = connect(name, rank, rank - 1);
+                    fromLeft_ = connect(name, rank - 1, rank);
+                }
+
+                if (rank + 1 < ranks)
+                {
+                    toRight_   = connect(name, rank, rank + 1);
+                    fromRight_ = connect(name, rank + 1, rank);
+                }
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        SharedMemoryTransport::~SharedMemoryTransport()
+        {
+            assert(ok());
+
+            delete toLeft_;
+            delete toRight_;
+            delete fromLeft_;
+            delete fromRight_;
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        bool SharedMemoryTransport::ok() const
+        {
+            bool everythingOk = true;
+
+            if (rank_ >= ranks_)
+            {
+                everythingOk = false;
+                printf("SharedMemoryTransport::ok(): Rank %d of %d.", rank_, ranks_);
+            }
+
+            if ((rank_ > 0) != (toLeft_ != nullptr && fromLeft_ != nullptr) || (rank_ + 1 < ranks_) != (toRight_ != nullptr && fromRight_ != nullptr))
+            {
+                everythingOk = false;
+                printf("SharedMemoryTransport::ok(): Rank %d is not connected to its neighbours.", rank_);
+            }
+
+            return everythingOk;
+        }
+
+        HaloRing* SharedMemoryTransport::connect(const char* name, const unsigned int from, const unsigned int to)
+        {
+            char ringName[MAX_PATH] = "";
+
+            snprintf(ringName, sizeof(ringName), "Local\\%s-%u-%u", name, from, to);
+
+            return new HaloRing(ringName);
+        }
+
+        void SharedMemoryTransport::send(const unsigned int to, const void* data, const size_t bytes)
+        {
+            assert(ok());
+            assert(to + 1 == rank_ || to == rank_ + 1);
+
+            ((to < rank_)? toLeft_ : toRight_)->send(data, bytes);
+        }
+
+        void SharedMemoryTransport::receive(const unsigned int from, void* data, const size_t bytes)
+        {
+            assert(ok());
+            assert(from + 1 == rank_ || from == rank_ + 1);
+
+            ((from < rank_)? fromLeft_ : fromRight_)->receive(data, bytes);
+        }
+
+        unsigned int SharedMemoryTransport::rank() const
+        {
+            return rank_;
+        }
+
+        unsigned int SharedMemoryTransport::ranks() const
+        {
+            return ranks_;
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
@@ -0,0 +1,331 @@
+#pragma once
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // Schemes of Field::calculateImplicit() (the weight of the new time level):
+
+        const double BACKWARD_EULER = 1.0,
+                     CRANK_NICOLSON = 0.5;
+
+    // PCG stops once the residual dropped by this factor, or after this many iterations:
+
+        const double       IMPLICIT_TOLERANCE      = 1e-6;
+        const unsigned int IMPLICIT_MAX_ITERATIONS = 2000;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ ConjugateGradient
+//----------------------------------------------------------------------------
+
+    // Solves the system of one implicit step on a Field's padded grid without storing the matrix.
+    // Every unknown cell has the row
+    //     diagonal * x - (sum of its four neighbours' x) = rhs,
+    // with neighbours that are not unknowns already moved into rhs by the caller.
+    // A zero diagonal marks a cell that is not an unknown. Diagonals are at least 4,
+    // so the matrix is symmetric, diagonally dominant and CG converges. The preconditioner is
+    // Jacobi, which takes care of cells with very different conductivities, or a multigrid cycle,
+    // which also removes the smooth error components that make plain CG take O(sqrt(N)) iterations.
+
+    template <typename Real>
+    class ConjugateGradient
+    {
+        public:
+
+            // Constructor && destructor:
+
+                explicit ConjugateGradient(const GridLayout& grid);
+
+                ~ConjugateGradient();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // The system, filled by the caller (ghost and padding cells stay zero):
+
+                    Real* diagonal();
+                    Real* rhs();
+
+                // Solving:
+
+                    // x holds the initial guess and receives the solution, cells that are not unknowns are not touched;
+                    // without multigrid the preconditioner is Jacobi:
+                    unsigned int solve(Real* x, const double tolerance, const unsigned int maxIterations, Multigrid<Real>* multigrid = nullptr);
+
+                    // Relative residual reached by the last solve():
+                    double residual() const;
+
+        private:
+
+            GridLayout grid_;
+
+            Real* diagonal_;
+            Real* rhs_;
+
+            // Jacobi preconditioner, zero outside the unknowns like the iterates:
+            Real* inverseDiagonal_;
+
+            Real* solution_;
+            Real* residual_;
+            Real* preconditioned_;
+            Real* direction_;
+            Real* product_;
+
+            double relativeResidual_;
+
+            // Cells from the first to the last one of the picture, walked as one flat range:
+            size_t first_;
+            size_t last_;
+
+            // Returns vector . product, which CG needs right after every product:
+            double apply(const Real* vector, Real* product) const;
+
+            // Fills preconditioned_ from residual_, returns residual . preconditioned:
+            double precondition(Multigrid<Real>* multigrid);
+
+            ConjugateGradient(const ConjugateGradient&);
+            ConjugateGradient& operator=(const ConjugateGradient&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        ConjugateGradient<Real>::ConjugateGradient(const GridLayout& grid) :
+            grid_             (grid),
+            diagonal_         (nullptr),
+            rhs_              (nullptr),
+            inverseDiagonal_  (nullptr),
+            solution_         (nullptr),
+            residual_         (nullptr),
+            preconditioned_   (nullptr),
+            direction_        (nullptr),
+            product_          (nullptr),
+            relativeResidual_ (0),
+            first_            (grid.index(0, 0)),
+            last_             (grid.index(grid.width - 1, grid.height - 1) + 1)
+        {
+            // Creating arrays:
+
+                diagonal_        = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+                rhs_             = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+                inverseDiagonal_ = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+
+                solution_        = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+                residual_        = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+                preconditioned_  = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+                direction_       = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+                product_         = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        ConjugateGradient<Real>::~ConjugateGradient()
+        {
+            assert(ok());
+
+            alignedFree(diagonal_);
+            alignedFree(rhs_);
+            alignedFree(inverseDiagonal_);
+
+            alignedFree(solution_);
+            alignedFree(residual_);
+            alignedFree(preconditioned_);
+            alignedFree(direction_);
+            alignedFree(product_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        bool ConjugateGradient<Real>::ok() const
+        {
+            bool everythingOk = true;
+
+            if (diagonal_ == nullptr || rhs_ == nullptr || inverseDiagonal_ == nullptr)
+            {
+                everythingOk = false;
+                printf("ConjugateGradient::ok(): System arrays are null pointers.");
+            }
+
+            if (solution_ == nullptr || residual_ == nullptr || preconditioned_ == nullptr || direction_ == nullptr || product_ == nullptr)
+            {
+                everythingOk = false;
+                printf("ConjugateGradient::ok(): Iterate arrays are null pointers.");
+            }
+
+            if (first_ < grid_.pitch || last_ + grid_.pitch > grid_.cells)
+            {
+                everythingOk = false;
+                printf("ConjugateGradient::ok(): Cells %d..%d have no ghost columns around them.", first_, last_);
+            }
+
+            return everythingOk;
+        }
+
+        template <typename Real>
+        Real* ConjugateGradient<Real>::diagonal()
+        {
+            return diagonal_;
+        }
+
+        template <typename Real>
+        Real* ConjugateGradient<Real>::rhs()
+        {
+            return rhs_;
+        }
+
+        template <typename Real>
+        double ConjugateGradient<Real>::residual() const
+        {
+            return relativeResidual_;
+        }
+
+        template <typename Real>
+        unsigned int ConjugateGradient<Real>::solve(Real* x, const double tolerance, const unsigned int maxIterations, Multigrid<Real>* multigrid /*= nullptr*/)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(x);
+
+                assert(tolerance > 0);
+
+            // Creating resources:
+
+                for (size_t cell = first_; cell < last_; cell++)
+                {
+                    bool unknown = diagonal_[cell] > 0;
+
+                    inverseDiagonal_[cell] = (unknown)? 1 / diagonal_[cell] : 0;
+                    solution_       [cell] = (unknown)? x[cell]             : 0;
+                }
+
+                if (multigrid != nullptr) multigrid->setup(diagonal_);
+
+                apply(solution_, product_);
+
+                double rhsNorm      = 0;
+                double residualNorm = 0;
+
+                for (size_t cell = first_; cell < last_; cell++)
+                {
+                    residual_[cell] = rhs_[cell] - product_[cell];
+
+                    rhsNorm      += (double) rhs_     [cell] * rhs_[cell];
+                    residualNorm += (double) residual_[cell] * residual_[cell];
+                }
+
+                double rho = precondition(multigrid);
+
+                memcpy(direction_, preconditioned_, grid_.cells * sizeof(*direction_));
+
+            // Main algorithm (sums are in double even for float grids, the stopping test compares small residuals):
+
+                unsigned int iteration = 0;
+
+                for (; iteration < maxIterations && residualNorm > tolerance * tolerance * rhsNorm; iteration++)
+                {
+                    const double curvature = apply(direction_, product_);
+
+                    if (curvature <= 0) break;
+
+                    const Real alpha = rho / curvature;
+
+                    residualNorm = 0;
+
+                    for (size_t cell = first_; cell < last_; cell++)
+                    {
+                        solution_[cell] += alpha * direction_[cell];
+                        residual_[cell] -= alpha *   product_[cell];
+
+                        residualNorm += (double) residual_[cell] * residual_[cell];
+                    }
+
+                    const double nextRho = precondition(multigrid);
+
+                    const Real beta = nextRho / rho;
+
+                    rho = nextRho;
+
+                    for (size_t cell = first_; cell < last_; cell++)
+                    {
+                        direction_[cell] = preconditioned_[cell] + beta * direction_[cell];
+                    }
+                }
+
+                relativeResidual_ = (rhsNorm > 0)? sqrt(residualNorm / rhsNorm) : 0;
+
+                for (size_t cell = first_; cell < last_; cell++)
+                {
+                    if (diagonal_[cell] > 0) x[cell] = solution_[cell];
+                }
+
+            // Checking output:
+
+                assert(ok());
+
+                return iteration;
+        }
+
+        // Rows of cells that are not unknowns are zero, their vector entries are zero too:
+        template <typename Real>
+        double ConjugateGradient<Real>::apply(const Real* vector, Real* product) const
+        {
+            const size_t pitch = grid_.pitch;
+
+            double sum = 0;
+
+            for (size_t cell = first_; cell < last_; cell++)
+            {
+                Real neighbours = vector[cell - pitch] + vector[cell + pitch] + vector[cell - 1] + vector[cell + 1];
+
+                product[cell] = (diagonal_[cell] > 0)? diagonal_[cell] * vector[cell] - neighbours : 0;
+
+                sum += (double) vector[cell] * product[cell];
+            }
+
+            return sum;
+        }
+
+        template <typename Real>
+        double ConjugateGradient<Real>::precondition(Multigrid<Real>* multigrid)
+        {
+            if (multigrid != nullptr) multigrid->precondition(residual_, preconditioned_);
+
+            double rho = 0;
+
+            for (size_t cell = first_; cell < last_; cell++)
+            {
+                if (multigrid == nullptr) preconditioned_[cell] = residual_[cell] * inverseDiagonal_[cell];
+
+                rho += (double) residual_[cell] * preconditioned_[cell];
+            }
+
+            return rho;
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
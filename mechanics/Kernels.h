@@ -0,0 +1,1100 @@
+#pragma once
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+
+//----------------------------------------------------------------------------
+//{ Defines (typedefs)
+//----------------------------------------------------------------------------
+
+    // Updates count cells of one column: next = current + weight * laplacian(current) (+ correction * raw
+    // for the wider stencils, see stencilScalar()). current[-2], current[count + 1] and the neighbouring
+    // columns (+-pitch, +-2 pitch) must be readable.
+    template <typename Real>
+    using StencilKernel = void (*)(Real* next, const Real* current, const Real* weight, const Real* correction, const size_t pitch, const size_t count);
+
+    // Updates count cells of one column of a Volume with the 7-point stencil: its neighbouring columns
+    // along x (left, right) and z (front, back) come as pointers, so they may live anywhere in the layout:
+    template <typename Real>
+    using VolumeKernel = void (*)(Real* next, const Real* current, const Real* left, const Real* right, const Real* front, const Real* back, const Real* weight, const size_t count);
+
+    // Updates count cells of one interleaved column of an Ensemble, every cell being GRID_ALIGNMENT bytes
+    // of lanes, one per scenario: next = current + weight * scale * laplacian(current) lane by lane.
+    // weight has one value per cell, scales one per lane, and pitch counts cells:
+    template <typename Real>
+    using EnsembleKernel = void (*)(Real* next, const Real* current, const Real* weight, const Real* scales, const size_t pitch, const size_t count);
+
+    // Batched tridiagonal (Thomas) solves, see Adi.h; every cell of the count is one independent line:
+
+        // out = current + half * (current[-stride] + current[+stride] - 2 current), the explicit half of an ADI step:
+        template <typename Real>
+        using ExplicitHalfKernel = void (*)(Real* out, const Real* current, const Real* half, const size_t stride, const size_t count);
+
+        // Forward elimination: rhs = (rhs + half * previous) * factor:
+        template <typename Real>
+        using EliminationKernel = void (*)(Real* rhs, const Real* previous, const Real* half, const Real* factor, const size_t count);
+
+        // Back substitution: solution = solution - upper * next:
+        template <typename Real>
+        using SubstitutionKernel = void (*)(Real* solution, const Real* next, const Real* upper, const size_t count);
+
+    #define TARGET_AVX2   __attribute__((target("avx2,fma")))
+    #define TARGET_AVX512 __attribute__((target("avx512f")))
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // Instruction set paths:
+
+        const unsigned char ISA_SCALAR = 0,
+                            ISA_AVX2   = 1,
+                            ISA_AVX512 = 2;
+
+    // Stencil shapes (see Field::setStencil()):
+
+        const unsigned char STENCIL_5_POINT   = 0,
+                            STENCIL_9_POINT   = 1,
+                            STENCIL_4TH_ORDER = 2;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Stencil kernels
+//----------------------------------------------------------------------------
+
+    // Every path computes each cell with the same instructions wherever the column starts
+    // (vector tails are masked, not scalar), so results never depend on how a sweep is split.
+    //
+    // The shape is a template parameter, so every shape is a kernel of its own without branches.
+    // All of them start from the 5-point Laplacian L5 and add correction * raw:
+    //     STENCIL_9_POINT:   raw = diagonals - 4 center - 2 L5, correction = weight / 6,
+    //                        the isotropic (4 sides + diagonals - 20 center) / 6;
+    //     STENCIL_4TH_ORDER: raw = 4 L5 + 4 center - cells two away, correction = weight / 12,
+    //                        the fourth order (16 sides - cells two away - 60 center) / 12.
+    // The 5-point kernel never reads correction and computes exactly what it always did.
+
+    template <typename Real, unsigned char Shape>
+    void stencilScalar(Real* next, const Real* current, const Real* weight, const Real* correction, const size_t pitch, const size_t count)
+    {
+        const Real* left  = current - pitch;
+        const Real* right = current + pitch;
+
+        for (size_t y = 0; y < count; y++)
+        {
+            Real laplacian  = left[y];
+                 laplacian += right[y];
+
+                 laplacian += -4 * current[y];
+
+                 laplacian += current[y - 1];
+                 laplacian += current[y + 1];
+
+            if (Shape == STENCIL_5_POINT)
+            {
+                next[y] = current[y] + weight[y] * laplacian;
+
+                continue;
+            }
+
+            Real raw = 0;
+
+            if (Shape == STENCIL_9_POINT)
+            {
+                raw  = left [y - 1];
+                raw += left [y + 1];
+                raw += right[y - 1];
+                raw += right[y + 1];
+
+                raw += -4 * current[y];
+                raw += -2 * laplacian;
+            }
+
+            if (Shape == STENCIL_4TH_ORDER)
+            {
+                raw  = -current[y - 2 * pitch];
+                raw -=  current[y + 2 * pitch];
+                raw -=  current[y - 2];
+                raw -=  current[y + 2];
+
+                raw += 4 * current[y];
+                raw += 4 * laplacian;
+            }
+
+            next[y] = current[y] + weight[y] * laplacian + correction[y] * raw;
+        }
+    }
+
+    // The correction of the shape on top of center + weight * laplacian (masked lanes read nothing):
+
+        template <unsigned char Shape>
+        TARGET_AVX2 inline __m256d stencilAvx2Correction(const double* current, const double* correction, const size_t pitch, const size_t y,
+                                                         const __m256i mask, const __m256d center, const __m256d laplacian, const __m256d next)
+        {
+            const __m256d two  = _mm256_set1_pd(2.0);
+            const __m256d four = _mm256_set1_pd(4.0);
+
+            __m256d raw;
+
+            if (Shape == STENCIL_9_POINT)
+            {
+                raw = _mm256_add_pd(_mm256_maskload_pd(current + y - pitch - 1, mask), _mm256_maskload_pd(current + y - pitch + 1, mask));
+                raw = _mm256_add_pd(raw, _mm256_maskload_pd(current + y + pitch - 1, mask));
+                raw = _mm256_add_pd(raw, _mm256_maskload_pd(current + y + pitch + 1, mask));
+
+                raw = _mm256_fnmadd_pd(four, center,    raw);
+                raw = _mm256_fnmadd_pd(two,  laplacian, raw);
+            }
+            else
+            {
+                raw = _mm256_add_pd(_mm256_maskload_pd(current + y - 2 * pitch, mask), _mm256_maskload_pd(current + y + 2 * pitch, mask));
+                raw = _mm256_add_pd(raw, _mm256_maskload_pd(current + y - 2, mask));
+                raw = _mm256_add_pd(raw, _mm256_maskload_pd(current + y + 2, mask));
+
+                raw = _mm256_fmsub_pd(four, center,    raw);
+                raw = _mm256_fmadd_pd(four, laplacian, raw);
+            }
+
+            return _mm256_fmadd_pd(_mm256_maskload_pd(correction + y, mask), raw, next);
+        }
+
+        template <unsigned char Shape>
+        TARGET_AVX2 inline __m256 stencilAvx2Correction(const float* current, const float* correction, const size_t pitch, const size_t y,
+                                                        const __m256i mask, const __m256 center, const __m256 laplacian, const __m256 next)
+        {
+            const __m256 two  = _mm256_set1_ps(2.0f);
+            const __m256 four = _mm256_set1_ps(4.0f);
+
+            __m256 raw;
+
+            if (Shape == STENCIL_9_POINT)
+            {
+                raw = _mm256_add_ps(_mm256_maskload_ps(current + y - pitch - 1, mask), _mm256_maskload_ps(current + y - pitch + 1, mask));
+                raw = _mm256_add_ps(raw, _mm256_maskload_ps(current + y + pitch - 1, mask));
+                raw = _mm256_add_ps(raw, _mm256_maskload_ps(current + y + pitch + 1, mask));
+
+                raw = _mm256_fnmadd_ps(four, center,    raw);
+                raw = _mm256_fnmadd_ps(two,  laplacian, raw);
+            }
+            else
+            {
+                raw = _mm256_add_ps(_mm256_maskload_ps(current + y - 2 * pitch, mask), _mm256_maskload_ps(current + y + 2 * pitch, mask));
+                raw = _mm256_add_ps(raw, _mm256_maskload_ps(current + y - 2, mask));
+                raw = _mm256_add_ps(raw, _mm256_maskload_ps(current + y + 2, mask));
+
+                raw = _mm256_fmsub_ps(four, center,    raw);
+                raw = _mm256_fmadd_ps(four, laplacian, raw);
+            }
+
+            return _mm256_fmadd_ps(_mm256_maskload_ps(correction + y, mask), raw, next);
+        }
+
+        template <unsigned char Shape>
+        TARGET_AVX512 inline __m512d stencilAvx512Correction(const double* current, const double* correction, const size_t pitch, const size_t y,
+                                                             const __mmask8 mask, const __m512d center, const __m512d laplacian, const __m512d next)
+        {
+            const __m512d two  = _mm512_set1_pd(2.0);
+            const __m512d four = _mm512_set1_pd(4.0);
+
+            __m512d raw;
+
+            if (Shape == STENCIL_9_POINT)
+            {
+                raw = _mm512_add_pd(_mm512_maskz_loadu_pd(mask, current + y - pitch - 1), _mm512_maskz_loadu_pd(mask, current + y - pitch + 1));
+                raw = _mm512_add_pd(raw, _mm512_maskz_loadu_pd(mask, current + y + pitch - 1));
+                raw = _mm512_add_pd(raw, _mm512_maskz_loadu_pd(mask, current + y + pitch + 1));
+
+                raw = _mm512_fnmadd_pd(four, center,    raw);
+                raw = _mm512_fnmadd_pd(two,  laplacian, raw);
+            }
+            else
+            {
+                raw = _mm512_add_pd(_mm512_maskz_loadu_pd(mask, current + y - 2 * pitch), _mm512_maskz_loadu_pd(mask, current + y + 2 * pitch));
+                raw = _mm512_add_pd(raw, _mm512_maskz_loadu_pd(mask, current + y - 2));
+                raw = _mm512_add_pd(raw, _mm512_maskz_loadu_pd(mask, current + y + 2));
+
+                raw = _mm512_fmsub_pd(four, center,    raw);
+                raw = _mm512_fmadd_pd(four, laplacian, raw);
+            }
+
+            return _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, correction + y), raw, next);
+        }
+
+        template <unsigned char Shape>
+        TARGET_AVX512 inline __m512 stencilAvx512Correction(const float* current, const float* correction, const size_t pitch, const size_t y,
+                                                            const __mmask16 mask, const __m512 center, const __m512 laplacian, const __m512 next)
+        {
+            const __m512 two  = _mm512_set1_ps(2.0f);
+            const __m512 four = _mm512_set1_ps(4.0f);
+
+            __m512 raw;
+
+            if (Shape == STENCIL_9_POINT)
+            {
+                raw = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, current + y - pitch - 1), _mm512_maskz_loadu_ps(mask, current + y - pitch + 1));
+                raw = _mm512_add_ps(raw, _mm512_maskz_loadu_ps(mask, current + y + pitch - 1));
+                raw = _mm512_add_ps(raw, _mm512_maskz_loadu_ps(mask, current + y + pitch + 1));
+
+                raw = _mm512_fnmadd_ps(four, center,    raw);
+                raw = _mm512_fnmadd_ps(two,  laplacian, raw);
+            }
+            else
+            {
+                raw = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, current + y - 2 * pitch), _mm512_maskz_loadu_ps(mask, current + y + 2 * pitch));
+                raw = _mm512_add_ps(raw, _mm512_maskz_loadu_ps(mask, current + y - 2));
+                raw = _mm512_add_ps(raw, _mm512_maskz_loadu_ps(mask, current + y + 2));
+
+                raw = _mm512_fmsub_ps(four, center,    raw);
+                raw = _mm512_fmadd_ps(four, laplacian, raw);
+            }
+
+            return _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, correction + y), raw, next);
+        }
+
+    template <unsigned char Shape>
+    TARGET_AVX2 inline __m256d stencilAvx2Lanes(const double* current, const double* weight, const double* correction, const size_t pitch, const size_t y, const __m256i mask)
+    {
+        const __m256d four = _mm256_set1_pd(4.0);
+
+        __m256d center    = _mm256_maskload_pd(current + y, mask);
+        __m256d laplacian = _mm256_add_pd(_mm256_maskload_pd(current + y - pitch, mask),
+                                          _mm256_maskload_pd(current + y + pitch, mask));
+
+                laplacian = _mm256_fnmadd_pd(four, center, laplacian);
+                laplacian = _mm256_add_pd(laplacian, _mm256_maskload_pd(current + y - 1, mask));
+                laplacian = _mm256_add_pd(laplacian, _mm256_maskload_pd(current + y + 1, mask));
+
+        __m256d next = _mm256_fmadd_pd(_mm256_maskload_pd(weight + y, mask), laplacian, center);
+
+        return (Shape == STENCIL_5_POINT)? next : stencilAvx2Correction<Shape>(current, correction, pitch, y, mask, center, laplacian, next);
+    }
+
+    template <unsigned char Shape>
+    TARGET_AVX2 void stencilAvx2(double* next, const double* current, const double* weight, const double* correction, const size_t pitch, const size_t count)
+    {
+        const __m256i all = _mm256_set1_epi64x(-1);
+
+        size_t y = 0;
+
+        for (; y + 4 <= count; y += 4)
+        {
+            _mm256_storeu_pd(next + y, stencilAvx2Lanes<Shape>(current, weight, correction, pitch, y, all));
+        }
+
+        if (y < count)
+        {
+            const long long rest = count - y;
+            const __m256i tail = _mm256_cmpgt_epi64(_mm256_set1_epi64x(rest), _mm256_setr_epi64x(0, 1, 2, 3));
+
+            _mm256_maskstore_pd(next + y, tail, stencilAvx2Lanes<Shape>(current, weight, correction, pitch, y, tail));
+        }
+    }
+
+    template <unsigned char Shape>
+    TARGET_AVX2 inline __m256 stencilAvx2Lanes(const float* current, const float* weight, const float* correction, const size_t pitch, const size_t y, const __m256i mask)
+    {
+        const __m256 four = _mm256_set1_ps(4.0f);
+
+        __m256 center    = _mm256_maskload_ps(current + y, mask);
+        __m256 laplacian = _mm256_add_ps(_mm256_maskload_ps(current + y - pitch, mask),
+                                         _mm256_maskload_ps(current + y + pitch, mask));
+
+               laplacian = _mm256_fnmadd_ps(four, center, laplacian);
+               laplacian = _mm256_add_ps(laplacian, _mm256_maskload_ps(current + y - 1, mask));
+               laplacian = _mm256_add_ps(laplacian, _mm256_maskload_ps(current + y + 1, mask));
+
+        __m256 next = _mm256_fmadd_ps(_mm256_maskload_ps(weight + y, mask), laplacian, center);
+
+        return (Shape == STENCIL_5_POINT)? next : stencilAvx2Correction<Shape>(current, correction, pitch, y, mask, center, laplacian, next);
+    }
+
+    template <unsigned char Shape>
+    TARGET_AVX2 void stencilAvx2(float* next, const float* current, const float* weight, const float* correction, const size_t pitch, const size_t count)
+    {
+        const __m256i all = _mm256_set1_epi32(-1);
+
+        size_t y = 0;
+
+        for (; y + 8 <= count; y += 8)
+        {
+            _mm256_storeu_ps(next + y, stencilAvx2Lanes<Shape>(current, weight, correction, pitch, y, all));
+        }
+
+        if (y < count)
+        {
+            const int rest = count - y;
+            const __m256i tail = _mm256_cmpgt_epi32(_mm256_set1_epi32(rest), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+            _mm256_maskstore_ps(next + y, tail, stencilAvx2Lanes<Shape>(current, weight, correction, pitch, y, tail));
+        }
+    }
+
+    template <unsigned char Shape>
+    TARGET_AVX512 inline __m512d stencilAvx512Lanes(const double* current, const double* weight, const double* correction, const size_t pitch, const size_t y, const __mmask8 mask)
+    {
+        const __m512d four = _mm512_set1_pd(4.0);
+
+        __m512d center    = _mm512_maskz_loadu_pd(mask, current + y);
+        __m512d laplacian = _mm512_add_pd(_mm512_maskz_loadu_pd(mask, current + y - pitch),
+                                          _mm512_maskz_loadu_pd(mask, current + y + pitch));
+
+                laplacian = _mm512_fnmadd_pd(four, center, laplacian);
+                laplacian = _mm512_add_pd(laplacian, _mm512_maskz_loadu_pd(mask, current + y - 1));
+                laplacian = _mm512_add_pd(laplacian, _mm512_maskz_loadu_pd(mask, current + y + 1));
+
+        __m512d next = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, weight + y), laplacian, center);
+
+        return (Shape == STENCIL_5_POINT)? next : stencilAvx512Correction<Shape>(current, correction, pitch, y, mask, center, laplacian, next);
+    }
+
+    template <unsigned char Shape>
+    TARGET_AVX512 void stencilAvx512(double* next, const double* current, const double* weight, const double* correction, const size_t pitch, const size_t count)
+    {
+        size_t y = 0;
+
+        for (; y + 8 <= count; y += 8)
+        {
+            _mm512_storeu_pd(next + y, stencilAvx512Lanes<Shape>(current, weight, correction, pitch, y, 0xFF));
+        }
+
+        if (y < count)
+        {
+            const __mmask8 tail = (__mmask8) ((1u << (count - y)) - 1);
+
+            _mm512_mask_storeu_pd(next + y, tail, stencilAvx512Lanes<Shape>(current, weight, correction, pitch, y, tail));
+        }
+    }
+
+    template <unsigned char Shape>
+    TARGET_AVX512 inline __m512 stencilAvx512Lanes(const float* current, const float* weight, const float* correction, const size_t pitch, const size_t y, const __mmask16 mask)
+    {
+        const __m512 four = _mm512_set1_ps(4.0f);
+
+        __m512 center    = _mm512_maskz_loadu_ps(mask, current + y);
+        __m512 laplacian = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, current + y - pitch),
+                                         _mm512_maskz_loadu_ps(mask, current + y + pitch));
+
+               laplacian = _mm512_fnmadd_ps(four, center, laplacian);
+               laplacian = _mm512_add_ps(laplacian, _mm512_maskz_loadu_ps(mask, current + y - 1));
+               laplacian = _mm512_add_ps(laplacian, _mm512_maskz_loadu_ps(mask, current + y + 1));
+
+        __m512 next = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, weight + y), laplacian, center);
+
+        return (Shape == STENCIL_5_POINT)? next : stencilAvx512Correction<Shape>(current, correction, pitch, y, mask, center, laplacian, next);
+    }
+
+    template <unsigned char Shape>
+    TARGET_AVX512 void stencilAvx512(float* next, const float* current, const float* weight, const float* correction, const size_t pitch, const size_t count)
+    {
+        size_t y = 0;
+
+        for (; y + 16 <= count; y += 16)
+        {
+            _mm512_storeu_ps(next + y, stencilAvx512Lanes<Shape>(current, weight, correction, pitch, y, 0xFFFF));
+        }
+
+        if (y < count)
+        {
+            const __mmask16 tail = (__mmask16) ((1u << (count - y)) - 1);
+
+            _mm512_mask_storeu_ps(next + y, tail, stencilAvx512Lanes<Shape>(current, weight, correction, pitch, y, tail));
+        }
+    }
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Volume kernels
+//----------------------------------------------------------------------------
+
+    // The 5-point kernels plus the columns in front and behind, with masked tails like them:
+    //     next = current + weight * (left + right + front + back - 6 current + up + down).
+
+    template <typename Real>
+    void volumeScalar(Real* next, const Real* current, const Real* left, const Real* right, const Real* front, const Real* back, const Real* weight, const size_t count)
+    {
+        for (size_t y = 0; y < count; y++)
+        {
+            Real laplacian  = left [y];
+                 laplacian += right[y];
+                 laplacian += front[y];
+                 laplacian += back [y];
+
+                 laplacian += -6 * current[y];
+
+                 laplacian += current[y - 1];
+                 laplacian += current[y + 1];
+
+            next[y] = current[y] + weight[y] * laplacian;
+        }
+    }
+
+    TARGET_AVX2 inline __m256d volumeAvx2Lanes(const double* current, const double* left, const double* right, const double* front, const double* back,
+                                               const double* weight, const size_t y, const __m256i mask)
+    {
+        const __m256d six = _mm256_set1_pd(6.0);
+
+        __m256d center    = _mm256_maskload_pd(current + y, mask);
+        __m256d laplacian = _mm256_add_pd(_mm256_maskload_pd(left + y, mask), _mm256_maskload_pd(right + y, mask));
+
+                laplacian = _mm256_add_pd(laplacian, _mm256_maskload_pd(front + y, mask));
+                laplacian = _mm256_add_pd(laplacian, _mm256_maskload_pd(back  + y, mask));
+                laplacian = _mm256_fnmadd_pd(six, center, laplacian);
+                laplacian = _mm256_add_pd(laplacian, _mm256_maskload_pd(current + y - 1, mask));
+                laplacian = _mm256_add_pd(laplacian, _mm256_maskload_pd(current + y + 1, mask));
+
+        return _mm256_fmadd_pd(_mm256_maskload_pd(weight + y, mask), laplacian, center);
+    }
+
+    TARGET_AVX2 void volumeAvx2(double* next, const double* current, const double* left, const double* right, const double* front, const double* back, const double* weight, const size_t count)
+    {
+        const __m256i all = _mm256_set1_epi64x(-1);
+
+        size_t y = 0;
+
+        for (; y + 4 <= count; y += 4)
+        {
+            _mm256_storeu_pd(next + y, volumeAvx2Lanes(current, left, right, front, back, weight, y, all));
+        }
+
+        if (y < count)
+        {
+            const long long rest = count - y;
+            const __m256i tail = _mm256_cmpgt_epi64(_mm256_set1_epi64x(rest), _mm256_setr_epi64x(0, 1, 2, 3));
+
+            _mm256_maskstore_pd(next + y, tail, volumeAvx2Lanes(current, left, right, front, back, weight, y, tail));
+        }
+    }
+
+    TARGET_AVX2 inline __m256 volumeAvx2Lanes(const float* current, const float* left, const float* right, const float* front, const float* back,
+                                              const float* weight, const size_t y, const __m256i mask)
+    {
+        const __m256 six = _mm256_set1_ps(6.0f);
+
+        __m256 center    = _mm256_maskload_ps(current + y, mask);
+        __m256 laplacian = _mm256_add_ps(_mm256_maskload_ps(left + y, mask), _mm256_maskload_ps(right + y, mask));
+
+               laplacian = _mm256_add_ps(laplacian, _mm256_maskload_ps(front + y, mask));
+               laplacian = _mm256_add_ps(laplacian, _mm256_maskload_ps(back  + y, mask));
+               laplacian = _mm256_fnmadd_ps(six, center, laplacian);
+               laplacian = _mm256_add_ps(laplacian, _mm256_maskload_ps(current + y - 1, mask));
+               laplacian = _mm256_add_ps(laplacian, _mm256_maskload_ps(current + y + 1, mask));
+
+        return _mm256_fmadd_ps(_mm256_maskload_ps(weight + y, mask), laplacian, center);
+    }
+
+    TARGET_AVX2 void volumeAvx2(float* next, const float* current, const float* left, const float* right, const float* front, const float* back, const float* weight, const size_t count)
+    {
+        const __m256i all = _mm256_set1_epi32(-1);
+
+        size_t y = 0;
+
+        for (; y + 8 <= count; y += 8)
+        {
+            _mm256_storeu_ps(next + y, volumeAvx2Lanes(current, left, right, front, back, weight, y, all));
+        }
+
+        if (y < count)
+        {
+            const int rest = count - y;
+            const __m256i tail = _mm256_cmpgt_epi32(_mm256_set1_epi32(rest), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+            _mm256_maskstore_ps(next + y, tail, volumeAvx2Lanes(current, left, right, front, back, weight, y, tail));
+        }
+    }
+
+    TARGET_AVX512 inline __m512d volumeAvx512Lanes(const double* current, const double* left, const double* right, const double* front, const double* back,
+                                                   const double* weight, const size_t y, const __mmask8 mask)
+    {
+        const __m512d six = _mm512_set1_pd(6.0);
+
+        __m512d center    = _mm512_maskz_loadu_pd(mask, current + y);
+        __m512d laplacian = _mm512_add_pd(_mm512_maskz_loadu_pd(mask, left + y), _mm512_maskz_loadu_pd(mask, right + y));
+
+                laplacian = _mm512_add_pd(laplacian, _mm512_maskz_loadu_pd(mask, front + y));
+                laplacian = _mm512_add_pd(laplacian, _mm512_maskz_loadu_pd(mask, back  + y));
+                laplacian = _mm512_fnmadd_pd(six, center, laplacian);
+                laplacian = _mm512_add_pd(laplacian, _mm512_maskz_loadu_pd(mask, current + y - 1));
+                laplacian = _mm512_add_pd(laplacian, _mm512_maskz_loadu_pd(mask, current + y + 1));
+
+        return _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, weight + y), laplacian, center);
+    }
+
+    TARGET_AVX512 void volumeAvx512(double* next, const double* current, const double* left, const double* right, const double* front, const double* back, const double* weight, const size_t count)
+    {
+        size_t y = 0;
+
+        for (; y + 8 <= count; y += 8)
+        {
+            _mm512_storeu_pd(next + y, volumeAvx512Lanes(current, left, right, front, back, weight, y, 0xFF));
+        }
+
+        if (y < count)
+        {
+            const __mmask8 tail = (__mmask8) ((1u << (count - y)) - 1);
+
+            _mm512_mask_storeu_pd(next + y, tail, volumeAvx512Lanes(current, left, right, front, back, weight, y, tail));
+        }
+    }
+
+    TARGET_AVX512 inline __m512 volumeAvx512Lanes(const float* current, const float* left, const float* right, const float* front, const float* back,
+                                                  const float* weight, const size_t y, const __mmask16 mask)
+    {
+        const __m512 six = _mm512_set1_ps(6.0f);
+
+        __m512 center    = _mm512_maskz_loadu_ps(mask, current + y);
+        __m512 laplacian = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, left + y), _mm512_maskz_loadu_ps(mask, right + y));
+
+               laplacian = _mm512_add_ps(laplacian, _mm512_maskz_loadu_ps(mask, front + y));
+               laplacian = _mm512_add_ps(laplacian, _mm512_maskz_loadu_ps(mask, back  + y));
+               laplacian = _mm512_fnmadd_ps(six, center, laplacian);
+               laplacian = _mm512_add_ps(laplacian, _mm512_maskz_loadu_ps(mask, current + y - 1));
+               laplacian = _mm512_add_ps(laplacian, _mm512_maskz_loadu_ps(mask, current + y + 1));
+
+        return _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, weight + y), laplacian, center);
+    }
+
+    TARGET_AVX512 void volumeAvx512(float* next, const float* current, const float* left, const float* right, const float* front, const float* back, const float* weight, const size_t count)
+    {
+        size_t y = 0;
+
+        for (; y + 16 <= count; y += 16)
+        {
+            _mm512_storeu_ps(next + y, volumeAvx512Lanes(current, left, right, front, back, weight, y, 0xFFFF));
+        }
+
+        if (y < count)
+        {
+            const __mmask16 tail = (__mmask16) ((1u << (count - y)) - 1);
+
+            _mm512_mask_storeu_ps(next + y, tail, volumeAvx512Lanes(current, left, right, front, back, weight, y, tail));
+        }
+    }
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Ensemble kernels
+//----------------------------------------------------------------------------
+
+    // A cell's lanes fill one cache line, a whole register for AVX512 and two for AVX2, so there are
+    // no tails. Each lane sees the operations of the stencil kernel of the same path, and a lane with
+    // scale 1 is bit-identical to a Field on that path.
+
+    template <typename Real>
+    void ensembleScalar(Real* next, const Real* current, const Real* weight, const Real* scales, const size_t pitch, const size_t count)
+    {
+        const size_t lanes = GRID_ALIGNMENT / sizeof(Real);
+        const size_t side  = pitch * lanes;
+
+        for (size_t y = 0; y < count; y++)
+        {
+            for (size_t lane = 0; lane < lanes; lane++)
+            {
+                const size_t cell = y * lanes + lane;
+
+                Real laplacian  = current[cell - side];
+                     laplacian += current[cell + side];
+
+                     laplacian += -4 * current[cell];
+
+                     laplacian += current[cell - lanes];
+                     laplacian += current[cell + lanes];
+
+                next[cell] = current[cell] + (weight[y] * scales[lane]) * laplacian;
+            }
+        }
+    }
+
+    TARGET_AVX2 void ensembleAvx2(double* next, const double* current, const double* weight, const double* scales, const size_t pitch, const size_t count)
+    {
+        const size_t lanes = GRID_ALIGNMENT / sizeof(double);
+        const size_t side  = pitch * lanes;
+
+        const __m256d four = _mm256_set1_pd(4.0);
+
+        for (size_t y = 0; y < count; y++)
+        {
+            const __m256d cellWeight = _mm256_set1_pd(weight[y]);
+
+            for (size_t half = 0; half < lanes; half += 4)
+            {
+                const size_t cell = y * lanes + half;
+
+                __m256d center    = _mm256_load_pd(current + cell);
+                __m256d laplacian = _mm256_add_pd(_mm256_load_pd(current + cell - side), _mm256_load_pd(current + cell + side));
+
+                        laplacian = _mm256_fnmadd_pd(four, center, laplacian);
+                        laplacian = _mm256_add_pd(laplacian, _mm256_load_pd(current + cell - lanes));
+                        laplacian = _mm256_add_pd(laplacian, _mm256_load_pd(current + cell + lanes));
+
+                const __m256d laneWeight = _mm256_mul_pd(cellWeight, _mm256_load_pd(scales + half));
+
+                _mm256_store_pd(next + cell, _mm256_fmadd_pd(laneWeight, laplacian, center));
+            }
+        }
+    }
+
+    TARGET_AVX2 void ensembleAvx2(float* next, const float* current, const float* weight, const float* scales, const size_t pitch, const size_t count)
+    {
+        const size_t lanes = GRID_ALIGNMENT / sizeof(float);
+        const size_t side  = pitch * lanes;
+
+        const __m256 four = _mm256_set1_ps(4.0f);
+
+        for (size_t y = 0; y < count; y++)
+        {
+            const __m256 cellWeight = _mm256_set1_ps(weight[y]);
+
+            for (size_t half = 0; half < lanes; half += 8)
+            {
+                const size_t cell = y * lanes + half;
+
+                __m256 center    = _mm256_load_ps(current + cell);
+                __m256 laplacian = _mm256_add_ps(_mm256_load_ps(current + cell - side), _mm256_load_ps(current + cell + side));
+
+                       laplacian = _mm256_fnmadd_ps(four, center, laplacian);
+                       laplacian = _mm256_add_ps(laplacian, _mm256_load_ps(current + cell - lanes));
+                       laplacian = _mm256_add_ps(laplacian, _mm256_load_ps(current + cell + lanes));
+
+                const __m256 laneWeight = _mm256_mul_ps(cellWeight, _mm256_load_ps(scales + half));
+
+                _mm256_store_ps(next + cell, _mm256_fmadd_ps(laneWeight, laplacian, center));
+            }
+        }
+    }
+
+    TARGET_AVX512 void ensembleAvx512(double* next, const double* current, const double* weight, const double* scales, const size_t pitch, const size_t count)
+    {
+        const size_t lanes = GRID_ALIGNMENT / sizeof(double);
+        const size_t side  = pitch * lanes;
+
+        const __m512d four  = _mm512_set1_pd(4.0);
+        const __m512d scale = _mm512_load_pd(scales);
+
+        for (size_t y = 0; y < count; y++)
+        {
+            const size_t cell = y * lanes;
+
+            __m512d center    = _mm512_load_pd(current + cell);
+            __m512d laplacian = _mm512_add_pd(_mm512_load_pd(current + cell - side), _mm512_load_pd(current + cell + side));
+
+                    laplacian = _mm512_fnmadd_pd(four, center, laplacian);
+                    laplacian = _mm512_add_pd(laplacian, _mm512_load_pd(current + cell - lanes));
+                    laplacian = _mm512_add_pd(laplacian, _mm512_load_pd(current + cell + lanes));
+
+            const __m512d laneWeight = _mm512_mul_pd(_mm512_set1_pd(weight[y]), scale);
+
+            _mm512_store_pd(next + cell, _mm512_fmadd_pd(laneWeight, laplacian, center));
+        }
+    }
+
+    TARGET_AVX512 void ensembleAvx512(float* next, const float* current, const float* weight, const float* scales, const size_t pitch, const size_t count)
+    {
+        const size_t lanes = GRID_ALIGNMENT / sizeof(float);
+        const size_t side  = pitch * lanes;
+
+        const __m512 four  = _mm512_set1_ps(4.0f);
+        const __m512 scale = _mm512_load_ps(scales);
+
+        for (size_t y = 0; y < count; y++)
+        {
+            const size_t cell = y * lanes;
+
+            __m512 center    = _mm512_load_ps(current + cell);
+            __m512 laplacian = _mm512_add_ps(_mm512_load_ps(current + cell - side), _mm512_load_ps(current + cell + side));
+
+                   laplacian = _mm512_fnmadd_ps(four, center, laplacian);
+                   laplacian = _mm512_add_ps(laplacian, _mm512_load_ps(current + cell - lanes));
+                   laplacian = _mm512_add_ps(laplacian, _mm512_load_ps(current + cell + lanes));
+
+            const __m512 laneWeight = _mm512_mul_ps(_mm512_set1_ps(weight[y]), scale);
+
+            _mm512_store_ps(next + cell, _mm512_fmadd_ps(laneWeight, laplacian, center));
+        }
+    }
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Tridiagonal kernels
+//----------------------------------------------------------------------------
+
+    // Same rules as the stencils: masked tails, so a line gives the same result in any batch.
+
+    template <typename Real>
+    void explicitHalfScalar(Real* out, const Real* current, const Real* half, const size_t stride, const size_t count)
+    {
+        for (size_t cell = 0; cell < count; cell++)
+        {
+            Real difference = current[cell - stride] + current[cell + stride];
+                 difference += -2 * current[cell];
+
+            out[cell] = current[cell] + half[cell] * difference;
+        }
+    }
+
+    template <typename Real>
+    void eliminationScalar(Real* rhs, const Real* previous, const Real* half, const Real* factor, const size_t count)
+    {
+        for (size_t cell = 0; cell < count; cell++)
+        {
+            rhs[cell] = (rhs[cell] + half[cell] * previous[cell]) * factor[cell];
+        }
+    }
+
+    template <typename Real>
+    void substitutionScalar(Real* solution, const Real* next, const Real* upper, const size_t count)
+    {
+        for (size_t cell = 0; cell < count; cell++)
+        {
+            solution[cell] = solution[cell] - upper[cell] * next[cell];
+        }
+    }
+
+    // AVX2:
+
+        TARGET_AVX2 inline __m256i tailAvx2(const double*, const size_t rest)
+        {
+            return _mm256_cmpgt_epi64(_mm256_set1_epi64x(rest), _mm256_setr_epi64x(0, 1, 2, 3));
+        }
+
+        TARGET_AVX2 inline __m256i tailAvx2(const float*, const size_t rest)
+        {
+            return _mm256_cmpgt_epi32(_mm256_set1_epi32(rest), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        }
+
+        TARGET_AVX2 void explicitHalfAvx2(double* out, const double* current, const double* half, const size_t stride, const size_t count)
+        {
+            const __m256d two = _mm256_set1_pd(2.0);
+
+            for (size_t cell = 0; cell < count; cell += 4)
+            {
+                const __m256i mask = (cell + 4 <= count)? _mm256_set1_epi64x(-1) : tailAvx2(out, count - cell);
+
+                __m256d center     = _mm256_maskload_pd(current + cell, mask);
+                __m256d difference = _mm256_add_pd(_mm256_maskload_pd(current + cell - stride, mask),
+                                                   _mm256_maskload_pd(current + cell + stride, mask));
+
+                        difference = _mm256_fnmadd_pd(two, center, difference);
+
+                _mm256_maskstore_pd(out + cell, mask, _mm256_fmadd_pd(_mm256_maskload_pd(half + cell, mask), difference, center));
+            }
+        }
+
+        TARGET_AVX2 void explicitHalfAvx2(float* out, const float* current, const float* half, const size_t stride, const size_t count)
+        {
+            const __m256 two = _mm256_set1_ps(2.0f);
+
+            for (size_t cell = 0; cell < count; cell += 8)
+            {
+                const __m256i mask = (cell + 8 <= count)? _mm256_set1_epi32(-1) : tailAvx2(out, count - cell);
+
+                __m256 center     = _mm256_maskload_ps(current + cell, mask);
+                __m256 difference = _mm256_add_ps(_mm256_maskload_ps(current + cell - stride, mask),
+                                                  _mm256_maskload_ps(current + cell + stride, mask));
+
+                       difference = _mm256_fnmadd_ps(two, center, difference);
+
+                _mm256_maskstore_ps(out + cell, mask, _mm256_fmadd_ps(_mm256_maskload_ps(half + cell, mask), difference, center));
+            }
+        }
+
+        TARGET_AVX2 void eliminationAvx2(double* rhs, const double* previous, const double* half, const double* factor, const size_t count)
+        {
+            for (size_t cell = 0; cell < count; cell += 4)
+            {
+                const __m256i mask = (cell + 4 <= count)? _mm256_set1_epi64x(-1) : tailAvx2(rhs, count - cell);
+
+                __m256d sum = _mm256_fmadd_pd(_mm256_maskload_pd(half + cell, mask), _mm256_maskload_pd(previous + cell, mask), _mm256_maskload_pd(rhs + cell, mask));
+
+                _mm256_maskstore_pd(rhs + cell, mask, _mm256_mul_pd(sum, _mm256_maskload_pd(factor + cell, mask)));
+            }
+        }
+
+        TARGET_AVX2 void eliminationAvx2(float* rhs, const float* previous, const float* half, const float* factor, const size_t count)
+        {
+            for (size_t cell = 0; cell < count; cell += 8)
+            {
+                const __m256i mask = (cell + 8 <= count)? _mm256_set1_epi32(-1) : tailAvx2(rhs, count - cell);
+
+                __m256 sum = _mm256_fmadd_ps(_mm256_maskload_ps(half + cell, mask), _mm256_maskload_ps(previous + cell, mask), _mm256_maskload_ps(rhs + cell, mask));
+
+                _mm256_maskstore_ps(rhs + cell, mask, _mm256_mul_ps(sum, _mm256_maskload_ps(factor + cell, mask)));
+            }
+        }
+
+        TARGET_AVX2 void substitutionAvx2(double* solution, const double* next, const double* upper, const size_t count)
+        {
+            for (size_t cell = 0; cell < count; cell += 4)
+            {
+                const __m256i mask = (cell + 4 <= count)? _mm256_set1_epi64x(-1) : tailAvx2(solution, count - cell);
+
+                _mm256_maskstore_pd(solution + cell, mask, _mm256_fnmadd_pd(_mm256_maskload_pd(upper + cell, mask), _mm256_maskload_pd(next + cell, mask),
+                                                                            _mm256_maskload_pd(solution + cell, mask)));
+            }
+        }
+
+        TARGET_AVX2 void substitutionAvx2(float* solution, const float* next, const float* upper, const size_t count)
+        {
+            for (size_t cell = 0; cell < count; cell += 8)
+            {
+                const __m256i mask = (cell + 8 <= count)? _mm256_set1_epi32(-1) : tailAvx2(solution, count - cell);
+
+                _mm256_maskstore_ps(solution + cell, mask, _mm256_fnmadd_ps(_mm256_maskload_ps(upper + cell, mask), _mm256_maskload_ps(next + cell, mask),
+                                                                            _mm256_maskload_ps(solution + cell, mask)));
+            }
+        }
+
+    // AVX-512:
+
+        TARGET_AVX512 void explicitHalfAvx512(double* out, const double* current, const double* half, const size_t stride, const size_t count)
+        {
+            const __m512d two = _mm512_set1_pd(2.0);
+
+            for (size_t cell = 0; cell < count; cell += 8)
+            {
+                const __mmask8 mask = (cell + 8 <= count)? 0xFF : (__mmask8) ((1u << (count - cell)) - 1);
+
+                __m512d center     = _mm512_maskz_loadu_pd(mask, current + cell);
+                __m512d difference = _mm512_add_pd(_mm512_maskz_loadu_pd(mask, current + cell - stride),
+                                                   _mm512_maskz_loadu_pd(mask, current + cell + stride));
+
+                        difference = _mm512_fnmadd_pd(two, center, difference);
+
+                _mm512_mask_storeu_pd(out + cell, mask, _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, half + cell), difference, center));
+            }
+        }
+
+        TARGET_AVX512 void explicitHalfAvx512(float* out, const float* current, const float* half, const size_t stride, const size_t count)
+        {
+            const __m512 two = _mm512_set1_ps(2.0f);
+
+            for (size_t cell = 0; cell < count; cell += 16)
+            {
+                const __mmask16 mask = (cell + 16 <= count)? 0xFFFF : (__mmask16) ((1u << (count - cell)) - 1);
+
+                __m512 center     = _mm512_maskz_loadu_ps(mask, current + cell);
+                __m512 difference = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, current + cell - stride),
+                                                  _mm512_maskz_loadu_ps(mask, current + cell + stride));
+
+                       difference = _mm512_fnmadd_ps(two, center, difference);
+
+                _mm512_mask_storeu_ps(out + cell, mask, _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, half + cell), difference, center));
+            }
+        }
+
+        TARGET_AVX512 void eliminationAvx512(double* rhs, const double* previous, const double* half, const double* factor, const size_t count)
+        {
+            for (size_t cell = 0; cell < count; cell += 8)
+            {
+                const __mmask8 mask = (cell + 8 <= count)? 0xFF : (__mmask8) ((1u << (count - cell)) - 1);
+
+                __m512d sum = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, half + cell), _mm512_maskz_loadu_pd(mask, previous + cell), _mm512_maskz_loadu_pd(mask, rhs + cell));
+
+                _mm512_mask_storeu_pd(rhs + cell, mask, _mm512_mul_pd(sum, _mm512_maskz_loadu_pd(mask, factor + cell)));
+            }
+        }
+
+        TARGET_AVX512 void eliminationAvx512(float* rhs, const float* previous, const float* half, const float* factor, const size_t count)
+        {
+            for (size_t cell = 0; cell < count; cell += 16)
+            {
+                const __mmask16 mask = (cell + 16 <= count)? 0xFFFF : (__mmask16) ((1u << (count - cell)) - 1);
+
+                __m512 sum = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, half + cell), _mm512_maskz_loadu_ps(mask, previous + cell), _mm512_maskz_loadu_ps(mask, rhs + cell));
+
+                _mm512_mask_storeu_ps(rhs + cell, mask, _mm512_mul_ps(sum, _mm512_maskz_loadu_ps(mask, factor + cell)));
+            }
+        }
+
+        TARGET_AVX512 void substitutionAvx512(double* solution, const double* next, const double* upper, const size_t count)
+        {
+            for (size_t cell = 0; cell < count; cell += 8)
+            {
+                const __mmask8 mask = (cell + 8 <= count)? 0xFF : (__mmask8) ((1u << (count - cell)) - 1);
+
+                _mm512_mask_storeu_pd(solution + cell, mask, _mm512_fnmadd_pd(_mm512_maskz_loadu_pd(mask, upper + cell), _mm512_maskz_loadu_pd(mask, next + cell),
+                                                                              _mm512_maskz_loadu_pd(mask, solution + cell)));
+            }
+        }
+
+        TARGET_AVX512 void substitutionAvx512(float* solution, const float* next, const float* upper, const size_t count)
+        {
+            for (size_t cell = 0; cell < count; cell += 16)
+            {
+                const __mmask16 mask = (cell + 16 <= count)? 0xFFFF : (__mmask16) ((1u << (count - cell)) - 1);
+
+                _mm512_mask_storeu_ps(solution + cell, mask, _mm512_fnmadd_ps(_mm512_maskz_loadu_ps(mask, upper + cell), _mm512_maskz_loadu_ps(mask, next + cell),
+                                                                              _mm512_maskz_loadu_ps(mask, solution + cell)));
+            }
+        }
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Runtime dispatch
+//----------------------------------------------------------------------------
+
+    unsigned char detectIsa()
+    {
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return ISA_SCALAR;
+
+        bool osxsave = (ecx & (1u << 27)) != 0;
+        bool avx     = (ecx & (1u << 28)) != 0;
+        bool fma     = (ecx & (1u << 12)) != 0;
+
+        if (!osxsave || !avx) return ISA_SCALAR;
+
+        // The OS has to save the wide registers on context switches:
+        unsigned int xcr0 = 0, xcr0High = 0;
+        __asm__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0High) : "c" (0));
+
+        bool osYmm = (xcr0 & 0x06) == 0x06;
+        bool osZmm = (xcr0 & 0xE6) == 0xE6;
+
+        if (__get_cpuid_max(0, nullptr) < 7) return ISA_SCALAR;
+
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+        bool avx2    = (ebx & (1u <<  5)) != 0;
+        bool avx512f = (ebx & (1u << 16)) != 0;
+
+        if (avx512f && osZmm)       return ISA_AVX512;
+        if (avx2 && fma && osYmm)   return ISA_AVX2;
+
+        return ISA_SCALAR;
+    }
+
+    const char* isaName(const unsigned char isa)
+    {
+        return (isa == ISA_AVX512)? "AVX-512" :
+               (isa == ISA_AVX2  )? "AVX2"    :
+                                    "scalar";
+    }
+
+    // The best path the CPU supports, capped by FIELD_ISA=scalar|avx2 for comparisons:
+    unsigned char stencilIsa()
+    {
+        static unsigned char isa = 0xFF;
+
+        if (isa == 0xFF)
+        {
+            isa = detectIsa();
+
+            const char* cap = getenv("FIELD_ISA");
+
+            if (cap != nullptr && strcmp(cap, "scalar") == 0)                    isa = ISA_SCALAR;
+            if (cap != nullptr && strcmp(cap, "avx2")   == 0 && isa > ISA_AVX2) isa = ISA_AVX2;
+        }
+
+        return isa;
+    }
+
+    // Overload resolution picks the double or float version of each path:
+    template <typename Real, unsigned char Shape>
+    StencilKernel<Real> shapedStencilKernel(const unsigned char isa)
+    {
+        StencilKernel<Real> avx512 = stencilAvx512<Shape>;
+        StencilKernel<Real> avx2   = stencilAvx2<Shape>;
+        StencilKernel<Real> scalar = stencilScalar<Real, Shape>;
+
+        return (isa == ISA_AVX512)? avx512 :
+               (isa == ISA_AVX2  )? avx2   :
+                                    scalar;
+    }
+
+    template <typename Real>
+    StencilKernel<Real> stencilKernel(const unsigned char isa, const unsigned char shape = STENCIL_5_POINT)
+    {
+        return (shape == STENCIL_9_POINT  )? shapedStencilKernel<Real, STENCIL_9_POINT>  (isa) :
+               (shape == STENCIL_4TH_ORDER)? shapedStencilKernel<Real, STENCIL_4TH_ORDER>(isa) :
+                                             shapedStencilKernel<Real, STENCIL_5_POINT>  (isa);
+    }
+
+    template <typename Real>
+    VolumeKernel<Real> volumeKernel(const unsigned char isa)
+    {
+        VolumeKernel<Real> avx512 = volumeAvx512;
+        VolumeKernel<Real> avx2   = volumeAvx2;
+        VolumeKernel<Real> scalar = volumeScalar<Real>;
+
+        return (isa == ISA_AVX512)? avx512 :
+               (isa == ISA_AVX2  )? avx2   :
+                                    scalar;
+    }
+
+    template <typename Real>
+    EnsembleKernel<Real> ensembleKernel(const unsigned char isa)
+    {
+        EnsembleKernel<Real> avx512 = ensembleAvx512;
+        EnsembleKernel<Real> avx2   = ensembleAvx2;
+        EnsembleKernel<Real> scalar = ensembleScalar<Real>;
+
+        return (isa == ISA_AVX512)? avx512 :
+               (isa == ISA_AVX2  )? avx2   :
+                                    scalar;
+    }
+
+    const char* stencilName(const unsigned char shape)
+    {
+        return (shape == STENCIL_9_POINT  )? "9-point"      :
+               (shape == STENCIL_4TH_ORDER)? "fourth order" :
+                                             "5-point";
+    }
+
+    template <typename Real>
+    ExplicitHalfKernel<Real> explicitHalfKernel(const unsigned char isa)
+    {
+        ExplicitHalfKernel<Real> avx512 = explicitHalfAvx512;
+        ExplicitHalfKernel<Real> avx2   = explicitHalfAvx2;
+        ExplicitHalfKernel<Real> scalar = explicitHalfScalar<Real>;
+
+        return (isa == ISA_AVX512)? avx512 :
+               (isa == ISA_AVX2  )? avx2   :
+                                    scalar;
+    }
+
+    template <typename Real>
+    EliminationKernel<Real> eliminationKernel(const unsigned char isa)
+    {
+        EliminationKernel<Real> avx512 = eliminationAvx512;
+        EliminationKernel<Real> avx2   = eliminationAvx2;
+        EliminationKernel<Real> scalar = eliminationScalar<Real>;
+
+        return (isa == ISA_AVX512)? avx512 :
+               (isa == ISA_AVX2  )? avx2   :
+                                    scalar;
+    }
+
+    template <typename Real>
+    SubstitutionKernel<Real> substitutionKernel(const unsigned char isa)
+    {
+        SubstitutionKernel<Real> avx512 = substitutionAvx512;
+        SubstitutionKernel<Real> avx2   = substitutionAvx2;
+        SubstitutionKernel<Real> scalar = substitutionScalar<Real>;
+
+        return (isa == ISA_AVX512)? avx512 :
+               (isa == ISA_AVX2  )? avx2   :
+                                    scalar;
+    }
+
+//}
+//----------------------------------------------------------------------------
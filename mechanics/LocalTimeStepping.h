@@ -0,0 +1,481 @@
+#pragma once
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // Tiles step by timeStep / 2^level, longer steps are split so the stiffest tile fits in these levels:
+    const unsigned int LOCAL_MAX_LEVELS = 7;
+
+    // Side of the square tiles that pick their own level (the tiles of Field::setSparse()):
+    const size_t LOCAL_TILE_SIZE = 32;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ LocalTimeStepping
+//----------------------------------------------------------------------------
+
+    // Explicit steps of any length where every tile sub-cycles only as much as its own conductivities need.
+    // A tile of level l takes 2^l steps of timeStep / 2^l, small enough for its stiffest cell,
+    // and all levels meet at the end of every step. Within it the finest steps are walked
+    // in order, a level updates when its own step ends, finer levels first, and tiles of one
+    // level update Jacobi-like from the old values.
+    //
+    // A finer tile sees a coarser neighbour frozen over its step, like any explicit scheme.
+    // A coarser tile sees the time average of its finer neighbours over its step, so both sides
+    // integrate the same temperature difference across the interface and heat handed over
+    // by the fast side in small steps arrives whole on the slow side. Instead of checking
+    // neighbour levels per cell, interface_ holds average - current value of the finer
+    // neighbours: resetInterfaces() starts it at -current after the coarse update, every fine
+    // update adds old * (fine step / coarse step) - (new - old), and the plain stencil
+    // sum + interface_ is what the coarse cell needs.
+
+    template <typename Real>
+    class LocalTimeStepping
+    {
+        public:
+
+            // Constructor && destructor:
+
+                explicit LocalTimeStepping(const GridLayout& grid);
+
+                ~LocalTimeStepping();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Stepping:
+
+                    // Levels for steps of weights * scale, where weights * limit is the largest stable explicit step:
+                    void setup(const Real* weights, const double scale, const double limit);
+
+                    // temperatures take the step in place, next holds each tile's new values until
+                    // they are committed; returns the number of tile sweeps it took:
+                    size_t step(Real* temperatures, Real* next, const Real* weights, ThreadPool* pool);
+
+        private:
+
+            struct Sweep
+            {
+                LocalTimeStepping* lts;
+                const Real*        current;
+                Real*              next;
+                const Real*        weights;
+                size_t             first;
+                size_t             last;
+                Real               scale;
+            };
+
+            // Cells of a tile along one of its sides and the tile across it:
+            struct TileSide
+            {
+                size_t neighbour;
+                size_t first;
+                size_t stride;
+                size_t count;
+                size_t offset;
+            };
+
+            GridLayout grid_;
+
+            size_t tilesX_;
+            size_t tilesY_;
+
+            // Tile levels, tiles that ever change sorted by level, and for cells next to finer tiles
+            // the time average of those neighbours minus their current value:
+            unsigned char* tileLevels_;
+            size_t*        levelTiles_;
+            size_t         levelStarts_[LOCAL_MAX_LEVELS + 1];
+            unsigned int   levels_;
+            Real*          interface_;
+
+            // The step is split into splits_ steps of scale_ each:
+            unsigned int splits_;
+            double       scale_;
+
+            // Sides are 0 (left), 1 (right), 2 (top) and 3 (bottom):
+            bool tileSide(const size_t tile, const unsigned int side, TileSide* result) const;
+
+            void localTile(const Sweep* sweep, const size_t tile);
+            void pushInterfaces(const Real* current, const Real* next, const Real* weights, const size_t tile);
+            void resetInterfaces(const Real* current, const size_t tile);
+
+            static void sweepTask(void* sweep, const unsigned int worker, const unsigned int workers);
+
+            LocalTimeStepping(const LocalTimeStepping&);
+            LocalTimeStepping& operator=(const LocalTimeStepping&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        LocalTimeStepping<Real>::LocalTimeStepping(const GridLayout& grid) :
+            grid_        (grid),
+            tilesX_      ((grid.width  + LOCAL_TILE_SIZE - 1) / LOCAL_TILE_SIZE),
+            tilesY_      ((grid.height + LOCAL_TILE_SIZE - 1) / LOCAL_TILE_SIZE),
+            tileLevels_  (nullptr),
+            levelTiles_  (nullptr),
+            levelStarts_ (),
+            levels_      (0),
+            interface_   (nullptr),
+            splits_      (0),
+            scale_       (0)
+        {
+            // Creating arrays:
+
+                tileLevels_ = (unsigned char*) calloc(tilesX_ * tilesY_, sizeof(*tileLevels_));
+                levelTiles_ = (size_t*)        calloc(tilesX_ * tilesY_, sizeof(*levelTiles_));
+                interface_  = (Real*)          alignedCalloc(grid_.cells, sizeof(*interface_));
+
+                assert(tileLevels_ && levelTiles_);
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        LocalTimeStepping<Real>::~LocalTimeStepping()
+        {
+            assert(ok());
+
+            free(tileLevels_);
+            free(levelTiles_);
+            alignedFree(interface_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        bool LocalTimeStepping<Real>::ok() const
+        {
+            bool everythingOk = true;
+
+            if (tileLevels_ == nullptr || levelTiles_ == nullptr || interface_ == nullptr)
+            {
+                everythingOk = false;
+                printf("LocalTimeStepping::ok(): Level arrays are null pointers.");
+            }
+
+            if (levels_ > LOCAL_MAX_LEVELS)
+            {
+                everythingOk = false;
+                printf("LocalTimeStepping::ok(): %d levels are more than %d.", levels_, LOCAL_MAX_LEVELS);
+            }
+
+            return everythingOk;
+        }
+
+        // A tile's stiffest cell allows steps of scale limit / weight:
+        template <typename Real>
+        void LocalTimeStepping<Real>::setup(const Real* weights, const double scale, const double limit)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(weights);
+                assert(scale > 0 && limit > 0);
+
+            // Creating resources:
+
+                const size_t tiles = tilesX_ * tilesY_;
+
+                // Tiles that never change have no level list entry and count as the coarsest:
+
+                Real*  maxWeights = (Real*) calloc(tiles, sizeof(*maxWeights));
+                assert(maxWeights);
+
+            // Main algorithm:
+
+                double stiffest = 0;
+
+                for (size_t tile = 0; tile < tiles; tile++)
+                {
+                    size_t startX = (tile / tilesY_) * LOCAL_TILE_SIZE;
+                    size_t startY = (tile % tilesY_) * LOCAL_TILE_SIZE;
+
+                    size_t finishX = (startX + LOCAL_TILE_SIZE < grid_.width)?  startX + LOCAL_TILE_SIZE : grid_.width;
+                    size_t finishY = (startY + LOCAL_TILE_SIZE < grid_.height)? startY + LOCAL_TILE_SIZE : grid_.height;
+
+                    for (size_t x = startX; x < finishX; x++)
+                    {
+                        for (size_t y = startY; y < finishY; y++)
+                        {
+                            maxWeights[tile] = std::max(maxWeights[tile], weights[grid_.index(x, y)]);
+                        }
+                    }
+
+                    stiffest = std::max(stiffest, (double) maxWeights[tile]);
+                }
+
+                // Steps of the stiffest tile within the whole step, split until they fit in the levels:
+
+                double substeps = scale * stiffest / limit;
+
+                splits_ = 1;
+
+                while (substeps > (1u << (LOCAL_MAX_LEVELS - 1)))
+                {
+                    splits_  *= 2;
+                    substeps /= 2;
+                }
+
+                scale_ = scale / splits_;
+
+                levels_ = 1;
+
+                unsigned int counts[LOCAL_MAX_LEVELS] = {};
+
+                for (size_t tile = 0; tile < tiles; tile++)
+                {
+                    unsigned int level = 0;
+
+                    while (level < LOCAL_MAX_LEVELS - 1 && scale_ / (1u << level) * maxWeights[tile] > limit) level++;
+
+                    tileLevels_[tile] = level;
+
+                    if (maxWeights[tile] > 0) counts[level]++;
+
+                    levels_ = std::max(levels_, level + 1);
+                }
+
+                levelStarts_[0] = 0;
+
+                for (unsigned int level = 0; level < levels_; level++)
+                {
+                    levelStarts_[level + 1] = levelStarts_[level] + counts[level];
+                    counts[level] = 0;
+                }
+
+                for (size_t tile = 0; tile < tiles; tile++)
+                {
+                    if (maxWeights[tile] > 0) levelTiles_[levelStarts_[tileLevels_[tile]] + counts[tileLevels_[tile]]++] = tile;
+                }
+
+                free(maxWeights);
+
+                memset(interface_, 0, grid_.cells * sizeof(*interface_));
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        size_t LocalTimeStepping<Real>::step(Real* temperatures, Real* next, const Real* weights, ThreadPool* pool)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(temperatures && next && weights);
+                assert(splits_ > 0);
+
+            // Main algorithm:
+
+                const unsigned int finest = levels_ - 1;
+
+                size_t sweeps = 0;
+
+                for (unsigned int split = 0; split < splits_; split++)
+                {
+                    for (size_t active = 0; active < levelStarts_[levels_]; active++)
+                    {
+                        resetInterfaces(temperatures, levelTiles_[active]);
+                    }
+
+                    for (unsigned int substep = 0; substep < (1u << finest); substep++)
+                    {
+                        // Levels whose step ends with this substep, from the finest one:
+                        for (unsigned int level = finest + 1; level-- > 0; )
+                        {
+                            if ((substep + 1) % (1u << (finest - level)) != 0) break;
+
+                            Sweep sweep = {this, temperatures, next, weights, levelStarts_[level], levelStarts_[level + 1], (Real) (scale_ / (1u << level))};
+
+                            if (sweep.first == sweep.last) continue;
+
+                            if (pool != nullptr) pool->run(sweepTask, &sweep);
+                            else                 sweepTask(&sweep, 0, 1);
+
+                            for (size_t active = sweep.first; active < sweep.last; active++)
+                            {
+                                const size_t tile = levelTiles_[active];
+
+                                pushInterfaces(temperatures, next, weights, tile);
+
+                                size_t startX = (tile / tilesY_) * LOCAL_TILE_SIZE;
+                                size_t startY = (tile % tilesY_) * LOCAL_TILE_SIZE;
+
+                                size_t finishX = (startX + LOCAL_TILE_SIZE < grid_.width)?  startX + LOCAL_TILE_SIZE : grid_.width;
+                                size_t finishY = (startY + LOCAL_TILE_SIZE < grid_.height)? startY + LOCAL_TILE_SIZE : grid_.height;
+
+                                for (size_t x = startX; x < finishX; x++)
+                                {
+                                    memcpy(temperatures + grid_.index(x, startY), next + grid_.index(x, startY), (finishY - startY) * sizeof(*temperatures));
+                                }
+
+                                resetInterfaces(temperatures, tile);
+                            }
+
+                            sweeps += sweep.last - sweep.first;
+                        }
+                    }
+                }
+
+                return sweeps;
+        }
+
+        template <typename Real>
+        bool LocalTimeStepping<Real>::tileSide(const size_t tile, const unsigned int side, TileSide* result) const
+        {
+            assert(result);
+
+            const size_t tileX = tile / tilesY_;
+            const size_t tileY = tile % tilesY_;
+
+            size_t startX = tileX * LOCAL_TILE_SIZE;
+            size_t startY = tileY * LOCAL_TILE_SIZE;
+
+            size_t finishX = (startX + LOCAL_TILE_SIZE < grid_.width)?  startX + LOCAL_TILE_SIZE : grid_.width;
+            size_t finishY = (startY + LOCAL_TILE_SIZE < grid_.height)? startY + LOCAL_TILE_SIZE : grid_.height;
+
+            const size_t pitch = grid_.pitch;
+
+            // Offsets to the neighbour wrap around like the index arithmetic of the sweeps:
+
+            switch (side)
+            {
+                case 0:  if (tileX == 0)           return false;
+                         *result = {tile - tilesY_, grid_.index(startX,      startY),      1,     finishY - startY, 0 - pitch};
+                         return true;
+
+                case 1:  if (tileX == tilesX_ - 1) return false;
+                         *result = {tile + tilesY_, grid_.index(finishX - 1, startY),      1,     finishY - startY, pitch};
+                         return true;
+
+                case 2:  if (tileY == 0)           return false;
+                         *result = {tile - 1,       grid_.index(startX,      startY),      pitch, finishX - startX, 0 - (size_t) 1};
+                         return true;
+
+                case 3:  if (tileY == tilesY_ - 1) return false;
+                         *result = {tile + 1,       grid_.index(startX,      finishY - 1), pitch, finishX - startX, 1};
+                         return true;
+
+                default: assert(!"LocalTimeStepping::tileSide(): Unknown side.");
+                         return false;
+            }
+        }
+
+        // One step of the tile into next:
+        template <typename Real>
+        void LocalTimeStepping<Real>::localTile(const Sweep* sweep, const size_t tile)
+        {
+            size_t startX = (tile / tilesY_) * LOCAL_TILE_SIZE;
+            size_t startY = (tile % tilesY_) * LOCAL_TILE_SIZE;
+
+            size_t finishX = (startX + LOCAL_TILE_SIZE < grid_.width)?  startX + LOCAL_TILE_SIZE : grid_.width;
+            size_t finishY = (startY + LOCAL_TILE_SIZE < grid_.height)? startY + LOCAL_TILE_SIZE : grid_.height;
+
+            const size_t pitch   = grid_.pitch;
+            const Real*  current = sweep->current;
+            const Real*  weights = sweep->weights;
+            Real*        next    = sweep->next;
+            const Real   scale   = sweep->scale;
+
+            for (size_t x = startX; x < finishX; x++)
+            {
+                const size_t column = grid_.index(x, startY);
+
+                for (size_t cell = column; cell < column + (finishY - startY); cell++)
+                {
+                    const Real sum = current[cell - pitch] + current[cell + pitch] + current[cell - 1] + current[cell + 1] + interface_[cell];
+
+                    next[cell] = current[cell] + scale * weights[cell] * (sum - 4 * current[cell]);
+                }
+            }
+        }
+
+        // Before the tile's new values are committed, its step goes into the interfaces of coarser neighbours:
+        template <typename Real>
+        void LocalTimeStepping<Real>::pushInterfaces(const Real* current, const Real* next, const Real* weights, const size_t tile)
+        {
+            for (unsigned int side = 0; side < 4; side++)
+            {
+                TileSide edge = {};
+
+                if (!tileSide(tile, side, &edge) || tileLevels_[edge.neighbour] >= tileLevels_[tile]) continue;
+
+                const Real share = (Real) 1 / (1u << (tileLevels_[tile] - tileLevels_[edge.neighbour]));
+
+                for (size_t cell = edge.first, count = 0; count < edge.count; cell += edge.stride, count++)
+                {
+                    // Cells that never change never read it:
+                    if (weights[cell + edge.offset] <= 0) continue;
+
+                    const Real old = current[cell];
+
+                    interface_[cell + edge.offset] += old * share - (next[cell] - old);
+                }
+            }
+        }
+
+        // After the tile's update, its cells next to finer tiles start a new average:
+        template <typename Real>
+        void LocalTimeStepping<Real>::resetInterfaces(const Real* current, const size_t tile)
+        {
+            TileSide edges[4] = {};
+            bool     finer[4] = {};
+
+            for (unsigned int side = 0; side < 4; side++)
+            {
+                finer[side] = tileSide(tile, side, &edges[side]) && tileLevels_[edges[side].neighbour] > tileLevels_[tile];
+
+                for (size_t cell = edges[side].first, count = 0; finer[side] && count < edges[side].count; cell += edges[side].stride, count++)
+                {
+                    interface_[cell] = 0;
+                }
+            }
+
+            // Corner cells may have finer neighbours on two sides:
+
+            for (unsigned int side = 0; side < 4; side++)
+            {
+                for (size_t cell = edges[side].first, count = 0; finer[side] && count < edges[side].count; cell += edges[side].stride, count++)
+                {
+                    interface_[cell] -= current[cell + edges[side].offset];
+                }
+            }
+        }
+
+        template <typename Real>
+        void LocalTimeStepping<Real>::sweepTask(void* sweep, const unsigned int worker, const unsigned int workers)
+        {
+            Sweep* localSweep = (Sweep*) sweep;
+
+            for (size_t active = localSweep->first + worker; active < localSweep->last; active += workers)
+            {
+                localSweep->lts->localTile(localSweep, localSweep->lts->levelTiles_[active]);
+            }
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
@@ -0,0 +1,492 @@
+#pragma once
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // Cycles (how many times a level visits the next coarser one):
+
+        const unsigned int     NO_MULTIGRID = 0,
+                          MULTIGRID_V_CYCLE = 1,
+                          MULTIGRID_W_CYCLE = 2;
+
+    // Red-black Gauss-Seidel sweeps before and after the coarse correction:
+    const unsigned int MULTIGRID_SMOOTHING = 2;
+
+    // Levels are halved until neither side exceeds this, the coarsest level is then
+    // relaxed MULTIGRID_COARSEST_SWEEPS times instead of being coarsened further:
+    const size_t       MULTIGRID_COARSEST_SIZE   = 8;
+    const unsigned int MULTIGRID_COARSEST_SWEEPS = 32;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Multigrid
+//----------------------------------------------------------------------------
+
+    // Geometric multigrid for the systems of ConjugateGradient (see Implicit.h).
+    //
+    // Level 0 is the Field grid. Every coarser level merges 2 x 2 cells. Its operator is the Galerkin
+    // product R A P with piecewise constant P and R = P^T, so it is again a five-point stencil, but with
+    // a coupling per face: two fine faces merge into each coarse face, and faces to walls, borders
+    // or zero-conductivity cells are zero on every level. Obstacles thus coarsen exactly; a thin wall
+    // still separates its sides on coarse levels instead of being averaged away.
+    //
+    // Piecewise constant transfers make the Laplacian part of R A P twice too stiff, which slows
+    // V-cycles down as the grid grows, so that part is halved on every coarse level. The part of
+    // a diagonal above 4 is a mass term (1/(theta a) of an implicit step), it is summed unchanged.
+    //
+    // Smoothing is red-black Gauss-Seidel, black first on the way back up, so a cycle is a symmetric
+    // operator and can precondition CG: cycle() with a zero initial guess approximates A^-1.
+
+    template <typename Real>
+    class Multigrid
+    {
+        public:
+
+            // Constructor && destructor:
+
+                explicit Multigrid(const GridLayout& grid);
+
+                ~Multigrid();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Setting up:
+
+                    // MULTIGRID_V_CYCLE or MULTIGRID_W_CYCLE:
+                    void setCycle(const unsigned int cycle);
+
+                    // Builds the coarse levels for the system with this diagonal (see ConjugateGradient),
+                    // the array has to stay alive while the levels are used:
+                    void setup(const Real* diagonal);
+
+                    unsigned int levels() const;
+
+                // Solving:
+
+                    // correction ~= A^-1 residual with one cycle from a zero guess:
+                    void precondition(const Real* residual, Real* correction);
+
+        private:
+
+            struct Level
+            {
+                GridLayout grid;
+
+                // Row i: diagonal x_i - couplingX_i x_(i+pitch) - couplingX_(i-pitch) x_(i-pitch)
+                //                     - couplingY_i x_(i+1)     - couplingY_(i-1)     x_(i-1):
+                const Real* diagonal;
+                Real*       coarseDiagonal;
+                Real*       inverseDiagonal;
+                Real*       mass;
+                Real*       couplingX;
+                Real*       couplingY;
+
+                // Level 0 points to the caller's arrays:
+                const Real* rhs;
+                Real*       solution;
+
+                Real*       coarseRhs;
+                Real*       coarseSolution;
+                Real*       residual;
+            };
+
+            GridLayout grid_;
+
+            Level* levels_;
+            unsigned int levelCount_;
+
+            unsigned int cycle_;
+
+            void cycle(const unsigned int level);
+
+            void smooth  (const Level& level, const unsigned int firstColor);
+            void residual(const Level& level);
+
+            void restrictResidual(const Level& fine,   const Level& coarse);
+            void prolongSolution (const Level& coarse, const Level& fine);
+
+            Multigrid(const Multigrid&);
+            Multigrid& operator=(const Multigrid&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        Multigrid<Real>::Multigrid(const GridLayout& grid) :
+            grid_       (grid),
+            levels_     (nullptr),
+            levelCount_ (0),
+            cycle_      (MULTIGRID_V_CYCLE)
+        {
+            // Counting levels:
+
+                levelCount_ = 1;
+
+                for (size_t width = grid_.width, height = grid_.height; width > MULTIGRID_COARSEST_SIZE || height > MULTIGRID_COARSEST_SIZE; levelCount_++)
+                {
+                    width  = (width  + 1) / 2;
+                    height = (height + 1) / 2;
+                }
+
+            // Creating levels (level 0 borrows the caller's diagonal, rhs and solution):
+
+                levels_ = (Level*) calloc(levelCount_, sizeof(*levels_));
+                assert(levels_);
+
+                for (unsigned int level = 0; level < levelCount_; level++)
+                {
+                    Level& current = levels_[level];
+
+                    current.grid = (level == 0)? grid_ : paddedLayout((levels_[level - 1].grid.width  + 1) / 2,
+                                                                      (levels_[level - 1].grid.height + 1) / 2, sizeof(Real));
+
+                    const size_t cells = current.grid.cells;
+
+                    if (level > 0)
+                    {
+                        current.coarseDiagonal = (Real*) alignedCalloc(cells, sizeof(Real));
+                        current.coarseRhs      = (Real*) alignedCalloc(cells, sizeof(Real));
+                        current.coarseSolution = (Real*) alignedCalloc(cells, sizeof(Real));
+
+                        current.diagonal = current.coarseDiagonal;
+                        current.rhs      = current.coarseRhs;
+                        current.solution = current.coarseSolution;
+                    }
+
+                    current.inverseDiagonal = (Real*) alignedCalloc(cells, sizeof(Real));
+                    current.mass            = (Real*) alignedCalloc(cells, sizeof(Real));
+                    current.couplingX       = (Real*) alignedCalloc(cells, sizeof(Real));
+                    current.couplingY       = (Real*) alignedCalloc(cells, sizeof(Real));
+                    current.residual        = (Real*) alignedCalloc(cells, sizeof(Real));
+                }
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        Multigrid<Real>::~Multigrid()
+        {
+            assert(ok());
+
+            for (unsigned int level = 0; level < levelCount_; level++)
+            {
+                alignedFree(levels_[level].coarseDiagonal);
+                alignedFree(levels_[level].coarseRhs);
+                alignedFree(levels_[level].coarseSolution);
+
+                alignedFree(levels_[level].inverseDiagonal);
+                alignedFree(levels_[level].mass);
+                alignedFree(levels_[level].couplingX);
+                alignedFree(levels_[level].couplingY);
+                alignedFree(levels_[level].residual);
+            }
+
+            free(levels_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        //----------------------------------------------------------------------------
+        //{ Setting up
+        //----------------------------------------------------------------------------
+
+            template <typename Real>
+            bool Multigrid<Real>::ok() const
+            {
+                bool everythingOk = true;
+
+                if (levels_ == nullptr || levelCount_ == 0)
+                {
+                    everythingOk = false;
+                    printf("Multigrid::ok(): Levels array is a null pointer.");
+                }
+
+                for (unsigned int level = 0; everythingOk && level < levelCount_; level++)
+                {
+                    const Level& current = levels_[level];
+
+                    if (current.inverseDiagonal == nullptr || current.mass == nullptr || current.couplingX == nullptr || current.couplingY == nullptr || current.residual == nullptr)
+                    {
+                        everythingOk = false;
+                        printf("Multigrid::ok(): Level %d has null pointer arrays.", level);
+                    }
+
+                    if (level > 0 && (current.coarseDiagonal == nullptr || current.coarseRhs == nullptr || current.coarseSolution == nullptr))
+                    {
+                        everythingOk = false;
+                        printf("Multigrid::ok(): Level %d has null pointer arrays.", level);
+                    }
+                }
+
+                if (cycle_ != MULTIGRID_V_CYCLE && cycle_ != MULTIGRID_W_CYCLE)
+                {
+                    everythingOk = false;
+                    printf("Multigrid::ok(): Cycle %d is neither V nor W.", cycle_);
+                }
+
+                return everythingOk;
+            }
+
+            template <typename Real>
+            void Multigrid<Real>::setCycle(const unsigned int cycle)
+            {
+                assert(cycle == MULTIGRID_V_CYCLE || cycle == MULTIGRID_W_CYCLE);
+
+                cycle_ = cycle;
+            }
+
+            template <typename Real>
+            unsigned int Multigrid<Real>::levels() const
+            {
+                return levelCount_;
+            }
+
+            template <typename Real>
+            void Multigrid<Real>::setup(const Real* diagonal)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(diagonal);
+
+                // Main algorithm:
+
+                    // Level 0 couples every pair of neighbouring unknowns by one:
+
+                    Level& finest = levels_[0];
+
+                    finest.diagonal = diagonal;
+
+                    for (size_t x = 0; x < grid_.width; x++)
+                    {
+                        for (size_t y = 0; y < grid_.height; y++)
+                        {
+                            size_t cell = grid_.index(x, y);
+
+                            bool unknown = diagonal[cell] > 0;
+
+                            finest.inverseDiagonal[cell] = (unknown)? 1 / diagonal[cell] : 0;
+                            finest.mass           [cell] = (unknown)? diagonal[cell] - 4 : 0;
+
+                            finest.couplingX[cell] = (unknown && diagonal[cell + grid_.pitch] > 0)? 1 : 0;
+                            finest.couplingY[cell] = (unknown && diagonal[cell + 1]           > 0)? 1 : 0;
+                        }
+                    }
+
+                    // Coarse levels: a coarse cell sums its children's diagonals minus both ends of every
+                    // face inside it, a coarse face sums the two fine faces it covers (then both halved
+                    // except for the mass):
+
+                    for (unsigned int level = 1; level < levelCount_; level++)
+                    {
+                        const Level& fine   = levels_[level - 1];
+                              Level& coarse = levels_[level];
+
+                        const size_t finePitch = fine.grid.pitch;
+
+                        for (size_t x = 0; x < coarse.grid.width; x++)
+                        {
+                            for (size_t y = 0; y < coarse.grid.height; y++)
+                            {
+                                size_t cell  = coarse.grid.index(x, y);
+                                size_t child = fine.grid.index(2 * x, 2 * y);
+
+                                Real sum  = fine.diagonal[child] + fine.diagonal[child + 1] + fine.diagonal[child + finePitch] + fine.diagonal[child + finePitch + 1];
+                                Real mass = fine.mass    [child] + fine.mass    [child + 1] + fine.mass    [child + finePitch] + fine.mass    [child + finePitch + 1];
+
+                                Real inside = fine.couplingX[child] + fine.couplingX[child + 1] + fine.couplingY[child] + fine.couplingY[child + finePitch];
+
+                                coarse.mass          [cell] = mass;
+                                coarse.coarseDiagonal[cell] = mass + (sum - mass - 2 * inside) / 2;
+
+                                coarse.couplingX[cell] = (fine.couplingX[child + finePitch] + fine.couplingX[child + finePitch + 1]) / 2;
+                                coarse.couplingY[cell] = (fine.couplingY[child + 1]         + fine.couplingY[child + finePitch + 1]) / 2;
+
+                                coarse.inverseDiagonal[cell] = (coarse.coarseDiagonal[cell] > 0)? 1 / coarse.coarseDiagonal[cell] : 0;
+                            }
+                        }
+                    }
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+
+        //----------------------------------------------------------------------------
+        //{ Cycles
+        //----------------------------------------------------------------------------
+
+            template <typename Real>
+            void Multigrid<Real>::precondition(const Real* residual, Real* correction)
+            {
+                // Checking input:
+
+                    assert(ok());
+                    assert(residual && correction);
+
+                    assert(levels_[0].diagonal);
+
+                // Main algorithm:
+
+                    Level& finest = levels_[0];
+
+                    finest.rhs      = residual;
+                    finest.solution = correction;
+
+                    for (size_t x = 0; x < grid_.width; x++)
+                    {
+                        memset(correction + grid_.index(x, 0), 0, grid_.height * sizeof(*correction));
+                    }
+
+                    cycle(0);
+
+                    finest.rhs      = nullptr;
+                    finest.solution = nullptr;
+            }
+
+            template <typename Real>
+            void Multigrid<Real>::cycle(const unsigned int level)
+            {
+                const Level& current = levels_[level];
+
+                if (level == levelCount_ - 1)
+                {
+                    for (unsigned int sweep = 0; sweep < MULTIGRID_COARSEST_SWEEPS; sweep++) smooth(current, 0);
+                    for (unsigned int sweep = 0; sweep < MULTIGRID_COARSEST_SWEEPS; sweep++) smooth(current, 1);
+
+                    return;
+                }
+
+                for (unsigned int sweep = 0; sweep < MULTIGRID_SMOOTHING; sweep++) smooth(current, 0);
+
+                const Level& coarse = levels_[level + 1];
+
+                residual(current);
+                restrictResidual(current, coarse);
+
+                for (size_t x = 0; x < coarse.grid.width; x++)
+                {
+                    memset(coarse.solution + coarse.grid.index(x, 0), 0, coarse.grid.height * sizeof(*coarse.solution));
+                }
+
+                for (unsigned int visit = 0; visit < cycle_; visit++) cycle(level + 1);
+
+                prolongSolution(coarse, current);
+
+                for (unsigned int sweep = 0; sweep < MULTIGRID_SMOOTHING; sweep++) smooth(current, 1);
+            }
+
+            // One red-black Gauss-Seidel sweep, colour firstColor first (cells with (x + y) % 2 == 0 are red):
+            template <typename Real>
+            void Multigrid<Real>::smooth(const Level& level, const unsigned int firstColor)
+            {
+                const size_t pitch = level.grid.pitch;
+
+                for (unsigned int pass = 0; pass < 2; pass++)
+                {
+                    const unsigned int color = (firstColor + pass) % 2;
+
+                    for (size_t x = 0; x < level.grid.width; x++)
+                    {
+                        const size_t column = level.grid.index(x, 0);
+
+                        for (size_t y = (x + color) % 2; y < level.grid.height; y += 2)
+                        {
+                            const size_t cell = column + y;
+
+                            Real neighbours = level.couplingX[cell]     * level.solution[cell + pitch] +
+                                              level.couplingX[cell - pitch] * level.solution[cell - pitch] +
+                                              level.couplingY[cell]     * level.solution[cell + 1] +
+                                              level.couplingY[cell - 1] * level.solution[cell - 1];
+
+                            level.solution[cell] = (level.rhs[cell] + neighbours) * level.inverseDiagonal[cell];
+                        }
+                    }
+                }
+            }
+
+            template <typename Real>
+            void Multigrid<Real>::residual(const Level& level)
+            {
+                const size_t pitch = level.grid.pitch;
+
+                for (size_t x = 0; x < level.grid.width; x++)
+                {
+                    const size_t column = level.grid.index(x, 0);
+
+                    for (size_t cell = column; cell < column + level.grid.height; cell++)
+                    {
+                        Real neighbours = level.couplingX[cell]     * level.solution[cell + pitch] +
+                                          level.couplingX[cell - pitch] * level.solution[cell - pitch] +
+                                          level.couplingY[cell]     * level.solution[cell + 1] +
+                                          level.couplingY[cell - 1] * level.solution[cell - 1];
+
+                        level.residual[cell] = (level.diagonal[cell] > 0)? level.rhs[cell] - level.diagonal[cell] * level.solution[cell] + neighbours : 0;
+                    }
+                }
+            }
+
+            // R sums the four children (cells of the ghost ring and walls hold zero residual):
+            template <typename Real>
+            void Multigrid<Real>::restrictResidual(const Level& fine, const Level& coarse)
+            {
+                const size_t finePitch = fine.grid.pitch;
+
+                for (size_t x = 0; x < coarse.grid.width; x++)
+                {
+                    for (size_t y = 0; y < coarse.grid.height; y++)
+                    {
+                        size_t child = fine.grid.index(2 * x, 2 * y);
+
+                        coarse.coarseRhs[coarse.grid.index(x, y)] = fine.residual[child] + fine.residual[child + 1] + fine.residual[child + finePitch] + fine.residual[child + finePitch + 1];
+                    }
+                }
+            }
+
+            // P = R^T copies the coarse correction to the children that are unknowns:
+            template <typename Real>
+            void Multigrid<Real>::prolongSolution(const Level& coarse, const Level& fine)
+            {
+                for (size_t x = 0; x < fine.grid.width; x++)
+                {
+                    for (size_t y = 0; y < fine.grid.height; y++)
+                    {
+                        size_t cell = fine.grid.index(x, y);
+
+                        if (fine.diagonal[cell] > 0) fine.solution[cell] += coarse.solution[coarse.grid.index(x / 2, y / 2)];
+                    }
+                }
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
@@ -0,0 +1,1198 @@
+#pragma once
+
+#include "Classes.h"
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // Steps every pass over the disk advances (see BandedField::setDepth()):
+    const unsigned int OUT_OF_CORE_DEPTH = 8;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ BitmapRows
+//----------------------------------------------------------------------------
+
+    // Rows of a BMP file read straight from the disk, a range at a time, for maps too large to load
+    // whole (txLoadImage() keeps the entire map in a GDI bitmap). Only uncompressed 24- and 32-bit
+    // images are read, which is what paint programs save maps as. Pixels outside the image read
+    // as CLR_INVALID, as GetPixel() returns them outside a bitmap.
+
+    class BitmapRows
+    {
+        public:
+
+            // Constructor && destructor:
+
+                explicit BitmapRows(const char* fileName);
+
+                ~BitmapRows();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Reading:
+
+                    // Reads rows [first, first + rows) with one seek (the rows of a BMP lie one after
+                    // another, usually from the bottom up):
+                    void read(const size_t first, const size_t rows);
+
+                    // A pixel of the rows read last, as GetPixel() would return it:
+                    COLORREF pixel(const size_t x, const size_t y) const;
+
+        private:
+
+            FILE* file_;
+
+            unsigned long long dataOffset_;
+
+            size_t  width_;
+            size_t height_;
+            size_t stride_;
+            size_t pixelSize_;
+            bool   bottomUp_;
+
+            // Rows [first_, last_) of the image as they are stored:
+            unsigned char* rows_;
+            size_t         capacity_;
+            size_t         first_;
+            size_t         last_;
+
+            BitmapRows(const BitmapRows&);
+            BitmapRows& operator=(const BitmapRows&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        BitmapRows::BitmapRows(const char* fileName) :
+            file_      (nullptr),
+            dataOffset_(0),
+            width_     (0),
+            height_    (0),
+            stride_    (0),
+            pixelSize_ (0),
+            bottomUp_  (true),
+            rows_      (nullptr),
+            capacity_  (0),
+            first_     (0),
+            last_      (0)
+        {
+            // Checking input:
+
+                assert(fileName != nullptr);
+
+            // Reading headers:
+
+                file_ = fopen(fileName, "rb");
+
+                if (file_ == nullptr) printf("BitmapRows::BitmapRows(): Could not open %s.", fileName);
+                assert(file_);
+
+                BITMAPFILEHEADER fileHeader = {};
+                BITMAPINFOHEADER infoHeader = {};
+
+                const bool read = fread(&fileHeader, sizeof(fileHeader), 1, file_) == 1 &&
+                                  fread(&infoHeader, sizeof(infoHeader), 1, file_) == 1;
+
+                const bool valid = read && fileHeader.bfType == 0x4D42 && infoHeader.biCompression == BI_RGB &&
+                                   (infoHeader.biBitCount == 24 || infoHeader.biBitCount == 32) && infoHeader.biWidth > 0;
+
+                if (!valid) printf("BitmapRows::BitmapRows(): %s is no uncompressed 24- or 32-bit BMP.", fileName);
+                assert(valid);
+
+            // Computing layout (rows are padded to 4 bytes, a negative height stores them from the top):
+
+                dataOffset_ = fileHeader.bfOffBits;
+
+                width_     = infoHeader.biWidth;
+                height_    = (infoHeader.biHeight < 0)? -infoHeader.biHeight : infoHeader.biHeight;
+                pixelSize_ = infoHeader.biBitCount / 8;
+                stride_    = (width_ * pixelSize_ + 3) / 4 * 4;
+                bottomUp_  = (infoHeader.biHeight > 0);
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        BitmapRows::~BitmapRows()
+        {
+            assert(ok());
+
+            fclose(file_);
+            free(rows_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        bool BitmapRows::ok() const
+        {
+            bool everythingOk = true;
+
+            if (file_ == nullptr)
+            {
+                everythingOk = false;
+                printf("BitmapRows::ok(): The file is not open.");
+            }
+
+            if (first_ > last_ || last_ > height_ || (last_ - first_) * stride_ > capacity_)
+            {
+                everythingOk = false;
+                printf("BitmapRows::ok(): Rows %d to %d of %d do not fit the buffer.", first_, last_, height_);
+            }
+
+            return everythingOk;
+        }
+
+        void BitmapRows::read(const size_t first, const size_t rows)
+        {
+            // Checking input:
+
+                assert(ok());
+
+            // Creating resources (rows below the image are left out):
+
+                first_ = std::min(first, height_);
+                last_  = std::min(first + rows, height_);
+
+                if ((last_ - first_) * stride_ > capacity_)
+                {
+                    capacity_ = (last_ - first_) * stride_;
+
+                    free(rows_);
+                    rows_ = (unsigned char*) malloc(capacity_);
+                    assert(rows_);
+                }
+
+            // Main algorithm:
+
+                const size_t storedFirst = (bottomUp_)? height_ - last_ : first_;
+
+                const bool read = _fseeki64(file_, dataOffset_ + (unsigned long long) storedFirst * stride_, SEEK_SET) == 0 &&
+                                  fread(rows_, stride_, last_ - first_, file_) == last_ - first_;
+
+                if (!read) printf("BitmapRows::read(): Rows %d to %d are cut short.", first_, last_);
+                assert(read);
+        }
+
+        COLORREF BitmapRows::pixel(const size_t x, const size_t y) const
+        {
+            if (x >= width_ || y >= height_) return CLR_INVALID;
+
+            assert(first_ <= y && y < last_);
+
+            const size_t row = (bottomUp_)? last_ - 1 - y : y - first_;
+
+            const unsigned char* color = rows_ + row * stride_ + x * pixelSize_;
+
+            return RGB(color[2], color[1], color[0]);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ BandedField
+//----------------------------------------------------------------------------
+
+    // A Field too large for memory: the grid lives in a directory as band files of bandHeight rows
+    // (temperatures-NNNNN.band and weights-NNNNN.band, each band's columns one after another) and
+    // calculate() streams the temperatures through a window of three bands: the band it computes,
+    // the next one, whose first rows it reads, and the one after that, read meanwhile by a reader
+    // thread that lives as long as the field. The last rows of the band before are kept from its pass.
+    //
+    // Weights never change after the constructor, so they are not read every pass: every weights
+    // band is mapped read-only once, passes read them from the views, and only the pages the
+    // file cache has dropped come from the disk again. The views take address space for half
+    // the grid, so a 32-bit build only streams grids whose weights fit in it.
+    //
+    // Every pass advances depth steps (temporal blocking across the disk): a band is computed
+    // with depth rows of each neighbour around it, the rows that are correct shrinking by one
+    // per step from both ends, until after depth steps exactly the band's own rows are. So the
+    // disk is read and written once per depth steps, for 2 depth rows per band of extra work,
+    // and every step is bit-identical to Field::calculate() with the 5-point stencil.
+    //
+    // Only weights are stored besides temperatures, so walls are cells of zero weight and zero
+    // temperature, and the brush heats the cells that conduct.
+    //
+    // The maps are read from their files a band at a time too (see BitmapRows), so neither the maps
+    // nor the grid are ever whole in memory; they must be uncompressed 24- or 32-bit BMPs.
+
+    template <typename Real>
+    class BandedField
+    {
+        public:
+
+            // Constructor && destructor:
+
+                // Writes the scene of the maps, as Field's constructor reads them, into the bands
+                // of an existing directory (the maps are read twice, band by band):
+                BandedField(const char* directory,
+                            const char* conductivitiesFileName,
+                            const char*      obstaclesFileName,
+                            const size_t width,
+                            const size_t height,
+                            const size_t bandHeight,
+                            const double wallConditions,
+                            const double emptySpaceConditions);
+
+                // Opens the bands a BandedField left in the directory:
+                explicit BandedField(const char* directory);
+
+                ~BandedField();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Setting conditions (rewrites the bands under the brush):
+
+                    void adjustTemperature(const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const double deltaTemperature);
+
+                // Calculations:
+
+                    void calculate();
+                    void calculate(const unsigned int steps);
+
+                    // Steps per pass over the disk, at most the band height (OUT_OF_CORE_DEPTH by default):
+                    void setDepth(const unsigned int depth);
+                    unsigned int depth() const;
+
+                    double stableTimeStep() const;
+                    double timeStep() const;
+
+                    // 1 (the default) calculates on the calling thread only, the reads run beside it anyway:
+                    void setThreads(const unsigned int threads);
+
+                    // Reads the cell from its band:
+                    Real temperature(const size_t x, const size_t y) const;
+
+                // Rendering (reads every band, for grids the size of the screen):
+
+                    void render(const unsigned int zoom = 1) const;
+
+        private:
+
+            // bands.hdr, the scene beside the bands:
+            struct BandsHeader
+            {
+                char               signature[8];
+                unsigned int       cellSize;
+                unsigned long long width;
+                unsigned long long height;
+                unsigned long long bandHeight;
+                double             timeStep;
+                double             stableTimeStep;
+            };
+
+            // What the reader thread reads next (quit ends it instead):
+            struct BandRead
+            {
+                size_t band;
+                Real*  temperatures;
+                bool   quit;
+            };
+
+            char directory_[MAX_PATH];
+
+            double timeStep_;
+            double stableTimeStep_;
+
+            StencilKernel<Real> stencil_;
+
+            ThreadPool* pool_;
+
+            unsigned int depth_;
+
+            // The window, bands as they are stored (cell (x, y) of band b at x * bandRows(b) + y - b * bandHeight_):
+            Real* bandTemperatures_[3];
+
+            // Every band's weights, as they are stored, viewed read-only from its file:
+            const Real** bandWeights_;
+
+            // The last depth_ rows of the band before, as they were before the pass (x * depth_ + row):
+            Real* carryTemperatures_;
+            Real* carryWeights_;
+
+            // A band with depth_ rows of its neighbours above and below, in a padded layout, and the
+            // two buffers steps alternate between:
+            GridLayout work_;
+
+            Real* workTemperatures_[2];
+            Real* workWeights_;
+
+            // The reader thread, woken by readStart_ for readRequest_, signals readDone_ after it;
+            // reading_ while a read runs beside the pass:
+            HANDLE   reader_;
+            HANDLE   readStart_;
+            HANDLE   readDone_;
+            BandRead readRequest_;
+            bool     reading_;
+
+            // Rows [sweepFirst_, sweepFirst_ + sweepRows_) of the working band, the step sweepColumns() takes:
+            size_t sweepFirst_;
+            size_t sweepRows_;
+            Real*  sweepNext_;
+            Real*  sweepCurrent_;
+
+            size_t  width_;
+            size_t height_;
+            size_t bandHeight_;
+            size_t bands_;
+
+            size_t bandRows(const size_t band) const;
+
+            void bandFileName(char* fileName, const char* kind, const size_t band) const;
+
+            void readBand (const size_t band, Real* temperatures) const;
+            void writeBand(const size_t band, const Real* temperatures, const Real* weights) const;
+
+            // Views of the weights bands, once they are written:
+            void mapWeights();
+            void unmapWeights();
+
+            void createReader();
+            void deleteReader();
+
+            void startRead(const size_t band, const unsigned int slot);
+            void finishRead();
+
+            static DWORD WINAPI readMain(LPVOID field);
+
+            // Arrays for the band height and depth:
+            void createBuffers();
+            void deleteBuffers();
+
+            // One pass of depth steps:
+            void pass(const unsigned int depth);
+
+            // Fills the working band of the band in slot from the carried rows and the next band:
+            void assemble(const size_t band, const unsigned int slot);
+
+            void sweepColumns(const size_t start, const size_t finish);
+
+            static void sweepColumnsTask(void* field, const unsigned int worker, const unsigned int workers);
+
+            BandedField(const BandedField&);
+            BandedField& operator=(const BandedField&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        BandedField<Real>::BandedField(const char* directory,
+                                       const char* conductivitiesFileName,
+                                       const char*      obstaclesFileName,
+                                       const size_t width,
+                                       const size_t height,
+                                       const size_t bandHeight,
+                                       const double wallConditions,
+                                       const double emptySpaceConditions) :
+            directory_         (),
+            timeStep_          (TIME_STEP),
+            stableTimeStep_    (HUGE_VAL),
+            stencil_           (stencilKernel<Real>(stencilIsa(), STENCIL_5_POINT)),
+            pool_              (nullptr),
+            depth_             (std::min((size_t) OUT_OF_CORE_DEPTH, bandHeight)),
+            bandTemperatures_  (),
+            bandWeights_       (nullptr),
+            carryTemperatures_ (nullptr),
+            carryWeights_      (nullptr),
+            work_              (),
+            workTemperatures_  (),
+            workWeights_       (nullptr),
+            reader_            (nullptr),
+            readStart_         (nullptr),
+            readDone_          (nullptr),
+            readRequest_       (),
+            reading_           (false),
+            sweepFirst_        (0),
+            sweepRows_         (0),
+            sweepNext_         (nullptr),
+            sweepCurrent_      (nullptr),
+            width_             (width),
+            height_            (height),
+            bandHeight_        (bandHeight),
+            bands_             ((height + bandHeight - 1) / bandHeight)
+        {
+            // Checking input:
+
+                assert(directory != nullptr);
+                assert(conductivitiesFileName != nullptr);
+                assert(obstaclesFileName != nullptr);
+
+                assert(width > 2 && height > 2 && bandHeight > 0);
+
+                snprintf(directory_, sizeof(directory_), "%s", directory);
+
+            // Creating arrays:
+
+                createBuffers();
+
+            // Finding the step (the scene is compiled band by band, so the step must be known first):
+
+                BitmapRows obstaclesMap     (obstaclesFileName);
+                BitmapRows conductivitiesMap(conductivitiesFileName);
+
+                for (size_t band = 0; band < bands_; band++)
+                {
+                    const size_t rows = bandRows(band);
+
+                    obstaclesMap     .read(band * bandHeight_, rows);
+                    conductivitiesMap.read(band * bandHeight_, rows);
+
+                    for (size_t x = 0; x < width_; x++)
+                    {
+                        for (size_t y = band * bandHeight_; y < band * bandHeight_ + rows; y++)
+                        {
+                            const bool edge = (x == 0 || y == 0 || x == width_ - 1 || y == height_ - 1);
+
+                            // Rounded like Field's conductivities_, for the same step and weights:
+                            const Real conductivity = (Real) (THERMAL_CONDUCTIVITY_COEFFICIENT * lerp(0.0, 1.0, (double) txExtractColor(conductivitiesMap.pixel(x, y), TX_RED) / 255));
+
+                            const COLORREF obstacle = obstaclesMap.pixel(x, y);
+
+                            if (!edge && obstacle != RGB(0, 0, 0) && obstacle != RGB(255, 0, 0) && conductivity > 0)
+                            {
+                                stableTimeStep_ = std::min(stableTimeStep_, SPACE_STEP * SPACE_STEP / (4 * (double) conductivity));
+                            }
+                        }
+                    }
+                }
+
+                if (timeStep_ > stableTimeStep_) timeStep_ = stableTimeStep_;
+
+            // Writing bands (the weights are staged in a band of their own):
+
+                Real* weights = (Real*) alignedCalloc(width_ * bandHeight_, sizeof(Real));
+
+                for (size_t band = 0; band < bands_; band++)
+                {
+                    const size_t rows = bandRows(band);
+
+                    obstaclesMap     .read(band * bandHeight_, rows);
+                    conductivitiesMap.read(band * bandHeight_, rows);
+
+                    for (size_t x = 0; x < width_; x++)
+                    {
+                        for (size_t row = 0; row < rows; row++)
+                        {
+                            const size_t y = band * bandHeight_ + row;
+
+                            COLORREF currentColor = obstaclesMap.pixel(x, y);
+
+                            char tile = (currentColor == RGB(  0, 0, 0))?   WALL_TILE :
+                                        (currentColor == RGB(255, 0, 0))? BORDER_TILE :
+                                                                           EMPTY_TILE;
+
+                            const bool edge = (x == 0 || y == 0 || x == width_ - 1 || y == height_ - 1);
+
+                            if (edge && tile == EMPTY_TILE) tile = BORDER_TILE;
+
+                            const Real conductivity = (Real) (THERMAL_CONDUCTIVITY_COEFFICIENT * lerp(0.0, 1.0, (double) txExtractColor(conductivitiesMap.pixel(x, y), TX_RED) / 255));
+
+                            weights[x * rows + row] = (tile == EMPTY_TILE)? (Real) (conductivity * timeStep_ / (SPACE_STEP * SPACE_STEP)) : 0;
+
+                            bandTemperatures_[0][x * rows + row] = (tile ==   WALL_TILE)? 0 :
+                                                                   (tile == BORDER_TILE)? (Real) wallConditions :
+                                                                                          (Real) emptySpaceConditions;
+                        }
+                    }
+
+                    writeBand(band, bandTemperatures_[0], weights);
+                }
+
+                alignedFree(weights);
+
+                mapWeights();
+                createReader();
+
+            // Writing the header:
+
+                BandsHeader header = {"HEATBND", sizeof(Real), width_, height_, bandHeight_, timeStep_, stableTimeStep_};
+
+                char headerName[MAX_PATH] = "";
+                snprintf(headerName, sizeof(headerName), "%s/bands.hdr", directory_);
+
+                FILE* file = fopen(headerName, "wb");
+                assert(file);
+
+                const bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+                fclose(file);
+
+                assert(written);
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        BandedField<Real>::BandedField(const char* directory) :
+            directory_         (),
+            timeStep_          (TIME_STEP),
+            stableTimeStep_    (HUGE_VAL),
+            stencil_           (stencilKernel<Real>(stencilIsa(), STENCIL_5_POINT)),
+            pool_              (nullptr),
+            depth_             (0),
+            bandTemperatures_  (),
+            bandWeights_       (nullptr),
+            carryTemperatures_ (nullptr),
+            carryWeights_      (nullptr),
+            work_              (),
+            workTemperatures_  (),
+            workWeights_       (nullptr),
+            reader_            (nullptr),
+            readStart_         (nullptr),
+            readDone_          (nullptr),
+            readRequest_       (),
+            reading_           (false),
+            sweepFirst_        (0),
+            sweepRows_         (0),
+            sweepNext_         (nullptr),
+            sweepCurrent_      (nullptr),
+            width_             (0),
+            height_            (0),
+            bandHeight_        (0),
+            bands_             (0)
+        {
+            // Checking input:
+
+                assert(directory != nullptr);
+
+                snprintf(directory_, sizeof(directory_), "%s", directory);
+
+            // Reading the header:
+
+                char headerName[MAX_PATH] = "";
+                snprintf(headerName, sizeof(headerName), "%s/bands.hdr", directory_);
+
+                FILE* file = fopen(headerName, "rb");
+                assert(file);
+
+                BandsHeader header = {};
+
+                const bool read = fread(&header, sizeof(header), 1, file) == 1;
+                fclose(file);
+
+                const bool valid = read && strcmp(header.signature, "HEATBND") == 0 && header.cellSize == sizeof(Real);
+
+                if (!valid) printf("BandedField::BandedField(): %s holds no bands of %d-byte cells.", headerName, sizeof(Real));
+                assert(valid);
+
+                width_      = (size_t) header.width;
+                height_     = (size_t) header.height;
+                bandHeight_ = (size_t) header.bandHeight;
+                bands_      = (height_ + bandHeight_ - 1) / bandHeight_;
+
+                timeStep_       = header.timeStep;
+                stableTimeStep_ = header.stableTimeStep;
+
+                depth_ = std::min((size_t) OUT_OF_CORE_DEPTH, bandHeight_);
+
+            // Creating arrays:
+
+                createBuffers();
+
+                mapWeights();
+                createReader();
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        BandedField<Real>::~BandedField()
+        {
+            assert(ok());
+
+            deleteReader();
+
+            deleteBuffers();
+            unmapWeights();
+
+            delete pool_;
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        bool BandedField<Real>::ok() const
+        {
+            bool everythingOk = true;
+
+            for (unsigned int slot = 0; slot < 3; slot++)
+            {
+                if (bandTemperatures_[slot] == nullptr)
+                {
+                    everythingOk = false;
+                    printf("BandedField::ok(): Band buffer %d is a null pointer.", slot);
+                }
+            }
+
+            if (bandWeights_ == nullptr || reader_ == nullptr || readStart_ == nullptr || readDone_ == nullptr)
+            {
+                everythingOk = false;
+                printf("BandedField::ok(): The weights are not mapped or the reader is not running.");
+            }
+
+            if (carryTemperatures_ == nullptr || carryWeights_ == nullptr || workTemperatures_[0] == nullptr || workTemperatures_[1] == nullptr || workWeights_ == nullptr)
+            {
+                everythingOk = false;
+                printf("BandedField::ok(): Working arrays are null pointers.");
+            }
+
+            if (depth_ == 0 || depth_ > bandHeight_ || bands_ * bandHeight_ < height_)
+            {
+                everythingOk = false;
+                printf("BandedField::ok(): Depth %d does not fit %d bands of %d rows.", depth_, bands_, bandHeight_);
+            }
+
+            return everythingOk;
+        }
+
+        template <typename Real>
+        void BandedField<Real>::createBuffers()
+        {
+            for (unsigned int slot = 0; slot < 3; slot++)
+            {
+                bandTemperatures_[slot] = (Real*) alignedCalloc(width_ * bandHeight_, sizeof(Real));
+            }
+
+            carryTemperatures_ = (Real*) alignedCalloc(width_ * depth_, sizeof(Real));
+            carryWeights_      = (Real*) alignedCalloc(width_ * depth_, sizeof(Real));
+
+            work_ = paddedLayout(width_, bandHeight_ + 2 * depth_, sizeof(Real));
+
+            workTemperatures_[0] = (Real*) alignedCalloc(work_.cells, sizeof(Real));
+            workTemperatures_[1] = (Real*) alignedCalloc(work_.cells, sizeof(Real));
+            workWeights_         = (Real*) alignedCalloc(work_.cells, sizeof(Real));
+        }
+
+        template <typename Real>
+        void BandedField<Real>::deleteBuffers()
+        {
+            for (unsigned int slot = 0; slot < 3; slot++)
+            {
+                alignedFree(bandTemperatures_[slot]);
+            }
+
+            alignedFree(carryTemperatures_);
+            alignedFree(carryWeights_);
+
+            alignedFree(workTemperatures_[0]);
+            alignedFree(workTemperatures_[1]);
+            alignedFree(workWeights_);
+        }
+
+        template <typename Real>
+        size_t BandedField<Real>::bandRows(const size_t band) const
+        {
+            return std::min(bandHeight_, height_ - band * bandHeight_);
+        }
+
+        //----------------------------------------------------------------------------
+        //{ Band files
+        //----------------------------------------------------------------------------
+
+            template <typename Real>
+            void BandedField<Real>::bandFileName(char* fileName, const char* kind, const size_t band) const
+            {
+                snprintf(fileName, MAX_PATH, "%s/%s-%05u.band", directory_, kind, (unsigned int) band);
+            }
+
+            // Weights are only ever written by the constructor:
+            template <typename Real>
+            void BandedField<Real>::writeBand(const size_t band, const Real* temperatures, const Real* weights) const
+            {
+                const size_t cells = width_ * bandRows(band);
+
+                const Real*  arrays[2] = {temperatures, weights};
+                const char*  kinds [2] = {"temperatures", "weights"};
+
+                for (unsigned int array = 0; array < 2; array++)
+                {
+                    if (arrays[array] == nullptr) continue;
+
+                    char fileName[MAX_PATH] = "";
+                    bandFileName(fileName, kinds[array], band);
+
+                    FILE* file = fopen(fileName, "wb");
+                    assert(file);
+
+                    const bool written = fwrite(arrays[array], sizeof(Real), cells, file) == cells;
+                    fclose(file);
+
+                    if (!written) printf("BandedField::writeBand(): Could not write %s.", fileName);
+                    assert(written);
+                }
+            }
+
+            template <typename Real>
+            void BandedField<Real>::readBand(const size_t band, Real* temperatures) const
+            {
+                const size_t cells = width_ * bandRows(band);
+
+                char fileName[MAX_PATH] = "";
+                bandFileName(fileName, "temperatures", band);
+
+                FILE* file = fopen(fileName, "rb");
+                assert(file);
+
+                const bool read = fread(temperatures, sizeof(Real), cells, file) == cells;
+                fclose(file);
+
+                if (!read) printf("BandedField::readBand(): Could not read %s.", fileName);
+                assert(read);
+            }
+
+            // The views stay after the files and mappings are closed, until unmapWeights():
+            template <typename Real>
+            void BandedField<Real>::mapWeights()
+            {
+                bandWeights_ = (const Real**) calloc(bands_, sizeof(*bandWeights_));
+                assert(bandWeights_);
+
+                for (size_t band = 0; band < bands_; band++)
+                {
+                    char fileName[MAX_PATH] = "";
+                    bandFileName(fileName, "weights", band);
+
+                    HANDLE file    = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                    HANDLE mapping = (file != INVALID_HANDLE_VALUE)? CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+
+                    bandWeights_[band] = (mapping != nullptr)? (const Real*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+                    if (mapping != nullptr)              CloseHandle(mapping);
+                    if (file    != INVALID_HANDLE_VALUE) CloseHandle(file);
+
+                    if (bandWeights_[band] == nullptr) printf("BandedField::mapWeights(): Could not map %s.", fileName);
+                    assert(bandWeights_[band]);
+                }
+            }
+
+            template <typename Real>
+            void BandedField<Real>::unmapWeights()
+            {
+                for (size_t band = 0; band < bands_; band++)
+                {
+                    UnmapViewOfFile(bandWeights_[band]);
+                }
+
+                free(bandWeights_);
+                bandWeights_ = nullptr;
+            }
+
+            template <typename Real>
+            void BandedField<Real>::createReader()
+            {
+                readStart_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+                readDone_  = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+                assert(readStart_ && readDone_);
+
+                reader_ = CreateThread(nullptr, 0, readMain, this, 0, nullptr);
+                assert(reader_);
+            }
+
+            template <typename Real>
+            void BandedField<Real>::deleteReader()
+            {
+                finishRead();
+
+                readRequest_.quit = true;
+                SetEvent(readStart_);
+
+                WaitForSingleObject(reader_, INFINITE);
+
+                CloseHandle(reader_);
+                CloseHandle(readStart_);
+                CloseHandle(readDone_);
+            }
+
+            template <typename Real>
+            void BandedField<Real>::startRead(const size_t band, const unsigned int slot)
+            {
+                assert(!reading_);
+
+                readRequest_.band         = band;
+                readRequest_.temperatures = bandTemperatures_[slot];
+
+                reading_ = true;
+                SetEvent(readStart_);
+            }
+
+            template <typename Real>
+            void BandedField<Real>::finishRead()
+            {
+                if (!reading_) return;
+
+                WaitForSingleObject(readDone_, INFINITE);
+
+                reading_ = false;
+            }
+
+            // Setting and waiting for the events orders the request and the band between the threads:
+            template <typename Real>
+            DWORD WINAPI BandedField<Real>::readMain(LPVOID field)
+            {
+                BandedField* self = (BandedField*) field;
+
+                while (true)
+                {
+                    WaitForSingleObject(self->readStart_, INFINITE);
+
+                    if (self->readRequest_.quit) break;
+
+                    self->readBand(self->readRequest_.band, self->readRequest_.temperatures);
+
+                    SetEvent(self->readDone_);
+                }
+
+                return 0;
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+        template <typename Real>
+        void BandedField<Real>::adjustTemperature(const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const double deltaTemperature)
+        {
+            // Checking input:
+
+                assert(ok());
+
+            // Creating resources (the brush of Field::adjustTemperature()):
+
+                const size_t startX = (roundX < radius)? 0 : roundX - radius;
+                const size_t startY = (roundY < radius)? 0 : roundY - radius;
+
+                const size_t finishX = (roundX + radius <  width_)? roundX + radius :  width_ - 1;
+                const size_t finishY = (roundY + radius < height_)? roundY + radius : height_ - 1;
+
+            // Main algorithm:
+
+                for (size_t band = startY / bandHeight_; band * bandHeight_ < finishY; band++)
+                {
+                    const size_t rows  = bandRows(band);
+                    const size_t first = band * bandHeight_;
+
+                    readBand(band, bandTemperatures_[0]);
+
+                    for (size_t x = startX; x < finishX; x++)
+                    {
+                        for (size_t y = std::max(startY, first); y < std::min(finishY, first + rows); y++)
+                        {
+                            const size_t cell = x * rows + y - first;
+
+                            if (bandWeights_[band][cell] <= 0) continue;
+
+                            if (pow((signed) roundX - (signed) x, 2) + pow((signed) roundY - (signed) y, 2) < pow(radius, 2))
+                            {
+                                if  (bandTemperatures_[0][cell] + deltaTemperature < 0) bandTemperatures_[0][cell] = 0;
+                                else bandTemperatures_[0][cell] += deltaTemperature;
+                            }
+                        }
+                    }
+
+                    writeBand(band, bandTemperatures_[0], nullptr);
+                }
+        }
+
+        template <typename Real>
+        void BandedField<Real>::calculate()
+        {
+            calculate(1);
+        }
+
+        template <typename Real>
+        void BandedField<Real>::calculate(const unsigned int steps)
+        {
+            // Checking input:
+
+                assert(ok());
+
+            // Main algorithm:
+
+                for (unsigned int step = 0; step < steps; step += depth_)
+                {
+                    pass(std::min(depth_, steps - step));
+                }
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        // Band b is computed from slot b % 3 while band b + 2 is read into the slot of band b - 1,
+        // whose rows the carry already holds:
+        template <typename Real>
+        void BandedField<Real>::pass(const unsigned int depth)
+        {
+            // Creating resources (nothing lies above the first band):
+
+                memset(carryTemperatures_, 0, width_ * depth_ * sizeof(*carryTemperatures_));
+                memset(carryWeights_,      0, width_ * depth_ * sizeof(*carryWeights_));
+
+                readBand(0, bandTemperatures_[0]);
+
+                if (bands_ > 1) startRead(1, 1);
+
+            // Main algorithm:
+
+                for (size_t band = 0; band < bands_; band++)
+                {
+                    const unsigned int slot = band % 3;
+                    const size_t       rows = bandRows(band);
+
+                    finishRead();
+
+                    if (band + 2 < bands_) startRead(band + 2, (band + 2) % 3);
+
+                    assemble(band, slot);
+
+                    // Step s updates the rows still correct after it, shrinking by one from each end:
+
+                        const size_t workRows = rows + 2 * depth_;
+
+                        for (unsigned int s = 0; s < depth; s++)
+                        {
+                            sweepFirst_   = s + 1;
+                            sweepRows_    = workRows - 2 * (s + 1);
+                            sweepCurrent_ = workTemperatures_[ s      % 2];
+                            sweepNext_    = workTemperatures_[(s + 1) % 2];
+
+                            if (pool_ != nullptr) pool_->run(sweepColumnsTask, this);
+                            else                  sweepColumns(0, width_);
+                        }
+
+                    // The band's old last rows are what the next band reads above it:
+
+                        if (band + 1 < bands_)
+                        {
+                            for (size_t x = 0; x < width_; x++)
+                            {
+                                memcpy(carryTemperatures_ + x * depth_, bandTemperatures_[slot] + x * rows + rows - depth_, depth_ * sizeof(Real));
+                                memcpy(carryWeights_      + x * depth_, bandWeights_[band]      + x * rows + rows - depth_, depth_ * sizeof(Real));
+                            }
+                        }
+
+                    // Storing the band's own rows:
+
+                        const Real* result = workTemperatures_[depth % 2];
+
+                        for (size_t x = 0; x < width_; x++)
+                        {
+                            memcpy(bandTemperatures_[slot] + x * rows, result + work_.index(x, depth_), rows * sizeof(Real));
+                        }
+
+                        writeBand(band, bandTemperatures_[slot], nullptr);
+                }
+
+                finishRead();
+        }
+
+        // Row r of the working band is row band * bandHeight_ - depth_ + r of the grid; rows outside
+        // the grid are zero-weight zeros:
+        template <typename Real>
+        void BandedField<Real>::assemble(const size_t band, const unsigned int slot)
+        {
+            const size_t rows = bandRows(band);
+
+            const size_t       nextRows = (band + 1 < bands_)? std::min((size_t) depth_, bandRows(band + 1)) : 0;
+            const unsigned int nextSlot = (band + 1) % 3;
+
+            Real* temperatures = workTemperatures_[0];
+
+            for (size_t x = 0; x < width_; x++)
+            {
+                const size_t column = work_.index(x, 0);
+
+                memcpy(temperatures + column, carryTemperatures_ + x * depth_, depth_ * sizeof(Real));
+                memcpy(workWeights_ + column, carryWeights_      + x * depth_, depth_ * sizeof(Real));
+
+                memcpy(temperatures + column + depth_, bandTemperatures_[slot] + x * rows, rows * sizeof(Real));
+                memcpy(workWeights_ + column + depth_, bandWeights_[band]      + x * rows, rows * sizeof(Real));
+
+                memset(temperatures + column + depth_ + rows, 0, depth_ * sizeof(Real));
+                memset(workWeights_ + column + depth_ + rows, 0, depth_ * sizeof(Real));
+
+                if (nextRows == 0) continue;
+
+                const size_t nextColumn = x * bandRows(band + 1);
+
+                memcpy(temperatures + column + depth_ + rows, bandTemperatures_[nextSlot] + nextColumn, nextRows * sizeof(Real));
+                memcpy(workWeights_ + column + depth_ + rows, bandWeights_[band + 1]      + nextColumn, nextRows * sizeof(Real));
+            }
+        }
+
+        template <typename Real>
+        void BandedField<Real>::sweepColumns(const size_t start, const size_t finish)
+        {
+            for (size_t x = start; x < finish; x++)
+            {
+                const size_t cell = work_.index(x, sweepFirst_);
+
+                stencil_(sweepNext_ + cell, sweepCurrent_ + cell, workWeights_ + cell, nullptr, work_.pitch, sweepRows_);
+            }
+        }
+
+        template <typename Real>
+        void BandedField<Real>::sweepColumnsTask(void* field, const unsigned int worker, const unsigned int workers)
+        {
+            BandedField* self = (BandedField*) field;
+
+            self->sweepColumns(self->width_ *  worker      / workers,
+                               self->width_ * (worker + 1) / workers);
+        }
+
+        template <typename Real>
+        void BandedField<Real>::setDepth(const unsigned int depth)
+        {
+            assert(ok());
+            assert(depth > 0 && depth <= bandHeight_);
+
+            deleteBuffers();
+
+            depth_ = depth;
+
+            createBuffers();
+        }
+
+        template <typename Real>
+        unsigned int BandedField<Real>::depth() const
+        {
+            return depth_;
+        }
+
+        template <typename Real>
+        double BandedField<Real>::stableTimeStep() const
+        {
+            return stableTimeStep_;
+        }
+
+        template <typename Real>
+        double BandedField<Real>::timeStep() const
+        {
+            return timeStep_;
+        }
+
+        template <typename Real>
+        void BandedField<Real>::setThreads(const unsigned int threads)
+        {
+            assert(ok());
+            assert(threads > 0);
+
+            delete pool_;
+            pool_ = (threads > 1)? new ThreadPool(threads) : nullptr;
+        }
+
+        template <typename Real>
+        Real BandedField<Real>::temperature(const size_t x, const size_t y) const
+        {
+            assert(x < width_ && y < height_);
+
+            const size_t band = y / bandHeight_;
+
+            char fileName[MAX_PATH] = "";
+            bandFileName(fileName, "temperatures", band);
+
+            FILE* file = fopen(fileName, "rb");
+            assert(file);
+
+            Real value = 0;
+
+            const bool read = _fseeki64(file, ((long long) x * bandRows(band) + y - band * bandHeight_) * sizeof(Real), SEEK_SET) == 0 &&
+                              fread(&value, sizeof(value), 1, file) == 1;
+            fclose(file);
+
+            assert(read);
+
+            return value;
+        }
+
+        template <typename Real>
+        void BandedField<Real>::render(const unsigned int zoom /*= 1*/) const
+        {
+            // Checking input:
+
+                assert(ok());
+
+            // Main algorithm:
+
+                txSetFillColor (TX_BLACK);
+                txClear();
+
+                // Weights back to conductivities relative to the coefficient:
+                const double scale = SPACE_STEP * SPACE_STEP / (timeStep_ * THERMAL_CONDUCTIVITY_COEFFICIENT);
+
+                for (size_t band = 0; band < bands_; band++)
+                {
+                    const size_t rows = bandRows(band);
+
+                    readBand(band, bandTemperatures_[0]);
+
+                    for (size_t x = 0; x < width_; x++)
+                    {
+                        for (size_t row = 0; row < rows; row++)
+                        {
+                            const size_t y    = band * bandHeight_ + row;
+                            const size_t cell = x * rows + row;
+
+                            const int grey = (int) (255 * std::min(1.0, bandWeights_[band][cell] * scale));
+
+                            COLORREF currentColor = colorLerp(log(log(bandTemperatures_[0][cell] + 1) + 1), RGB(grey, grey, grey), MID_COLOR, WARM_COLOR);
+
+                            if (zoom >= 3)
+                            {
+                                txSetColor    (currentColor);
+                                txSetFillColor(currentColor);
+
+                                txRectangle(x * zoom, y * zoom, (x + 1) * zoom, (y + 1) * zoom);
+                            }
+                            else
+                            {
+                                txSetPixel(x * zoom, y * zoom, currentColor);
+                            }
+                        }
+                    }
+                }
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
@@ -0,0 +1,364 @@
+#pragma once
+
+
+//----------------------------------------------------------------------------
+//{ Preview
+//----------------------------------------------------------------------------
+
+    // A coarse copy of a Field's grid for warm starts: every block of factor x factor cells is
+    // one coarse cell holding the mean temperature of its unknowns, so a run costs factor^4 times
+    // less than on the full grid (factor^2 fewer cells, steps factor^2 times longer).
+    //
+    // Blocks are coupled like the levels of Multigrid, face by face: every fine pair of an unknown
+    // cell i and a neighbour j that crosses into another block adds weight_i / factor (the fine
+    // gradient across a block is its mean difference over factor cells) to the coupling towards
+    // that block, and pairs with a fixed j, inside the block or not, pull towards the fixed temperature
+    // the same way. A thin wall thus still separates its sides, and a block's mean moves as fast
+    // as the cells under it would.
+    //
+    // Blocks with few unknowns are very stiff, so the coarse steps are point-implicit:
+    //     T' = (T + s/n (sum coupling * T_neighbour + fixed heat)) / (1 + s/n (sum coupling + fixed coupling)),
+    // with s fine steps per coarse step and n unknowns in the block, a weighted mean of T and its
+    // neighbours that is stable for any s.
+
+    template <typename Real>
+    class Preview
+    {
+        public:
+
+            // Constructor && destructor:
+
+                Preview(const GridLayout& grid, const unsigned int factor);
+
+                ~Preview();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Transfers (weights are Field's, zero for fixed cells):
+
+                    // Couplings and block temperatures from the fine field:
+                    void restrictField(const Real* temperatures, const Real* weights);
+
+                    // Unknown fine cells receive the temperatures of the blocks, interpolated
+                    // bilinearly between blocks with unknowns; fixed cells are not touched:
+                    void prolongField(Real* temperatures, const Real* weights) const;
+
+                // Stepping:
+
+                    // Advances the blocks by that many fine steps in steps of at most factor^2 of them,
+                    // returns the number of coarse steps:
+                    unsigned int run(const double fineSteps);
+
+        private:
+
+            GridLayout grid_;
+            GridLayout coarse_;
+
+            unsigned int factor_;
+
+            // Coarse layout, ghosts are blocks without unknowns:
+            Real* inverseUnknowns_;
+            Real* couplingLeft_;
+            Real* couplingRight_;
+            Real* couplingTop_;
+            Real* couplingBottom_;
+            Real* fixedCoupling_;
+            Real* fixedHeat_;
+
+            Real* temperatures_;
+            Real* nextTemperatures_;
+
+            Preview(const Preview&);
+            Preview& operator=(const Preview&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        Preview<Real>::Preview(const GridLayout& grid, const unsigned int factor) :
+            grid_             (grid),
+            coarse_           (paddedLayout((grid.width + factor - 1) / factor, (grid.height + factor - 1) / factor, sizeof(Real))),
+            factor_           (factor),
+            inverseUnknowns_  (nullptr),
+            couplingLeft_     (nullptr),
+            couplingRight_    (nullptr),
+            couplingTop_      (nullptr),
+            couplingBottom_   (nullptr),
+            fixedCoupling_    (nullptr),
+            fixedHeat_        (nullptr),
+            temperatures_     (nullptr),
+            nextTemperatures_ (nullptr)
+        {
+            // Checking input:
+
+                assert(factor >= 2);
+
+            // Creating arrays:
+
+                inverseUnknowns_  = (Real*) alignedCalloc(coarse_.cells, sizeof(Real));
+                couplingLeft_     = (Real*) alignedCalloc(coarse_.cells, sizeof(Real));
+                couplingRight_    = (Real*) alignedCalloc(coarse_.cells, sizeof(Real));
+                couplingTop_      = (Real*) alignedCalloc(coarse_.cells, sizeof(Real));
+                couplingBottom_   = (Real*) alignedCalloc(coarse_.cells, sizeof(Real));
+                fixedCoupling_    = (Real*) alignedCalloc(coarse_.cells, sizeof(Real));
+                fixedHeat_        = (Real*) alignedCalloc(coarse_.cells, sizeof(Real));
+
+                temperatures_     = (Real*) alignedCalloc(coarse_.cells, sizeof(Real));
+                nextTemperatures_ = (Real*) alignedCalloc(coarse_.cells, sizeof(Real));
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        Preview<Real>::~Preview()
+        {
+            assert(ok());
+
+            alignedFree(inverseUnknowns_);
+            alignedFree(couplingLeft_);
+            alignedFree(couplingRight_);
+            alignedFree(couplingTop_);
+            alignedFree(couplingBottom_);
+            alignedFree(fixedCoupling_);
+            alignedFree(fixedHeat_);
+
+            alignedFree(temperatures_);
+            alignedFree(nextTemperatures_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        bool Preview<Real>::ok() const
+        {
+            bool everythingOk = true;
+
+            if (inverseUnknowns_ == nullptr || couplingLeft_ == nullptr || couplingRight_ == nullptr || couplingTop_ == nullptr ||
+                couplingBottom_ == nullptr || fixedCoupling_ == nullptr || fixedHeat_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Preview::ok(): Coupling arrays are null pointers.");
+            }
+
+            if (temperatures_ == nullptr || nextTemperatures_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Preview::ok(): Temperature buffers are null pointers.");
+            }
+
+            if (coarse_.width * factor_ < grid_.width || coarse_.height * factor_ < grid_.height)
+            {
+                everythingOk = false;
+                printf("Preview::ok(): %dx%d blocks do not cover %dx%d cells.", coarse_.width, coarse_.height, grid_.width, grid_.height);
+            }
+
+            return everythingOk;
+        }
+
+        template <typename Real>
+        void Preview<Real>::restrictField(const Real* temperatures, const Real* weights)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(temperatures && weights);
+
+            // Creating resources:
+
+                memset(inverseUnknowns_, 0, coarse_.cells * sizeof(*inverseUnknowns_));
+                memset(couplingLeft_,    0, coarse_.cells * sizeof(*couplingLeft_));
+                memset(couplingRight_,   0, coarse_.cells * sizeof(*couplingRight_));
+                memset(couplingTop_,     0, coarse_.cells * sizeof(*couplingTop_));
+                memset(couplingBottom_,  0, coarse_.cells * sizeof(*couplingBottom_));
+                memset(fixedCoupling_,   0, coarse_.cells * sizeof(*fixedCoupling_));
+                memset(fixedHeat_,       0, coarse_.cells * sizeof(*fixedHeat_));
+                memset(temperatures_,    0, coarse_.cells * sizeof(*temperatures_));
+
+                const Real scale = (Real) 1 / factor_;
+
+            // Main algorithm (unknowns are counted in inverseUnknowns_ first):
+
+                for (size_t x = 0; x < grid_.width; x++)
+                {
+                    for (size_t y = 0; y < grid_.height; y++)
+                    {
+                        const size_t cell   = grid_.index(x, y);
+                        const Real   weight = weights[cell];
+
+                        if (weight <= 0) continue;
+
+                        const size_t block = coarse_.index(x / factor_, y / factor_);
+
+                        inverseUnknowns_[block] += 1;
+                        temperatures_   [block] += temperatures[cell];
+
+                        // Left, right, top and bottom neighbours:
+
+                            const size_t neighbours[4] = {cell - grid_.pitch, cell + grid_.pitch, cell - 1, cell + 1};
+                            const bool   crossing  [4] = {x % factor_ == 0, (x + 1) % factor_ == 0, y % factor_ == 0, (y + 1) % factor_ == 0};
+
+                            Real* couplings[4] = {couplingLeft_, couplingRight_, couplingTop_, couplingBottom_};
+
+                            for (unsigned int side = 0; side < 4; side++)
+                            {
+                                const size_t neighbour = neighbours[side];
+
+                                if (weights[neighbour] <= 0)
+                                {
+                                    fixedCoupling_[block] += weight * scale;
+                                    fixedHeat_    [block] += weight * scale * temperatures[neighbour];
+                                }
+                                else if (crossing[side])
+                                {
+                                    couplings[side][block] += weight * scale;
+                                }
+                            }
+                    }
+                }
+
+                for (size_t x = 0; x < coarse_.width; x++)
+                {
+                    for (size_t y = 0; y < coarse_.height; y++)
+                    {
+                        const size_t block = coarse_.index(x, y);
+
+                        if (inverseUnknowns_[block] <= 0) continue;
+
+                        temperatures_   [block] /= inverseUnknowns_[block];
+                        inverseUnknowns_[block]  = 1 / inverseUnknowns_[block];
+                    }
+                }
+
+                memcpy(nextTemperatures_, temperatures_, coarse_.cells * sizeof(*temperatures_));
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        unsigned int Preview<Real>::run(const double fineSteps)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(fineSteps >= 0);
+
+            // Creating resources:
+
+                const unsigned int steps = (unsigned int) ceil(fineSteps / (factor_ * factor_));
+
+                if (steps == 0) return 0;
+
+                const Real stepScale = (Real) (fineSteps / steps);
+
+                const size_t pitch = coarse_.pitch;
+
+            // Main algorithm (blocks without unknowns have no couplings and keep their zero):
+
+                for (unsigned int step = 0; step < steps; step++)
+                {
+                    for (size_t x = 0; x < coarse_.width; x++)
+                    {
+                        const size_t column = coarse_.index(x, 0);
+
+                        for (size_t block = column; block < column + coarse_.height; block++)
+                        {
+                            const Real rate = stepScale * inverseUnknowns_[block];
+
+                            const Real inflow = couplingLeft_  [block] * temperatures_[block - pitch] + couplingRight_ [block] * temperatures_[block + pitch] +
+                                                couplingTop_   [block] * temperatures_[block - 1]     + couplingBottom_[block] * temperatures_[block + 1] +
+                                                fixedHeat_     [block];
+
+                            const Real outflow = couplingLeft_[block] + couplingRight_[block] + couplingTop_[block] + couplingBottom_[block] + fixedCoupling_[block];
+
+                            nextTemperatures_[block] = (temperatures_[block] + rate * inflow) / (1 + rate * outflow);
+                        }
+                    }
+
+                    Real* currentTemperatures = temperatures_;
+
+                    temperatures_     = nextTemperatures_;
+                    nextTemperatures_ = currentTemperatures;
+                }
+
+            // Checking output:
+
+                assert(ok());
+
+                return steps;
+        }
+
+        // Block centres sit at (X + 1/2) factor - 1/2 in fine cells:
+        template <typename Real>
+        void Preview<Real>::prolongField(Real* temperatures, const Real* weights) const
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(temperatures && weights);
+
+            // Main algorithm:
+
+                for (size_t x = 0; x < grid_.width; x++)
+                {
+                    const double blockX = (x + 0.5) / factor_ - 0.5;
+                    const int    leftX  = (int) floor(blockX);
+                    const double shareX = blockX - leftX;
+
+                    for (size_t y = 0; y < grid_.height; y++)
+                    {
+                        const size_t cell = grid_.index(x, y);
+
+                        if (weights[cell] <= 0) continue;
+
+                        const double blockY = (y + 0.5) / factor_ - 0.5;
+                        const int    topY   = (int) floor(blockY);
+                        const double shareY = blockY - topY;
+
+                        double sum    = 0;
+                        double shares = 0;
+
+                        for (int corner = 0; corner < 4; corner++)
+                        {
+                            const int cornerX = leftX + corner / 2;
+                            const int cornerY = topY  + corner % 2;
+
+                            if (cornerX < 0 || cornerY < 0 || cornerX >= (int) coarse_.width || cornerY >= (int) coarse_.height) continue;
+
+                            const size_t block = coarse_.index(cornerX, cornerY);
+
+                            if (inverseUnknowns_[block] <= 0) continue;
+
+                            const double share = ((corner / 2)? shareX : 1 - shareX) * ((corner % 2)? shareY : 1 - shareY);
+
+                            sum    += share * temperatures_[block];
+                            shares += share;
+                        }
+
+                        // The cell's own block always has an unknown, the cell itself:
+                        temperatures[cell] = (shares > 0)? (Real) (sum / shares) : temperatures_[coarse_.index(x / factor_, y / factor_)];
+                    }
+                }
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
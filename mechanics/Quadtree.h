@@ -0,0 +1,990 @@
+#pragma once
+
+#include "Classes.h"
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // A leaf whose largest temperature jump to a neighbour exceeds REFINE times the hottest
+    // temperature is split, four sibling leaves whose jumps all stay below COARSEN times it
+    // are merged (a merged leaf's jumps are about twice its children's, so it is not split back):
+    const double QUADTREE_REFINE_JUMP  = 1e-3;
+    const double QUADTREE_COARSEN_JUMP = QUADTREE_REFINE_JUMP / 4;
+
+    // Steps between two regrids, heat moves about a cell per step:
+    const unsigned int QUADTREE_REGRID_INTERVAL = 8;
+
+    // Tile of a node whose pixels are of different tiles or conductivities:
+    const unsigned char MIXED_TILE = 3;
+
+    const size_t NO_NODE = (size_t) -1;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ QuadtreeField
+//----------------------------------------------------------------------------
+
+    // The temperature field of Field on a quadtree of square cells instead of the full grid.
+    // The scene is read once into the tree: a node whose pixels all share the tile and the conductivity
+    // is uniform and may become a leaf of the mesh, so obstacle and conductivity edges always stay at
+    // pixel size while open rooms coarsen down to a few large cells. The mesh is a cut through
+    // the tree, refined where temperature jumps between neighbouring leaves are large (steep gradients,
+    // hot cells next to walls) and coarsened where they are small, every QUADTREE_REGRID_INTERVAL steps.
+    //
+    // Leaves are finite volumes: a face between leaves of sides a and b sharing length l conducts
+    // k l / ((a + b) / 2), k being the mean conductivity of two unknowns or the unknown's own one against
+    // a fixed leaf (walls, borders and cells without conductivity, as in Field). Every face's flux is
+    // computed once and applied to both sides, and refining copies the parent's temperature into
+    // the children while coarsening averages them, so heat is conserved across levels.
+    // On uniform maps at pixel size the step is the one of Field::calculate(), where conductivities
+    // change Field weighs every cell by its own one and does not conserve heat across the change.
+    //
+    // Memory and work scale with the leaves, not with the pixels, so a mostly cold large map costs
+    // about as much as the part of it that heat has reached.
+
+    template <typename Real>
+    class QuadtreeField
+    {
+        public:
+
+            // Constructor && destructor:
+
+                QuadtreeField(const char* conductivitiesFileName,
+                              const char*      obstaclesFileName,
+                              const char*          imageFileName,
+                              const size_t width,
+                              const size_t height,
+                              const double wallConditions,
+                              const double emptySpaceConditions,
+                              double (*fillingFunction) (const unsigned int x, const unsigned int y));
+
+                ~QuadtreeField();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Setting conditions (refines the disk down to pixels):
+
+                    void adjustTemperature(const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const double deltaTemperature);
+
+                // Calculations:
+
+                    void calculate();
+                    void calculate(const unsigned int steps);
+
+                    double timeStep() const;
+
+                // Mesh:
+
+                    size_t leaves() const;
+                    size_t nodes () const;
+
+                // Rendering (grid outlines the leaves):
+
+                    void render(const unsigned int zoom = 1, bool grid = false) const;
+
+        private:
+
+            struct QuadNode
+            {
+                // Top left pixel, the side is 2^level pixels:
+                size_t       x;
+                size_t       y;
+                unsigned int level;
+
+                size_t parent;
+
+                // First of the four children (left top, left bottom, right top, right bottom), NO_NODE before any split:
+                size_t children;
+
+                // Part of the mesh, with its temperature at slot of the leaf arrays (NO_NODE until collectLeaves()):
+                bool   leaf;
+                size_t slot;
+
+                unsigned char tile;
+                Real          conductivity;
+
+                // Up to date only between syncNodes() and collectLeaves():
+                Real temperature;
+            };
+
+            struct QuadFace
+            {
+                size_t first;
+                size_t second;
+
+                // k l / d:
+                Real conductance;
+            };
+
+            QuadNode* nodes_;
+            size_t    nodeCount_;
+            size_t    nodeCapacity_;
+
+            // Leaf arrays, in depth-first (Z) order of the tree:
+            size_t* leaves_;
+            Real*   temperatures_;
+            Real*   changes_;
+            Real*   jumps_;
+            // 1 / area, zero for fixed leaves:
+            Real*   inverseAreas_;
+            size_t  leafCount_;
+            size_t  leafCapacity_;
+
+            QuadFace* faces_;
+            size_t    faceCount_;
+            size_t    faceCapacity_;
+
+            double timeStep_;
+            double stableTimeStep_;
+
+            unsigned int steps_;
+
+            HDC image_;
+
+            size_t  width_;
+            size_t height_;
+
+            // Tree building:
+
+                size_t addNodes(const size_t count);
+
+                void buildScene(const size_t node, HDC obstaclesMap, HDC conductivitiesMap, const double wallConditions,
+                                const double emptySpaceConditions, double (*fillingFunction) (const unsigned int x, const unsigned int y));
+
+                void readPixel(const size_t node, HDC obstaclesMap, HDC conductivitiesMap, const double wallConditions,
+                               const double emptySpaceConditions, double (*fillingFunction) (const unsigned int x, const unsigned int y));
+
+            // Mesh:
+
+                inline bool fixed(const size_t node) const;
+
+                size_t findLeaf(const size_t x, const size_t y) const;
+
+                void split(const size_t node);
+                void merge(const size_t node);
+
+                void syncNodes();
+                void collectLeaves();
+                void collectLeaves(const size_t node);
+
+                void buildFaces();
+                void addFace(const size_t first, const size_t second, const size_t length, const size_t distance);
+
+                void regrid();
+
+            QuadtreeField(const QuadtreeField&);
+            QuadtreeField& operator=(const QuadtreeField&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        QuadtreeField<Real>::QuadtreeField(const char* conductivitiesFileName,
+                                           const char*      obstaclesFileName,
+                                           const char*          imageFileName,
+                                           const size_t width,
+                                           const size_t height,
+                                           const double wallConditions,
+                                           const double emptySpaceConditions,
+                                           double (*fillingFunction) (const unsigned int x, const unsigned int y)) :
+            nodes_          (nullptr),
+            nodeCount_      (0),
+            nodeCapacity_   (0),
+            leaves_         (nullptr),
+            temperatures_   (nullptr),
+            changes_        (nullptr),
+            jumps_          (nullptr),
+            inverseAreas_   (nullptr),
+            leafCount_      (0),
+            leafCapacity_   (0),
+            faces_          (nullptr),
+            faceCount_      (0),
+            faceCapacity_   (0),
+            timeStep_       (TIME_STEP),
+            stableTimeStep_ (HUGE_VAL),
+            steps_          (0),
+            image_          (nullptr),
+            width_          (width),
+            height_         (height)
+        {
+            // Checking input:
+
+                assert(obstaclesFileName != nullptr);
+                assert(conductivitiesFileName != nullptr);
+                assert(imageFileName != nullptr);
+
+                assert(width > 0 && height > 0);
+
+            // Creating image:
+
+                image_ = txLoadImage(imageFileName);
+                assert(image_);
+
+            // Building the tree (the root is the smallest power of two square around the picture):
+
+                HDC obstaclesMap = txLoadImage(obstaclesFileName);
+                assert(obstaclesMap);
+
+                HDC conductivitiesMap = txLoadImage(conductivitiesFileName);
+                assert(conductivitiesMap);
+
+                unsigned int rootLevel = 0;
+
+                while (((size_t) 1 << rootLevel) < width_ || ((size_t) 1 << rootLevel) < height_) rootLevel++;
+
+                size_t root = addNodes(1);
+
+                nodes_[root].level  = rootLevel;
+                nodes_[root].parent = NO_NODE;
+
+                buildScene(root, obstaclesMap, conductivitiesMap, wallConditions, emptySpaceConditions, fillingFunction);
+
+                txSetFillColor(TX_BLACK);
+                txClear();
+
+                txDeleteDC(obstaclesMap);
+                txDeleteDC(conductivitiesMap);
+
+            // Building the mesh:
+
+                collectLeaves();
+                buildFaces();
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        QuadtreeField<Real>::~QuadtreeField()
+        {
+            assert(ok());
+
+            alignedFree(nodes_);
+
+            alignedFree(leaves_);
+            alignedFree(temperatures_);
+            alignedFree(changes_);
+            alignedFree(jumps_);
+            alignedFree(inverseAreas_);
+
+            alignedFree(faces_);
+
+            txDeleteDC(image_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        bool QuadtreeField<Real>::ok() const
+        {
+            bool everythingOk = true;
+
+            if (nodes_ == nullptr || nodeCount_ == 0 || nodeCount_ > nodeCapacity_)
+            {
+                everythingOk = false;
+                printf("QuadtreeField::ok(): %d nodes do not fit the node array.", nodeCount_);
+            }
+
+            if (leaves_ == nullptr || temperatures_ == nullptr || changes_ == nullptr || jumps_ == nullptr || inverseAreas_ == nullptr || leafCount_ > leafCapacity_)
+            {
+                everythingOk = false;
+                printf("QuadtreeField::ok(): %d leaves do not fit the leaf arrays.", leafCount_);
+            }
+
+            if (faceCount_ > faceCapacity_)
+            {
+                everythingOk = false;
+                printf("QuadtreeField::ok(): %d faces do not fit the face array.", faceCount_);
+            }
+
+            if (!(timeStep_ > 0))
+            {
+                everythingOk = false;
+                printf("QuadtreeField::ok(): Time step %lg is not positive.", timeStep_);
+            }
+
+            return everythingOk;
+        }
+
+        template <typename Real>
+        double QuadtreeField<Real>::timeStep() const
+        {
+            return timeStep_;
+        }
+
+        template <typename Real>
+        size_t QuadtreeField<Real>::leaves() const
+        {
+            return leafCount_;
+        }
+
+        template <typename Real>
+        size_t QuadtreeField<Real>::nodes() const
+        {
+            return nodeCount_;
+        }
+
+        //----------------------------------------------------------------------------
+        //{ Tree building
+        //----------------------------------------------------------------------------
+
+            // Appends count nodes without children, the array grows by doubling (indices stay valid, pointers do not):
+            template <typename Real>
+            size_t QuadtreeField<Real>::addNodes(const size_t count)
+            {
+                if (nodeCount_ + count > nodeCapacity_)
+                {
+                    size_t capacity = (nodeCapacity_ > 0)? nodeCapacity_ : 64;
+
+                    while (capacity < nodeCount_ + count) capacity *= 2;
+
+                    QuadNode* nodes = (QuadNode*) alignedCalloc(capacity, sizeof(*nodes));
+
+                    if (nodes_ != nullptr) memcpy(nodes, nodes_, nodeCount_ * sizeof(*nodes));
+
+                    alignedFree(nodes_);
+
+                    nodes_        = nodes;
+                    nodeCapacity_ = capacity;
+                }
+
+                const size_t first = nodeCount_;
+
+                for (size_t node = first; node < first + count; node++)
+                {
+                    nodes_[node].children = NO_NODE;
+                    nodes_[node].leaf     = true;
+                    nodes_[node].slot     = NO_NODE;
+                }
+
+                nodeCount_ += count;
+
+                return first;
+            }
+
+            // Builds the subtree of node down to pixels and folds back every four children that are
+            // uniform with equal tiles, conductivities and initial temperatures. The children of a node are
+            // allocated right before their own subtrees, so children without subtrees are the last four nodes:
+            template <typename Real>
+            void QuadtreeField<Real>::buildScene(const size_t node, HDC obstaclesMap, HDC conductivitiesMap, const double wallConditions,
+                                                 const double emptySpaceConditions, double (*fillingFunction) (const unsigned int x, const unsigned int y))
+            {
+                if (nodes_[node].level == 0)
+                {
+                    readPixel(node, obstaclesMap, conductivitiesMap, wallConditions, emptySpaceConditions, fillingFunction);
+
+                    return;
+                }
+
+                const size_t first = addNodes(4);
+                const size_t half  = (size_t) 1 << (nodes_[node].level - 1);
+
+                nodes_[node].children = first;
+                nodes_[node].leaf     = false;
+
+                for (size_t child = 0; child < 4; child++)
+                {
+                    nodes_[first + child].x      = nodes_[node].x + ((child & 2)? half : 0);
+                    nodes_[first + child].y      = nodes_[node].y + ((child & 1)? half : 0);
+                    nodes_[first + child].level  = nodes_[node].level - 1;
+                    nodes_[first + child].parent = node;
+
+                    buildScene(first + child, obstaclesMap, conductivitiesMap, wallConditions, emptySpaceConditions, fillingFunction);
+                }
+
+                // Checking the children:
+
+                    bool uniform  = true;
+                    bool foldable = true;
+
+                    for (size_t child = first; child < first + 4; child++)
+                    {
+                        if (nodes_[child].tile == MIXED_TILE || nodes_[child].tile != nodes_[first].tile ||
+                            nodes_[child].conductivity != nodes_[first].conductivity) uniform = false;
+
+                        if (!nodes_[child].leaf || nodes_[child].temperature != nodes_[first].temperature) foldable = false;
+                    }
+
+                    nodes_[node].tile         = (uniform)? nodes_[first].tile : MIXED_TILE;
+                    nodes_[node].conductivity = (uniform)? nodes_[first].conductivity : 0;
+                    nodes_[node].temperature  = nodes_[first].temperature;
+
+                // Folding:
+
+                    if (uniform && foldable)
+                    {
+                        assert(nodeCount_ == first + 4);
+
+                        nodeCount_ = first;
+
+                        nodes_[node].children = NO_NODE;
+                        nodes_[node].leaf     = true;
+                    }
+            }
+
+            // The pixel as Field's constructor reads it, pixels past the picture are walls:
+            template <typename Real>
+            void QuadtreeField<Real>::readPixel(const size_t node, HDC obstaclesMap, HDC conductivitiesMap, const double wallConditions,
+                                                const double emptySpaceConditions, double (*fillingFunction) (const unsigned int x, const unsigned int y))
+            {
+                const size_t x = nodes_[node].x;
+                const size_t y = nodes_[node].y;
+
+                if (x >= width_ || y >= height_)
+                {
+                    nodes_[node].tile         = WALL_TILE;
+                    nodes_[node].conductivity = 0;
+                    nodes_[node].temperature  = 0;
+
+                    return;
+                }
+
+                COLORREF currentColor = GetPixel(obstaclesMap, x, y);
+
+                unsigned char tile = (currentColor == RGB(  0, 0, 0))?   WALL_TILE :
+                                     (currentColor == RGB(255, 0, 0))? BORDER_TILE :
+                                                                        EMPTY_TILE;
+
+                // The outermost cells have always been fixed:
+                bool edge = (x == 0 || y == 0 || x == width_ - 1 || y == height_ - 1);
+
+                if (edge && tile == EMPTY_TILE) tile = BORDER_TILE;
+
+                nodes_[node].tile         = tile;
+                nodes_[node].conductivity = THERMAL_CONDUCTIVITY_COEFFICIENT * lerp(0.0, 1.0, (double) txExtractColor(GetPixel(conductivitiesMap, x, y), TX_RED) / 255);
+
+                nodes_[node].temperature = (tile ==   WALL_TILE)? 0 :
+                                           (tile == BORDER_TILE)? wallConditions :
+                                           (fillingFunction != nullptr)? fillingFunction(x, y) : emptySpaceConditions;
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+
+        //----------------------------------------------------------------------------
+        //{ Mesh
+        //----------------------------------------------------------------------------
+
+            template <typename Real>
+            inline bool QuadtreeField<Real>::fixed(const size_t node) const
+            {
+                return nodes_[node].tile != EMPTY_TILE || nodes_[node].conductivity <= 0;
+            }
+
+            template <typename Real>
+            size_t QuadtreeField<Real>::findLeaf(const size_t x, const size_t y) const
+            {
+                size_t node = 0;
+
+                while (!nodes_[node].leaf)
+                {
+                    const size_t half = (size_t) 1 << (nodes_[node].level - 1);
+
+                    node = nodes_[node].children + ((x >= nodes_[node].x + half)? 2 : 0) + ((y >= nodes_[node].y + half)? 1 : 0);
+                }
+
+                return node;
+            }
+
+            // Children of a uniform node inherit its scene, all of them start at the parent's temperature
+            // (children kept from an earlier split are reused):
+            template <typename Real>
+            void QuadtreeField<Real>::split(const size_t node)
+            {
+                assert(nodes_[node].leaf);
+                assert(nodes_[node].level > 0 && nodes_[node].tile != MIXED_TILE);
+
+                if (nodes_[node].children == NO_NODE)
+                {
+                    const size_t first = addNodes(4);
+                    const size_t half  = (size_t) 1 << (nodes_[node].level - 1);
+
+                    for (size_t child = 0; child < 4; child++)
+                    {
+                        nodes_[first + child].x            = nodes_[node].x + ((child & 2)? half : 0);
+                        nodes_[first + child].y            = nodes_[node].y + ((child & 1)? half : 0);
+                        nodes_[first + child].level        = nodes_[node].level - 1;
+                        nodes_[first + child].parent       = node;
+                        nodes_[first + child].tile         = nodes_[node].tile;
+                        nodes_[first + child].conductivity = nodes_[node].conductivity;
+                    }
+
+                    nodes_[node].children = first;
+                }
+
+                for (size_t child = nodes_[node].children; child < nodes_[node].children + 4; child++)
+                {
+                    nodes_[child].leaf        = true;
+                    nodes_[child].slot        = NO_NODE;
+                    nodes_[child].temperature = nodes_[node].temperature;
+                }
+
+                nodes_[node].leaf = false;
+            }
+
+            // The children are kept for later splits:
+            template <typename Real>
+            void QuadtreeField<Real>::merge(const size_t node)
+            {
+                assert(!nodes_[node].leaf && nodes_[node].tile != MIXED_TILE);
+
+                Real temperature = 0;
+
+                for (size_t child = nodes_[node].children; child < nodes_[node].children + 4; child++)
+                {
+                    assert(nodes_[child].leaf);
+
+                    temperature += nodes_[child].temperature;
+
+                    nodes_[child].leaf = false;
+                }
+
+                nodes_[node].temperature = temperature / 4;
+                nodes_[node].leaf        = true;
+            }
+
+            template <typename Real>
+            void QuadtreeField<Real>::syncNodes()
+            {
+                for (size_t slot = 0; slot < leafCount_; slot++)
+                {
+                    nodes_[leaves_[slot]].temperature = temperatures_[slot];
+                }
+            }
+
+            // Renumbers the leaves and loads their temperatures from the nodes:
+            template <typename Real>
+            void QuadtreeField<Real>::collectLeaves()
+            {
+                leafCount_ = 0;
+
+                collectLeaves(0);
+
+                for (size_t slot = 0; slot < leafCount_; slot++)
+                {
+                    const size_t node = leaves_[slot];
+                    const size_t side = (size_t) 1 << nodes_[node].level;
+
+                    nodes_[node].slot = slot;
+
+                    temperatures_[slot] = nodes_[node].temperature;
+                    inverseAreas_[slot] = (fixed(node))? 0 : (Real) (1.0 / ((double) side * side));
+                }
+            }
+
+            template <typename Real>
+            void QuadtreeField<Real>::collectLeaves(const size_t node)
+            {
+                if (!nodes_[node].leaf)
+                {
+                    for (size_t child = nodes_[node].children; child < nodes_[node].children + 4; child++) collectLeaves(child);
+
+                    return;
+                }
+
+                if (leafCount_ == leafCapacity_)
+                {
+                    const size_t capacity = (leafCapacity_ > 0)? 2 * leafCapacity_ : 64;
+
+                    size_t* leaves       = (size_t*) alignedCalloc(capacity, sizeof(*leaves));
+                    Real*   temperatures = (Real*)   alignedCalloc(capacity, sizeof(*temperatures));
+                    Real*   changes      = (Real*)   alignedCalloc(capacity, sizeof(*changes));
+                    Real*   jumps        = (Real*)   alignedCalloc(capacity, sizeof(*jumps));
+                    Real*   inverseAreas = (Real*)   alignedCalloc(capacity, sizeof(*inverseAreas));
+
+                    if (leaves_ != nullptr) memcpy(leaves, leaves_, leafCount_ * sizeof(*leaves));
+
+                    alignedFree(leaves_);
+                    alignedFree(temperatures_);
+                    alignedFree(changes_);
+                    alignedFree(jumps_);
+                    alignedFree(inverseAreas_);
+
+                    leaves_       = leaves;
+                    temperatures_ = temperatures;
+                    changes_      = changes;
+                    jumps_        = jumps;
+                    inverseAreas_ = inverseAreas;
+                    leafCapacity_ = capacity;
+                }
+
+                leaves_[leafCount_++] = node;
+            }
+
+            // Every leaf collects the faces on its left and top sides, walking along the side through
+            // the leaves across it, so every face is found once whatever the levels on both sides.
+            // The explicit stability limit of every unknown leaf comes along (changes_ holds the sums):
+            template <typename Real>
+            void QuadtreeField<Real>::buildFaces()
+            {
+                faceCount_ = 0;
+
+                for (size_t slot = 0; slot < leafCount_; slot++) changes_[slot] = 0;
+
+                for (size_t slot = 0; slot < leafCount_; slot++)
+                {
+                    const size_t node = leaves_[slot];
+                    const size_t x    = nodes_[node].x;
+                    const size_t y    = nodes_[node].y;
+                    const size_t side = (size_t) 1 << nodes_[node].level;
+
+                    for (unsigned int horizontal = 0; horizontal < 2; horizontal++)
+                    {
+                        // The left side runs along y, the top one along x:
+                        if ((horizontal)? y == 0 : x == 0) continue;
+
+                        const size_t start = (horizontal)? x : y;
+
+                        for (size_t position = start; position < start + side; )
+                        {
+                            const size_t neighbour = (horizontal)? findLeaf(position, y - 1) : findLeaf(x - 1, position);
+
+                            const size_t neighbourSide  = (size_t) 1 << nodes_[neighbour].level;
+                            const size_t neighbourStart = (horizontal)? nodes_[neighbour].x : nodes_[neighbour].y;
+
+                            const size_t finish = (neighbourStart + neighbourSide < start + side)? neighbourStart + neighbourSide : start + side;
+
+                            addFace(nodes_[neighbour].slot, slot, finish - position, side + neighbourSide);
+
+                            position = finish;
+                        }
+                    }
+                }
+
+                stableTimeStep_ = HUGE_VAL;
+
+                for (size_t slot = 0; slot < leafCount_; slot++)
+                {
+                    if (inverseAreas_[slot] > 0 && changes_[slot] > 0)
+                    {
+                        const double limit = SPACE_STEP * SPACE_STEP / (changes_[slot] * inverseAreas_[slot]);
+
+                        if (limit < stableTimeStep_) stableTimeStep_ = limit;
+                    }
+                }
+
+                timeStep_ = (TIME_STEP < stableTimeStep_)? TIME_STEP : stableTimeStep_;
+            }
+
+            // distance is twice the distance between the centres, in pixels:
+            template <typename Real>
+            void QuadtreeField<Real>::addFace(const size_t first, const size_t second, const size_t length, const size_t distance)
+            {
+                const bool firstUnknown  = inverseAreas_[first]  > 0;
+                const bool secondUnknown = inverseAreas_[second] > 0;
+
+                if (!firstUnknown && !secondUnknown) return;
+
+                const double firstConductivity  = nodes_[leaves_[first]] .conductivity;
+                const double secondConductivity = nodes_[leaves_[second]].conductivity;
+
+                const double conductivity = (firstUnknown && secondUnknown)? (firstConductivity + secondConductivity) / 2 :
+                                            (firstUnknown)?                   firstConductivity : secondConductivity;
+
+                if (faceCount_ == faceCapacity_)
+                {
+                    const size_t capacity = (faceCapacity_ > 0)? 2 * faceCapacity_ : 256;
+
+                    QuadFace* faces = (QuadFace*) alignedCalloc(capacity, sizeof(*faces));
+
+                    if (faces_ != nullptr) memcpy(faces, faces_, faceCount_ * sizeof(*faces));
+
+                    alignedFree(faces_);
+
+                    faces_        = faces;
+                    faceCapacity_ = capacity;
+                }
+
+                QuadFace face = {first, second, (Real) (conductivity * 2 * length / distance)};
+
+                faces_[faceCount_++] = face;
+
+                changes_[first]  += face.conductance;
+                changes_[second] += face.conductance;
+            }
+
+            template <typename Real>
+            void QuadtreeField<Real>::regrid()
+            {
+                // Creating resources:
+
+                    syncNodes();
+
+                    double hottest = 0;
+
+                    for (size_t slot = 0; slot < leafCount_; slot++)
+                    {
+                        jumps_[slot] = 0;
+
+                        if (inverseAreas_[slot] > 0 && fabs(temperatures_[slot]) > hottest) hottest = fabs(temperatures_[slot]);
+                    }
+
+                    for (size_t face = 0; face < faceCount_; face++)
+                    {
+                        const Real jump = fabs(temperatures_[faces_[face].second] - temperatures_[faces_[face].first]);
+
+                        if (jump > jumps_[faces_[face].first])  jumps_[faces_[face].first]  = jump;
+                        if (jump > jumps_[faces_[face].second]) jumps_[faces_[face].second] = jump;
+                    }
+
+                    const double refineJump  = QUADTREE_REFINE_JUMP  * hottest;
+                    const double coarsenJump = QUADTREE_COARSEN_JUMP * hottest;
+
+                // Main algorithm:
+
+                    bool changed = false;
+
+                    for (size_t slot = 0; slot < leafCount_; slot++)
+                    {
+                        const size_t node = leaves_[slot];
+
+                        if (!fixed(node) && nodes_[node].level > 0 && jumps_[slot] > refineJump)
+                        {
+                            split(node);
+
+                            changed = true;
+                        }
+                    }
+
+                    // Fixed leaves count as jumpless when they hold the same temperature, so walls and borders
+                    // coarsen wherever the scene allows:
+
+                    for (size_t slot = 0; slot < leafCount_; slot++)
+                    {
+                        const size_t parent = nodes_[leaves_[slot]].parent;
+
+                        if (parent == NO_NODE || nodes_[parent].leaf || nodes_[parent].tile == MIXED_TILE) continue;
+
+                        bool coarsen = true;
+
+                        for (size_t child = nodes_[parent].children; child < nodes_[parent].children + 4; child++)
+                        {
+                            // Leaves split right above have no slot yet:
+                            if (!nodes_[child].leaf || nodes_[child].slot == NO_NODE) coarsen = false;
+
+                            else if (fixed(child)? nodes_[child].temperature != nodes_[nodes_[parent].children].temperature :
+                                                   jumps_[nodes_[child].slot] > coarsenJump) coarsen = false;
+                        }
+
+                        if (coarsen)
+                        {
+                            merge(parent);
+
+                            changed = true;
+                        }
+                    }
+
+                    if (changed)
+                    {
+                        collectLeaves();
+                        buildFaces();
+                    }
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+
+        //----------------------------------------------------------------------------
+        //{ Setting conditions
+        //----------------------------------------------------------------------------
+
+            // The same disk as Field::adjustTemperature(), at pixel size. Once the disk is refined
+            // the temperatures are changed in place, without rebuilding the mesh:
+            template <typename Real>
+            void QuadtreeField<Real>::adjustTemperature(const unsigned int roundX, const unsigned int roundY, const unsigned int radius, const double deltaTemperature)
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                // Creating resources:
+
+                    unsigned int startX = (roundX < radius)? 0 : roundX - radius;
+                    unsigned int startY = (roundY < radius)? 0 : roundY - radius;
+
+                    unsigned int finishX = (roundX + radius <  width_)? roundX + radius :  width_ - 1;
+                    unsigned int finishY = (roundY + radius < height_)? roundY + radius : height_ - 1;
+
+                // Main algorithm:
+
+                    bool changed = false;
+
+                    for (size_t x = startX; x < finishX; x++)
+                    {
+                        for (size_t y = startY; y < finishY; y++)
+                        {
+                            if (pow((signed) roundX - (signed) x, 2) + pow((signed) roundY - (signed) y, 2) >= pow(radius, 2)) continue;
+
+                            size_t node = findLeaf(x, y);
+
+                            if (nodes_[node].tile != EMPTY_TILE) continue;
+
+                            // The first split moves the temperatures to the nodes until the mesh is rebuilt:
+
+                                if (nodes_[node].level > 0 && !changed)
+                                {
+                                    syncNodes();
+
+                                    changed = true;
+                                }
+
+                                while (nodes_[node].level > 0)
+                                {
+                                    split(node);
+
+                                    node = findLeaf(x, y);
+                                }
+
+                            Real& temperature = (changed)? nodes_[node].temperature : temperatures_[nodes_[node].slot];
+
+                            if  (temperature + deltaTemperature < 0) temperature = 0;
+                            else temperature += deltaTemperature;
+                        }
+                    }
+
+                    if (changed)
+                    {
+                        collectLeaves();
+                        buildFaces();
+                    }
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+
+        //----------------------------------------------------------------------------
+        //{ Calculations
+        //----------------------------------------------------------------------------
+
+            template <typename Real>
+            void QuadtreeField<Real>::calculate()
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                // Regridding:
+
+                    if (steps_++ % QUADTREE_REGRID_INTERVAL == 0) regrid();
+
+                // Main algorithm (flux * weight leaves one side and enters the other):
+
+                    const Real weight = (Real) (timeStep_ / (SPACE_STEP * SPACE_STEP));
+
+                    memset(changes_, 0, leafCount_ * sizeof(*changes_));
+
+                    for (size_t face = 0; face < faceCount_; face++)
+                    {
+                        const size_t first  = faces_[face].first;
+                        const size_t second = faces_[face].second;
+
+                        const Real flux = faces_[face].conductance * (temperatures_[second] - temperatures_[first]);
+
+                        changes_[first]  += flux;
+                        changes_[second] -= flux;
+                    }
+
+                    for (size_t slot = 0; slot < leafCount_; slot++)
+                    {
+                        temperatures_[slot] += weight * changes_[slot] * inverseAreas_[slot];
+                    }
+
+                // Checking output:
+
+                    assert(ok());
+            }
+
+            template <typename Real>
+            void QuadtreeField<Real>::calculate(const unsigned int steps)
+            {
+                for (unsigned int step = 0; step < steps; step++) calculate();
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+
+        //----------------------------------------------------------------------------
+        //{ Rendering
+        //----------------------------------------------------------------------------
+
+            // Every leaf paints its pixels at full resolution, with the grid the pixels on
+            // its right and bottom edges keep the gap:
+            template <typename Real>
+            void QuadtreeField<Real>::render(const unsigned int zoom /*= 1*/, bool grid /*= false*/) const
+            {
+                // Checking input:
+
+                    assert(ok());
+
+                // Main algorithm:
+
+                    txSetFillColor (TX_BLACK);
+                    txClear();
+
+                    for (size_t slot = 0; slot < leafCount_; slot++)
+                    {
+                        const QuadNode& node = nodes_[leaves_[slot]];
+
+                        const size_t side = (size_t) 1 << node.level;
+
+                        const size_t finishX = (node.x + side <  width_)? node.x + side :  width_;
+                        const size_t finishY = (node.y + side < height_)? node.y + side : height_;
+
+                        for (size_t x = node.x; x < finishX; x++)
+                        {
+                            for (size_t y = node.y; y < finishY; y++)
+                            {
+                                COLORREF currentColor = colorLerp(log(log(temperatures_[slot] + 1) + 1), GetPixel(image_, x, y), MID_COLOR, WARM_COLOR);
+
+                                if (zoom >= 3)
+                                {
+                                    txSetColor    (currentColor);
+                                    txSetFillColor(currentColor);
+
+                                    txRectangle(x * zoom, y * zoom, (x + 1) * zoom - (int) (grid && x + 1 == node.x + side),
+                                                                    (y + 1) * zoom - (int) (grid && y + 1 == node.y + side));
+                                }
+                                else
+                                {
+                                    txSetPixel(x * zoom, y * zoom, currentColor);
+                                }
+                            }
+                        }
+                    }
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
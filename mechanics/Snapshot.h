@@ -0,0 +1,586 @@
+#pragma once
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    const char         SNAPSHOT_SIGNATURE[8] = "HEATSNP";
+    const unsigned int SNAPSHOT_VERSION      = 1;
+
+    // Columns of a chunk, the unit coded independently and given to a worker:
+    const size_t SNAPSHOT_CHUNK_COLUMNS = 32;
+
+    // Residuals of more than this many error steps are stored as they are:
+    const long long SNAPSHOT_QUANT_LIMIT = 1 << 30;
+
+    // A Rice code whose unary part reaches this length is an escape:
+    const unsigned int SNAPSHOT_ESCAPE = 24;
+
+    // Residuals counted before the Rice parameter's running mean is halved:
+    const unsigned int SNAPSHOT_ADAPTATION = 64;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Snapshot
+//----------------------------------------------------------------------------
+
+    // Error-bounded lossy snapshots of a grid (SZ-like): every cell is predicted from its already
+    // reconstructed left, upper and upper left neighbours (the Lorenzo predictor, exact for planes),
+    // the residual is quantized in steps of twice the error bound, so the cell comes back within
+    // the bound, and the steps are Rice coded with a parameter following their running mean.
+    // Smooth temperatures leave residuals of a step or none, one to three bits a cell.
+    //
+    // Residuals beyond SNAPSHOT_QUANT_LIMIT steps, or cells the rounding to Real would carry
+    // past the bound, escape to the exact value, so the bound holds for every cell.
+    //
+    // Chunks of SNAPSHOT_CHUNK_COLUMNS columns are predicted and coded independently, so the
+    // workers of a pool take them in parallel; the file is a header, the chunk sizes and the chunks.
+
+    template <typename Real>
+    class Snapshot
+    {
+        public:
+
+            // Constructor && destructor:
+
+                explicit Snapshot(const GridLayout& grid);
+
+                ~Snapshot();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Files (pool may be nullptr, the calling thread codes every chunk then):
+
+                    // The cells (not ghosts) of temperatures within errorBound > 0,
+                    // returns the size of the file in bytes:
+                    size_t save(const char* fileName, const Real* temperatures, const double errorBound, ThreadPool* pool);
+
+                    // A file save() wrote for a grid of this size into the cells of temperatures:
+                    void load(const char* fileName, Real* temperatures, ThreadPool* pool);
+
+        private:
+
+            struct SnapshotHeader
+            {
+                char               signature[8];
+                unsigned int       version;
+                unsigned int       cellSize;
+                unsigned long long width;
+                unsigned long long height;
+                unsigned long long chunkColumns;
+                double             errorBound;
+            };
+
+            // Bits are appended from the lowest one of each byte up:
+            struct BitStream
+            {
+                unsigned char*     data;
+                size_t             size;
+                size_t             capacity;
+                unsigned long long buffer;
+                unsigned int       bits;
+            };
+
+            GridLayout grid_;
+
+            size_t chunks_;
+
+            BitStream* streams_;
+
+            // Reconstructed columns (the one before and the current one) of every chunk:
+            double* columns_;
+
+            // Of the running save() or load():
+            const Real* source_;
+            Real*       target_;
+            double      errorBound_;
+
+            void compressChunk  (const size_t chunk);
+            void decompressChunk(const size_t chunk);
+
+            static void compressTask  (void* snapshot, const unsigned int worker, const unsigned int workers);
+            static void decompressTask(void* snapshot, const unsigned int worker, const unsigned int workers);
+
+            static inline void put(BitStream* stream, const unsigned long long value, const unsigned int count);
+            static inline unsigned long long get(BitStream* stream, const unsigned int count);
+
+            // Rice parameter of the running mean:
+            static inline unsigned int riceParameter(const unsigned long long sum, const unsigned long long count);
+
+            Snapshot(const Snapshot&);
+            Snapshot& operator=(const Snapshot&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        Snapshot<Real>::Snapshot(const GridLayout& grid) :
+            grid_       (grid),
+            chunks_     ((grid.width + SNAPSHOT_CHUNK_COLUMNS - 1) / SNAPSHOT_CHUNK_COLUMNS),
+            streams_    (nullptr),
+            columns_    (nullptr),
+            source_     (nullptr),
+            target_     (nullptr),
+            errorBound_ (0)
+        {
+            // Creating arrays (streams grow as they are written):
+
+                streams_ = (BitStream*) calloc(chunks_, sizeof(*streams_));
+                assert(streams_);
+
+                columns_ = (double*) alignedCalloc(chunks_ * 2 * grid_.height, sizeof(*columns_));
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        Snapshot<Real>::~Snapshot()
+        {
+            assert(ok());
+
+            for (size_t chunk = 0; chunk < chunks_; chunk++) free(streams_[chunk].data);
+
+            free(streams_);
+            alignedFree(columns_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        bool Snapshot<Real>::ok() const
+        {
+            bool everythingOk = true;
+
+            if (streams_ == nullptr || columns_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Snapshot::ok(): Arrays are null pointers.");
+            }
+
+            if (chunks_ * SNAPSHOT_CHUNK_COLUMNS < grid_.width)
+            {
+                everythingOk = false;
+                printf("Snapshot::ok(): %d chunks do not cover %d columns.", chunks_, grid_.width);
+            }
+
+            return everythingOk;
+        }
+
+        //----------------------------------------------------------------------------
+        //{ Bits
+        //----------------------------------------------------------------------------
+
+            // count <= 32:
+            template <typename Real>
+            inline void Snapshot<Real>::put(BitStream* stream, const unsigned long long value, const unsigned int count)
+            {
+                stream->buffer |= (value & ((1ull << count) - 1)) << stream->bits;
+                stream->bits   += count;
+
+                while (stream->bits >= 8)
+                {
+                    if (stream->size == stream->capacity)
+                    {
+                        stream->capacity = std::max((size_t) 4096, 2 * stream->capacity);
+                        stream->data     = (unsigned char*) realloc(stream->data, stream->capacity);
+                        assert(stream->data);
+                    }
+
+                    stream->data[stream->size++] = (unsigned char) stream->buffer;
+
+                    stream->buffer >>= 8;
+                    stream->bits    -= 8;
+                }
+            }
+
+            // count <= 32, size counts the bytes already taken into the buffer:
+            template <typename Real>
+            inline unsigned long long Snapshot<Real>::get(BitStream* stream, const unsigned int count)
+            {
+                while (stream->bits < count)
+                {
+                    const unsigned long long byte = (stream->size < stream->capacity)? stream->data[stream->size] : 0;
+
+                    stream->buffer |= byte << stream->bits;
+                    stream->bits   += 8;
+                    stream->size++;
+                }
+
+                const unsigned long long value = stream->buffer & ((1ull << count) - 1);
+
+                stream->buffer >>= count;
+                stream->bits    -= count;
+
+                return value;
+            }
+
+            template <typename Real>
+            inline unsigned int Snapshot<Real>::riceParameter(const unsigned long long sum, const unsigned long long count)
+            {
+                unsigned int parameter = 0;
+
+                while (parameter < 31 && (count << parameter) < sum) parameter++;
+
+                return parameter;
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+        //----------------------------------------------------------------------------
+        //{ Coding
+        //----------------------------------------------------------------------------
+
+            // Residual q in steps travels as the zigzag u = 2q or -2q - 1, as u >> k ones, a zero
+            // and the k low bits of u; SNAPSHOT_ESCAPE ones instead are followed by 0 and u in
+            // 32 bits or by 1 and the bits of the exact value:
+            template <typename Real>
+            void Snapshot<Real>::compressChunk(const size_t chunk)
+            {
+                BitStream* stream = &streams_[chunk];
+
+                stream->size   = 0;
+                stream->buffer = 0;
+                stream->bits   = 0;
+
+                const size_t startX  = chunk * SNAPSHOT_CHUNK_COLUMNS;
+                const size_t finishX = std::min(startX + SNAPSHOT_CHUNK_COLUMNS, grid_.width);
+
+                const size_t height = grid_.height;
+
+                // Nothing lies left of a chunk:
+                double* previous = columns_ + chunk * 2 * height;
+                double* current  = previous + height;
+
+                memset(previous, 0, height * sizeof(*previous));
+
+                const double step = 2 * errorBound_;
+
+                unsigned long long sum   = 1;
+                unsigned long long count = 1;
+
+                for (size_t x = startX; x < finishX; x++)
+                {
+                    const Real* column = source_ + grid_.index(x, 0);
+
+                    for (size_t y = 0; y < height; y++)
+                    {
+                        const double prediction = (y > 0)? previous[y] + current[y - 1] - previous[y - 1] : previous[y];
+
+                        const double value    = column[y];
+                        const double quotient = (value - prediction) / step;
+
+                        const unsigned int parameter = riceParameter(sum, count);
+
+                        bool exact = !(fabs(quotient) < (double) SNAPSHOT_QUANT_LIMIT);
+
+                        long long quantized = 0;
+
+                        if (!exact)
+                        {
+                            // Rounding to Real may still carry the cell past the bound:
+                            quantized = llround(quotient);
+                            exact     = fabs((double) (Real) (prediction + (double) quantized * step) - value) > errorBound_;
+                        }
+
+                        unsigned long long residual = 0;
+
+                        if (exact)
+                        {
+                            Real raw = column[y];
+
+                            unsigned long long rawBits = 0;
+                            memcpy(&rawBits, &raw, sizeof(raw));
+
+                            put(stream, (1ull << SNAPSHOT_ESCAPE) - 1, SNAPSHOT_ESCAPE);
+                            put(stream, 1, 1);
+
+                            for (unsigned int bit = 0; bit < 8 * sizeof(Real); bit += 32) put(stream, rawBits >> bit, 32);
+
+                            current[y] = value;
+                            residual   = (unsigned long long) SNAPSHOT_ESCAPE << parameter;
+                        }
+                        else
+                        {
+                            residual = (quantized >= 0)? 2 * (unsigned long long) quantized : 2 * (unsigned long long) (-quantized) - 1;
+
+                            if ((residual >> parameter) < SNAPSHOT_ESCAPE)
+                            {
+                                const unsigned int ones = (unsigned int) (residual >> parameter);
+
+                                put(stream, (1ull << ones) - 1, ones + 1);
+                                put(stream, residual, parameter);
+                            }
+                            else
+                            {
+                                put(stream, (1ull << SNAPSHOT_ESCAPE) - 1, SNAPSHOT_ESCAPE);
+                                put(stream, 0, 1);
+                                put(stream, residual, 32);
+                            }
+
+                            current[y] = (Real) (prediction + (double) quantized * step);
+                        }
+
+                        sum   += residual;
+                        count += 1;
+
+                        if (count == SNAPSHOT_ADAPTATION)
+                        {
+                            sum   = (sum + 1) / 2;
+                            count = count / 2;
+                        }
+                    }
+
+                    double* swap = previous;
+
+                    previous = current;
+                    current  = swap;
+                }
+
+                // The last byte:
+                put(stream, 0, 7);
+            }
+
+            template <typename Real>
+            void Snapshot<Real>::decompressChunk(const size_t chunk)
+            {
+                BitStream* stream = &streams_[chunk];
+
+                stream->size   = 0;
+                stream->buffer = 0;
+                stream->bits   = 0;
+
+                const size_t startX  = chunk * SNAPSHOT_CHUNK_COLUMNS;
+                const size_t finishX = std::min(startX + SNAPSHOT_CHUNK_COLUMNS, grid_.width);
+
+                const size_t height = grid_.height;
+
+                double* previous = columns_ + chunk * 2 * height;
+                double* current  = previous + height;
+
+                memset(previous, 0, height * sizeof(*previous));
+
+                const double step = 2 * errorBound_;
+
+                unsigned long long sum   = 1;
+                unsigned long long count = 1;
+
+                for (size_t x = startX; x < finishX; x++)
+                {
+                    Real* column = target_ + grid_.index(x, 0);
+
+                    for (size_t y = 0; y < height; y++)
+                    {
+                        const double prediction = (y > 0)? previous[y] + current[y - 1] - previous[y - 1] : previous[y];
+
+                        const unsigned int parameter = riceParameter(sum, count);
+
+                        unsigned int ones = 0;
+
+                        while (ones < SNAPSHOT_ESCAPE && get(stream, 1) == 1) ones++;
+
+                        unsigned long long residual = 0;
+
+                        if (ones == SNAPSHOT_ESCAPE && get(stream, 1) == 1)
+                        {
+                            unsigned long long rawBits = 0;
+
+                            for (unsigned int bit = 0; bit < 8 * sizeof(Real); bit += 32) rawBits |= get(stream, 32) << bit;
+
+                            Real raw = 0;
+                            memcpy(&raw, &rawBits, sizeof(raw));
+
+                            column [y] = raw;
+                            current[y] = raw;
+                            residual   = (unsigned long long) SNAPSHOT_ESCAPE << parameter;
+                        }
+                        else
+                        {
+                            residual = (ones == SNAPSHOT_ESCAPE)? get(stream, 32) : ((unsigned long long) ones << parameter) | get(stream, parameter);
+
+                            const long long quantized = (residual & 1)? -(long long) ((residual + 1) / 2) : (long long) (residual / 2);
+
+                            column [y] = (Real) (prediction + (double) quantized * step);
+                            current[y] = column[y];
+                        }
+
+                        sum   += residual;
+                        count += 1;
+
+                        if (count == SNAPSHOT_ADAPTATION)
+                        {
+                            sum   = (sum + 1) / 2;
+                            count = count / 2;
+                        }
+                    }
+
+                    double* swap = previous;
+
+                    previous = current;
+                    current  = swap;
+                }
+            }
+
+            template <typename Real>
+            void Snapshot<Real>::compressTask(void* snapshot, const unsigned int worker, const unsigned int workers)
+            {
+                Snapshot* self = (Snapshot*) snapshot;
+
+                for (size_t chunk = worker; chunk < self->chunks_; chunk += workers) self->compressChunk(chunk);
+            }
+
+            template <typename Real>
+            void Snapshot<Real>::decompressTask(void* snapshot, const unsigned int worker, const unsigned int workers)
+            {
+                Snapshot* self = (Snapshot*) snapshot;
+
+                for (size_t chunk = worker; chunk < self->chunks_; chunk += workers) self->decompressChunk(chunk);
+            }
+
+        //}
+        //----------------------------------------------------------------------------
+
+        template <typename Real>
+        size_t Snapshot<Real>::save(const char* fileName, const Real* temperatures, const double errorBound, ThreadPool* pool)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(fileName != nullptr && temperatures != nullptr);
+                assert(errorBound > 0);
+
+            // Coding chunks:
+
+                source_     = temperatures;
+                errorBound_ = errorBound;
+
+                if (pool != nullptr) pool->run(compressTask, this);
+                else                 compressTask(this, 0, 1);
+
+            // Writing file:
+
+                SnapshotHeader header = {};
+
+                memcpy(header.signature, SNAPSHOT_SIGNATURE, sizeof(header.signature));
+
+                header.version      = SNAPSHOT_VERSION;
+                header.cellSize     = sizeof(Real);
+                header.width        = grid_.width;
+                header.height       = grid_.height;
+                header.chunkColumns = SNAPSHOT_CHUNK_COLUMNS;
+                header.errorBound   = errorBound;
+
+                FILE* file = fopen(fileName, "wb");
+                assert(file);
+
+                bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+                size_t bytes = sizeof(header);
+
+                for (size_t chunk = 0; written && chunk < chunks_; chunk++)
+                {
+                    const unsigned long long size = streams_[chunk].size;
+
+                    written = fwrite(&size, sizeof(size), 1, file) == 1;
+                    bytes  += sizeof(size);
+                }
+
+                for (size_t chunk = 0; written && chunk < chunks_; chunk++)
+                {
+                    written = fwrite(streams_[chunk].data, 1, streams_[chunk].size, file) == streams_[chunk].size;
+                    bytes  += streams_[chunk].size;
+                }
+
+                written = (fclose(file) == 0) && written;
+
+                if (!written) printf("Snapshot::save(): Could not write %s.", fileName);
+                assert(written);
+
+                return bytes;
+        }
+
+        template <typename Real>
+        void Snapshot<Real>::load(const char* fileName, Real* temperatures, ThreadPool* pool)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(fileName != nullptr && temperatures != nullptr);
+
+            // Reading file:
+
+                FILE* file = fopen(fileName, "rb");
+                assert(file);
+
+                SnapshotHeader header = {};
+
+                bool read = fread(&header, sizeof(header), 1, file) == 1;
+
+                const bool valid = read && memcmp(header.signature, SNAPSHOT_SIGNATURE, sizeof(header.signature)) == 0 &&
+                                   header.version == SNAPSHOT_VERSION && header.cellSize == sizeof(Real) &&
+                                   header.width == grid_.width && header.height == grid_.height && header.chunkColumns == SNAPSHOT_CHUNK_COLUMNS;
+
+                if (!valid) printf("Snapshot::load(): %s is no version %d snapshot of %dx%d cells of %d bytes.", fileName, SNAPSHOT_VERSION, grid_.width, grid_.height, sizeof(Real));
+                assert(valid);
+
+                for (size_t chunk = 0; read && chunk < chunks_; chunk++)
+                {
+                    unsigned long long size = 0;
+
+                    read = fread(&size, sizeof(size), 1, file) == 1;
+
+                    BitStream* stream = &streams_[chunk];
+
+                    if (stream->capacity < size)
+                    {
+                        stream->data = (unsigned char*) realloc(stream->data, (size_t) size);
+                        assert(stream->data);
+                    }
+
+                    // Reading stops at the capacity, see get():
+                    stream->capacity = (size_t) size;
+                }
+
+                for (size_t chunk = 0; read && chunk < chunks_; chunk++)
+                {
+                    read = fread(streams_[chunk].data, 1, streams_[chunk].capacity, file) == streams_[chunk].capacity;
+                }
+
+                fclose(file);
+
+                if (!read) printf("Snapshot::load(): %s is cut short.", fileName);
+                assert(read);
+
+            // Decoding chunks:
+
+                target_     = temperatures;
+                errorBound_ = header.errorBound;
+
+                if (pool != nullptr) pool->run(decompressTask, this);
+                else                 decompressTask(this, 0, 1);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
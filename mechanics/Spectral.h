@@ -0,0 +1,584 @@
+#pragma once
+
+#include <complex>
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // A length below 2^32 has at most this many prime factors:
+    const unsigned int FFT_MAX_FACTORS = 32;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Fft
+//----------------------------------------------------------------------------
+
+    // Mixed-radix Cooley-Tukey transform of any length, split into its prime factors smallest first.
+    // Factors of 2 have their own butterfly, any other prime p a generic one of p^2 multiplications,
+    // so a length with a large prime factor works but costs length * p.
+
+    class Fft
+    {
+        public:
+
+            typedef std::complex<double> Complex;
+
+            // Constructor && destructor:
+
+                explicit Fft(const size_t length);
+
+                ~Fft();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Transform:
+
+                    size_t length() const;
+
+                    // spectrum[k] = sum of line[j] e^(-2 pi i jk / length); scratch holds length values:
+                    void transform(const Complex* line, Complex* spectrum, Complex* scratch) const;
+
+        private:
+
+            size_t length_;
+
+            size_t       factors_[FFT_MAX_FACTORS];
+            unsigned int factorCount_;
+
+            // e^(-2 pi i k / length):
+            Complex* twiddles_;
+
+            void work(Complex* output, const Complex* input, const size_t stride, const unsigned int factor, Complex* scratch) const;
+
+            // Plain product, without the checks for infinities of std::complex's operator*:
+            static inline Complex multiply(const Complex& a, const Complex& b);
+
+            Fft(const Fft&);
+            Fft& operator=(const Fft&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        Fft::Fft(const size_t length) :
+            length_      (length),
+            factors_     (),
+            factorCount_ (0),
+            twiddles_    (nullptr)
+        {
+            // Checking input:
+
+                assert(length >= 1);
+
+            // Factoring:
+
+                size_t rest = length_;
+
+                for (size_t p = 2; rest > 1; p++)
+                {
+                    if (p * p > rest) p = rest;
+
+                    while (rest % p == 0)
+                    {
+                        factors_[factorCount_++] = p;
+                        rest /= p;
+                    }
+                }
+
+            // Creating twiddles:
+
+                twiddles_ = (Complex*) calloc(length_, sizeof(*twiddles_));
+                assert(twiddles_);
+
+                for (size_t k = 0; k < length_; k++)
+                {
+                    twiddles_[k] = std::polar(1.0, -2 * M_PI * k / length_);
+                }
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        Fft::~Fft()
+        {
+            assert(ok());
+
+            free(twiddles_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        bool Fft::ok() const
+        {
+            bool everythingOk = true;
+
+            if (twiddles_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Fft::ok(): Twiddles are a null pointer.");
+            }
+
+            size_t product = 1;
+
+            for (unsigned int factor = 0; factor < factorCount_; factor++) product *= factors_[factor];
+
+            if (product != length_)
+            {
+                everythingOk = false;
+                printf("Fft::ok(): Factors do not multiply to length %d.", length_);
+            }
+
+            return everythingOk;
+        }
+
+        size_t Fft::length() const
+        {
+            return length_;
+        }
+
+        void Fft::transform(const Complex* line, Complex* spectrum, Complex* scratch) const
+        {
+            assert(line && spectrum && scratch);
+            assert(line != spectrum);
+
+            if (factorCount_ == 0) spectrum[0] = line[0];
+            else                   work(spectrum, line, 1, 0, scratch);
+        }
+
+        inline Fft::Complex Fft::multiply(const Complex& a, const Complex& b)
+        {
+            return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+        }
+
+        // Decimation in time: the p interleaved subsequences of the input (every stride * p-th value)
+        // are transformed into consecutive blocks of m = n / p, then combined by radix-p butterflies:
+        void Fft::work(Complex* output, const Complex* input, const size_t stride, const unsigned int factor, Complex* scratch) const
+        {
+            const size_t p = factors_[factor];
+            const size_t m = length_ / stride / p;
+
+            for (size_t j = 0; j < p; j++)
+            {
+                if (m == 1) output[j] = input[j * stride];
+                else        work(output + j * m, input + j * stride, stride * p, factor + 1, scratch);
+            }
+
+            if (p == 2)
+            {
+                for (size_t u = 0; u < m; u++)
+                {
+                    const Complex product = multiply(output[u + m], twiddles_[u * stride]);
+
+                    output[u + m]  = output[u] - product;
+                    output[u]     += product;
+                }
+
+                return;
+            }
+
+            for (size_t u = 0; u < m; u++)
+            {
+                for (size_t q = 0; q < p; q++) scratch[q] = output[u + q * m];
+
+                for (size_t q = 0; q < p; q++)
+                {
+                    const size_t k = u + q * m;
+
+                    Complex sum = scratch[0];
+
+                    // stride * k < stride * p * m = length, so one subtraction keeps the index in range:
+                    size_t twiddle = 0;
+
+                    for (size_t r = 1; r < p; r++)
+                    {
+                        twiddle += stride * k;
+                        if (twiddle >= length_) twiddle -= length_;
+
+                        sum += multiply(scratch[r], twiddles_[twiddle]);
+                    }
+
+                    output[k] = sum;
+                }
+            }
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Spectral
+//----------------------------------------------------------------------------
+
+    // Exact solution of dT/dt = rate * lap T on the cells inside the outer frame, the frame holding
+    // its temperatures. The 5-point Laplacian with fixed neighbours is diagonal in the sine basis
+    // sin(pi j x / (columns + 1)) sin(pi k y / (rows + 1)), with eigenvalues
+    //     lambda = -rate (4 sin^2(pi j / (2 (columns + 1))) + 4 sin^2(pi k / (2 (rows + 1)))),
+    // and the frame only adds a constant source f (rate times the frame cells next to a cell), so
+    //     u(t) = u(0) e^(lambda t) + f (e^(lambda t) - 1) / lambda
+    // for every coefficient. A step of any length costs one sine transform forwards and one back.
+    //
+    // A sine transform of n values is an FFT of their odd extension of 2 (n + 1) values, whose
+    // spectrum is -2i times the sine coefficients. Two real lines share one complex FFT, one as
+    // the real part and one as the imaginary one: the temperatures and sources of a column
+    // on the way in, two columns on the way out.
+
+    template <typename Real>
+    class Spectral
+    {
+        public:
+
+            // Constructor && destructor:
+
+                explicit Spectral(const GridLayout& grid);
+
+                ~Spectral();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Stepping:
+
+                    // The cells inside the frame of temperatures are advanced by time, split between the workers of pool:
+                    void advance(Real* temperatures, const double rate, const double time, ThreadPool* pool);
+
+        private:
+
+            struct Sweep
+            {
+                Spectral*   spectral;
+                Real*       temperatures;
+                double      rate;
+                double      time;
+                ThreadPool* pool;
+            };
+
+            GridLayout grid_;
+
+            // Cells inside the frame:
+            size_t columns_;
+            size_t rows_;
+
+            // Along y (2 (rows_ + 1)) and along x (2 (columns_ + 1)):
+            Fft columnFft_;
+            Fft rowFft_;
+
+            // Coefficients of the temperatures and of the frame's sources, column after column
+            // (x * rows_ + y), sine coefficients along y after the first pass and along both after the second:
+            double* coefficients_;
+            double* sources_;
+
+            // Line, spectrum and scratch of every worker:
+            Fft::Complex* lines_;
+            size_t        lineLength_;
+            unsigned int  lineWorkers_;
+
+            // The odd extension of real + i imaginary (n values at stride) into line:
+            static void extend(Fft::Complex* line, const double* real, const double* imaginary, const size_t n, const size_t stride);
+
+            void forwardColumn (const Real* temperatures, const double rate, const size_t x, Fft::Complex* lines);
+            void evolveRows    (const double rate, const double time, const size_t row, Fft::Complex* lines);
+            void inverseColumns(Real* temperatures, const size_t x, Fft::Complex* lines);
+
+            static void sweepTask(void* sweep, const unsigned int worker, const unsigned int workers);
+
+            Spectral(const Spectral&);
+            Spectral& operator=(const Spectral&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        Spectral<Real>::Spectral(const GridLayout& grid) :
+            grid_         (grid),
+            columns_      (grid.width  - 2),
+            rows_         (grid.height - 2),
+            columnFft_    (2 * (grid.height - 1)),
+            rowFft_       (2 * (grid.width  - 1)),
+            coefficients_ (nullptr),
+            sources_      (nullptr),
+            lines_        (nullptr),
+            lineLength_   (2 * (std::max(grid.width, grid.height) - 1)),
+            lineWorkers_  (0)
+        {
+            // Checking input:
+
+                assert(grid.width > 2 && grid.height > 2);
+
+            // Creating arrays:
+
+                coefficients_ = (double*) alignedCalloc(columns_ * rows_, sizeof(double));
+                sources_      = (double*) alignedCalloc(columns_ * rows_, sizeof(double));
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        Spectral<Real>::~Spectral()
+        {
+            assert(ok());
+
+            alignedFree(coefficients_);
+            alignedFree(sources_);
+
+            free(lines_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        bool Spectral<Real>::ok() const
+        {
+            bool everythingOk = true;
+
+            if (coefficients_ == nullptr || sources_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Spectral::ok(): Coefficient arrays are null pointers.");
+            }
+
+            if (!columnFft_.ok() || !rowFft_.ok())
+            {
+                everythingOk = false;
+                printf("Spectral::ok(): Transforms are invalid.");
+            }
+
+            return everythingOk;
+        }
+
+        template <typename Real>
+        void Spectral<Real>::advance(Real* temperatures, const double rate, const double time, ThreadPool* pool)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(temperatures);
+
+                assert(rate > 0);
+                assert(time >= 0);
+
+            // Creating resources:
+
+                const unsigned int workers = (pool != nullptr)? pool->size() : 1;
+
+                if (workers > lineWorkers_)
+                {
+                    free(lines_);
+
+                    lineWorkers_ = workers;
+                    lines_       = (Fft::Complex*) calloc(lineWorkers_ * 3 * lineLength_, sizeof(*lines_));
+
+                    assert(lines_);
+                }
+
+            // Main algorithm:
+
+                Sweep sweep = {this, temperatures, rate, time, pool};
+
+                if (pool != nullptr) pool->run(sweepTask, &sweep);
+                else                 sweepTask(&sweep, 0, 1);
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        // Columns, rows and columns again, each pass reading what the previous one wrote for other workers:
+        template <typename Real>
+        void Spectral<Real>::sweepTask(void* sweep, const unsigned int worker, const unsigned int workers)
+        {
+            Sweep*    spectralSweep = (Sweep*) sweep;
+            Spectral* self          = spectralSweep->spectral;
+
+            Fft::Complex* lines = self->lines_ + worker * 3 * self->lineLength_;
+
+            const size_t columns = self->columns_;
+            const size_t rowPairs    = (self->rows_    + 1) / 2;
+            const size_t columnPairs = (self->columns_ + 1) / 2;
+
+            for (size_t x = columns * worker / workers; x < columns * (worker + 1) / workers; x++)
+            {
+                self->forwardColumn(spectralSweep->temperatures, spectralSweep->rate, x, lines);
+            }
+
+            if (spectralSweep->pool != nullptr) spectralSweep->pool->barrier();
+
+            for (size_t pair = rowPairs * worker / workers; pair < rowPairs * (worker + 1) / workers; pair++)
+            {
+                self->evolveRows(spectralSweep->rate, spectralSweep->time, 2 * pair, lines);
+            }
+
+            if (spectralSweep->pool != nullptr) spectralSweep->pool->barrier();
+
+            for (size_t pair = columnPairs * worker / workers; pair < columnPairs * (worker + 1) / workers; pair++)
+            {
+                self->inverseColumns(spectralSweep->temperatures, 2 * pair, lines);
+            }
+        }
+
+        template <typename Real>
+        void Spectral<Real>::extend(Fft::Complex* line, const double* real, const double* imaginary, const size_t n, const size_t stride)
+        {
+            line[0]     = 0;
+            line[n + 1] = 0;
+
+            for (size_t j = 0; j < n; j++)
+            {
+                const Fft::Complex value(real[j * stride], (imaginary != nullptr)? imaginary[j * stride] : 0);
+
+                line[j + 1]         =  value;
+                line[2 * n + 1 - j] = -value;
+            }
+        }
+
+        // Sine coefficients along y of inner column x and of the heat its frame neighbours feed in:
+        template <typename Real>
+        void Spectral<Real>::forwardColumn(const Real* temperatures, const double rate, const size_t x, Fft::Complex* lines)
+        {
+            double* values  = coefficients_ + x * rows_;
+            double* sources = sources_      + x * rows_;
+
+            const size_t column = grid_.index(x + 1, 1);
+
+            for (size_t y = 0; y < rows_; y++)
+            {
+                const size_t cell = column + y;
+
+                double source = 0;
+
+                if (x == 0)            source += temperatures[cell - grid_.pitch];
+                if (x == columns_ - 1) source += temperatures[cell + grid_.pitch];
+                if (y == 0)            source += temperatures[cell - 1];
+                if (y == rows_ - 1)    source += temperatures[cell + 1];
+
+                values [y] = temperatures[cell];
+                sources[y] = rate * source;
+            }
+
+            Fft::Complex* line     = lines;
+            Fft::Complex* spectrum = lines + lineLength_;
+
+            extend(line, values, sources, rows_, 1);
+
+            columnFft_.transform(line, spectrum, lines + 2 * lineLength_);
+
+            for (size_t k = 0; k < rows_; k++)
+            {
+                values [k] = -spectrum[k + 1].imag() / 2;
+                sources[k] =  spectrum[k + 1].real() / 2;
+            }
+        }
+
+        // Rows row and row + 1 of the column coefficients: transformed along x, advanced by time
+        // and transformed back (with both inverse scales), the two rows sharing the way back:
+        template <typename Real>
+        void Spectral<Real>::evolveRows(const double rate, const double time, const size_t row, Fft::Complex* lines)
+        {
+            Fft::Complex* line     = lines;
+            Fft::Complex* spectrum = lines + lineLength_;
+            Fft::Complex* scratch  = lines + 2 * lineLength_;
+
+            const double scale = 4.0 / ((columns_ + 1) * (rows_ + 1));
+
+            const size_t count = (row + 1 < rows_)? 2 : 1;
+
+            for (size_t r = 0; r < count; r++)
+            {
+                const size_t k = row + r;
+
+                extend(line, coefficients_ + k, sources_ + k, columns_, rows_);
+
+                rowFft_.transform(line, spectrum, scratch);
+
+                const double rowSine = sin(M_PI * (k + 1) / (2 * (rows_ + 1)));
+
+                for (size_t j = 0; j < columns_; j++)
+                {
+                    const double columnSine = sin(M_PI * (j + 1) / (2 * (columns_ + 1)));
+
+                    const double lambda = -rate * 4 * (columnSine * columnSine + rowSine * rowSine);
+                    const double growth = expm1(lambda * time);
+
+                    const double value  = -spectrum[j + 1].imag() / 2;
+                    const double source =  spectrum[j + 1].real() / 2;
+
+                    // The next row's coefficients wait in the sources of this one:
+                    sources_[j * rows_ + k] = scale * (value * (1 + growth) + source * growth / lambda);
+                }
+            }
+
+            extend(line, sources_ + row, (count == 2)? sources_ + row + 1 : nullptr, columns_, rows_);
+
+            rowFft_.transform(line, spectrum, scratch);
+
+            for (size_t j = 0; j < columns_; j++)
+            {
+                coefficients_[j * rows_ + row] = -spectrum[j + 1].imag() / 2;
+
+                if (count == 2) coefficients_[j * rows_ + row + 1] = spectrum[j + 1].real() / 2;
+            }
+        }
+
+        // Inner columns x and x + 1 back from their sine coefficients along y:
+        template <typename Real>
+        void Spectral<Real>::inverseColumns(Real* temperatures, const size_t x, Fft::Complex* lines)
+        {
+            const bool pair = (x + 1 < columns_);
+
+            Fft::Complex* line     = lines;
+            Fft::Complex* spectrum = lines + lineLength_;
+
+            extend(line, coefficients_ + x * rows_, (pair)? coefficients_ + (x + 1) * rows_ : nullptr, rows_, 1);
+
+            columnFft_.transform(line, spectrum, lines + 2 * lineLength_);
+
+            const size_t column = grid_.index(x + 1, 1);
+
+            for (size_t y = 0; y < rows_; y++)
+            {
+                temperatures[column + y] = (Real) (-spectrum[y + 1].imag() / 2);
+
+                if (pair) temperatures[column + grid_.pitch + y] = (Real) (spectrum[y + 1].real() / 2);
+            }
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
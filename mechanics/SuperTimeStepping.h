@@ -0,0 +1,271 @@
+#pragma once
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // Longer steps are split into several super steps, rounding grows with the stages:
+    const unsigned int SUPER_STEP_MAX_STAGES = 64;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ SuperTimeStepping
+//----------------------------------------------------------------------------
+
+    // Second order Runge-Kutta-Legendre super steps (RKL2, Meyer, Balsara & Aslam 2014).
+    // A step tau of s stages is stable up to tau = dtExplicit * (s^2 + s - 2) / 4, so the cost
+    // grows as the square root of the step instead of linearly. With L the explicit operator
+    // (tau L Y = scale * weight * lap Y) the stages are
+    //     Y1 = Y0 + mu~1 tau L Y0,
+    //     Yj = mu_j Y(j-1) + nu_j Y(j-2) + (1 - mu_j - nu_j) Y0 + mu~j tau L Y(j-1) + gamma~j tau L Y0,
+    // and Ys is the new field. Every stage is a Jacobi-like sweep, split into bands of columns.
+    //
+    // Cells with zero weight see no operator, so their stages would be affine combinations of equal
+    // values, but with the coefficients rounded to Real those only sum to 1 within an ulp and fixed
+    // temperatures would drift a little every stage; the stages copy them from Y0 instead.
+
+    template <typename Real>
+    class SuperTimeStepping
+    {
+        public:
+
+            // Constructor && destructor:
+
+                explicit SuperTimeStepping(const GridLayout& grid);
+
+                ~SuperTimeStepping();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Stepping:
+
+                    // Stages a step of ratio times the explicit stability limit needs (at least 2):
+                    static unsigned int stages(const double ratio);
+
+                    // next receives a step of `stages` stages from current, weights * scale being tau L's weights:
+                    void step(const Real* current, Real* next, const Real* weights, const double scale, const unsigned int stages, ThreadPool* pool);
+
+        private:
+
+            struct Sweep
+            {
+                SuperTimeStepping* sts;
+                const Real*        current;
+                Real*              next;
+                const Real*        weights;
+                Real               scale;
+                unsigned int       stages;
+                ThreadPool*        pool;
+            };
+
+            GridLayout grid_;
+
+            // tau L Y0, needed by every stage:
+            Real* operator_;
+
+            // Stages 1 .. s - 1 alternate between these (Yj overwrites Y(j-2) cell by cell):
+            Real* stages_[2];
+
+            // b_j of the stage coefficients:
+            static double legendre(const unsigned int j);
+
+            void stage(const Sweep* sweep, const unsigned int j, const size_t start, const size_t finish);
+
+            static void sweepTask(void* sweep, const unsigned int worker, const unsigned int workers);
+
+            SuperTimeStepping(const SuperTimeStepping&);
+            SuperTimeStepping& operator=(const SuperTimeStepping&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        SuperTimeStepping<Real>::SuperTimeStepping(const GridLayout& grid) :
+            grid_     (grid),
+            operator_ (nullptr),
+            stages_   ()
+        {
+            // Creating arrays:
+
+                operator_  = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+                stages_[0] = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+                stages_[1] = (Real*) alignedCalloc(grid_.cells, sizeof(Real));
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        SuperTimeStepping<Real>::~SuperTimeStepping()
+        {
+            assert(ok());
+
+            alignedFree(operator_);
+            alignedFree(stages_[0]);
+            alignedFree(stages_[1]);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        bool SuperTimeStepping<Real>::ok() const
+        {
+            bool everythingOk = true;
+
+            if (operator_ == nullptr || stages_[0] == nullptr || stages_[1] == nullptr)
+            {
+                everythingOk = false;
+                printf("SuperTimeStepping::ok(): Stage arrays are null pointers.");
+            }
+
+            return everythingOk;
+        }
+
+        // The smallest s with (s^2 + s - 2) / 4 >= ratio:
+        template <typename Real>
+        unsigned int SuperTimeStepping<Real>::stages(const double ratio)
+        {
+            assert(ratio >= 0);
+
+            const unsigned int stages = (unsigned int) ceil((sqrt(9 + 16 * ratio) - 1) / 2);
+
+            return (stages < 2)? 2 : stages;
+        }
+
+        template <typename Real>
+        void SuperTimeStepping<Real>::step(const Real* current, Real* next, const Real* weights, const double scale, const unsigned int stages, ThreadPool* pool)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(current && next && weights);
+
+                assert(scale > 0);
+                assert(stages >= 2);
+
+            // Main algorithm:
+
+                Sweep sweep = {this, current, next, weights, (Real) scale, stages, pool};
+
+                if (pool != nullptr) pool->run(sweepTask, &sweep);
+                else                 sweepTask(&sweep, 0, 1);
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        double SuperTimeStepping<Real>::legendre(const unsigned int j)
+        {
+            return (j < 2)? 1.0 / 3 : ((double) j * j + j - 2) / (2.0 * j * (j + 1));
+        }
+
+        // Stage j reads neighbours of Y(j-1) across the bands, so stages are separated by barriers:
+        template <typename Real>
+        void SuperTimeStepping<Real>::sweepTask(void* sweep, const unsigned int worker, const unsigned int workers)
+        {
+            Sweep*             stsSweep = (Sweep*) sweep;
+            SuperTimeStepping* self     = stsSweep->sts;
+
+            const size_t start  = self->grid_.width *  worker      / workers;
+            const size_t finish = self->grid_.width * (worker + 1) / workers;
+
+            for (unsigned int j = 1; j <= stsSweep->stages; j++)
+            {
+                if (j > 1 && stsSweep->pool != nullptr) stsSweep->pool->barrier();
+
+                self->stage(stsSweep, j, start, finish);
+            }
+        }
+
+        // Columns [start, finish) of stage j, with b_j = (j^2 + j - 2) / (2 j (j + 1)) (b_0 = b_1 = 1/3),
+        //     mu_j = (2j - 1)/j b_j/b(j-1),  nu_j = -(j - 1)/j b_j/b(j-2),
+        //     mu~j = mu_j w1,  gamma~j = -(1 - b(j-1)) mu~j,  w1 = 4 / (s^2 + s - 2):
+        template <typename Real>
+        void SuperTimeStepping<Real>::stage(const Sweep* sweep, const unsigned int j, const size_t start, const size_t finish)
+        {
+            const size_t pitch  = grid_.pitch;
+            const size_t height = grid_.height;
+
+            const unsigned int s = sweep->stages;
+
+            const double w1 = 4.0 / (s * s + s - 2);
+
+            const Real* initial = sweep->current;
+            const Real* weights = sweep->weights;
+            const Real  scale   = sweep->scale;
+
+            Real* output = (j == s)? sweep->next : stages_[j % 2];
+
+            if (j == 1)
+            {
+                const Real muTilde = (Real) (legendre(1) * w1);
+
+                for (size_t x = start; x < finish; x++)
+                {
+                    const size_t column = grid_.index(x, 0);
+
+                    for (size_t cell = column; cell < column + height; cell++)
+                    {
+                        const Real laplacian = initial[cell - pitch] + initial[cell + pitch] + initial[cell - 1] + initial[cell + 1] - 4 * initial[cell];
+
+                        operator_[cell] = scale * weights[cell] * laplacian;
+                        output   [cell] = initial[cell] + muTilde * operator_[cell];
+                    }
+                }
+
+                return;
+            }
+
+            const double mu = (2.0 * j - 1) / j * legendre(j) / legendre(j - 1);
+            const double nu = -(j - 1.0) / j    * legendre(j) / legendre(j - 2);
+
+            const Real muPrevious = (Real) mu;
+            const Real nuPrevious = (Real) nu;
+            const Real muInitial  = (Real) (1 - mu - nu);
+            const Real muTilde    = (Real) (mu * w1);
+            const Real gammaTilde = (Real) (-(1 - legendre(j - 1)) * mu * w1);
+
+            const Real* previous = stages_[(j - 1) % 2];
+            const Real* older    = (j == 2)? initial : stages_[j % 2];
+
+            for (size_t x = start; x < finish; x++)
+            {
+                const size_t column = grid_.index(x, 0);
+
+                for (size_t cell = column; cell < column + height; cell++)
+                {
+                    const Real laplacian = previous[cell - pitch] + previous[cell + pitch] + previous[cell - 1] + previous[cell + 1] - 4 * previous[cell];
+
+                    const Real stage = muPrevious * previous[cell] + nuPrevious * older[cell] + muInitial * initial[cell] +
+                                       muTilde * scale * weights[cell] * laplacian + gammaTilde * operator_[cell];
+
+                    output[cell] = (weights[cell] != 0)? stage : initial[cell];
+                }
+            }
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
@@ -0,0 +1,344 @@
+#pragma once
+
+
+//----------------------------------------------------------------------------
+//{ Defines (typedefs)
+//----------------------------------------------------------------------------
+
+    // A task runs once on every worker; worker 0 is the thread that called ThreadPool::run():
+    typedef void (*PoolTask)(void* context, const unsigned int worker, const unsigned int workers);
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // Busy waits spin this many times before sleeping on an event or yielding the core:
+    const unsigned int POOL_SPIN_COUNT = 20000;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Additional functions
+//----------------------------------------------------------------------------
+
+    unsigned int hardwareThreads()
+    {
+        SYSTEM_INFO info = {};
+        GetSystemInfo(&info);
+
+        return (info.dwNumberOfProcessors > 0)? info.dwNumberOfProcessors : 1;
+    }
+
+    // Full-barrier read of a counter shared between threads:
+    inline LONG atomicRead(volatile LONG* value)
+    {
+        return InterlockedCompareExchange(value, 0, 0);
+    }
+
+    // One iteration of a busy wait; gives the core away once spinning got long
+    // (more workers than cores must not starve the thread being waited for):
+    inline void spinWait(unsigned int* spins)
+    {
+        if (*spins < POOL_SPIN_COUNT)
+        {
+            (*spins)++;
+            YieldProcessor();
+        }
+        else
+        {
+            SwitchToThread();
+        }
+    }
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ ThreadPool
+//----------------------------------------------------------------------------
+
+    // Persistent workers for per-step parallel sweeps: no thread is created after the constructor,
+    // and between steps workers spin briefly before sleeping, so back-to-back steps do not pay
+    // for a wake-up.
+
+    class ThreadPool
+    {
+        public:
+
+            // Constructor && destructor:
+
+                explicit ThreadPool(const unsigned int workers);
+
+                ~ThreadPool();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Running tasks:
+
+                    void run(PoolTask task, void* context);
+
+                    // Blocks until every worker of the current task has reached it:
+                    void barrier();
+
+                    unsigned int size() const;
+
+        private:
+
+            struct WorkerStart
+            {
+                ThreadPool*  pool;
+                unsigned int worker;
+            };
+
+            static DWORD WINAPI workerMain(LPVOID start);
+
+            void waitForTask(const unsigned int worker, LONG* seenGeneration);
+
+            HANDLE* threads_;
+            HANDLE* wakeEvents_;
+
+            WorkerStart* starts_;
+
+            unsigned int workers_;
+
+            PoolTask task_;
+            void*    context_;
+
+            volatile LONG generation_;
+            volatile LONG sleeping_;
+            volatile LONG remaining_;
+
+            volatile LONG barrierCount_;
+            volatile LONG barrierSense_;
+
+            volatile LONG quit_;
+
+            ThreadPool(const ThreadPool&);
+            ThreadPool& operator=(const ThreadPool&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        ThreadPool::ThreadPool(const unsigned int workers) :
+            threads_      (nullptr),
+            wakeEvents_   (nullptr),
+            starts_       (nullptr),
+            workers_      ((workers > 0)? workers : 1),
+            task_         (nullptr),
+            context_      (nullptr),
+            generation_   (0),
+            sleeping_     (0),
+            remaining_    (0),
+            barrierCount_ (0),
+            barrierSense_ (0),
+            quit_         (0)
+        {
+            // Creating resources (worker 0 is the caller, it has no thread):
+
+                threads_ = (HANDLE*) calloc(workers_, sizeof(*threads_));
+                assert(threads_);
+
+                wakeEvents_ = (HANDLE*) calloc(workers_, sizeof(*wakeEvents_));
+                assert(wakeEvents_);
+
+                starts_ = (WorkerStart*) calloc(workers_, sizeof(*starts_));
+                assert(starts_);
+
+            // Starting workers:
+
+                for (unsigned int worker = 1; worker < workers_; worker++)
+                {
+                    wakeEvents_[worker] = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+                    assert(wakeEvents_[worker]);
+
+                    starts_[worker].pool   = this;
+                    starts_[worker].worker = worker;
+
+                    threads_[worker] = CreateThread(nullptr, 0, workerMain, &starts_[worker], 0, nullptr);
+                    assert(threads_[worker]);
+                }
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        ThreadPool::~ThreadPool()
+        {
+            assert(ok());
+
+            InterlockedExchange(&quit_, 1);
+            InterlockedIncrement(&generation_);
+
+            for (unsigned int worker = 1; worker < workers_; worker++)
+            {
+                SetEvent(wakeEvents_[worker]);
+            }
+
+            for (unsigned int worker = 1; worker < workers_; worker++)
+            {
+                WaitForSingleObject(threads_[worker], INFINITE);
+
+                CloseHandle(threads_[worker]);
+                CloseHandle(wakeEvents_[worker]);
+            }
+
+            free(threads_);
+            free(wakeEvents_);
+            free(starts_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        bool ThreadPool::ok() const
+        {
+            bool everythingOk = true;
+
+            if (threads_ == nullptr || wakeEvents_ == nullptr || starts_ == nullptr)
+            {
+                everythingOk = false;
+                printf("ThreadPool::ok(): Worker arrays are null pointers.");
+            }
+
+            for (unsigned int worker = 1; everythingOk && worker < workers_; worker++)
+            {
+                if (threads_[worker] == nullptr || wakeEvents_[worker] == nullptr)
+                {
+                    everythingOk = false;
+                    printf("ThreadPool::ok(): Worker %d was not started.", worker);
+                }
+            }
+
+            return everythingOk;
+        }
+
+        unsigned int ThreadPool::size() const
+        {
+            return workers_;
+        }
+
+        void ThreadPool::run(PoolTask task, void* context)
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(task);
+
+            // Main algorithm:
+
+                task_    = task;
+                context_ = context;
+
+                InterlockedExchange(&remaining_, workers_ - 1);
+
+                // Publishing the task (Interlocked* are full barriers):
+                InterlockedIncrement(&generation_);
+
+                if (atomicRead(&sleeping_) > 0)
+                {
+                    for (unsigned int worker = 1; worker < workers_; worker++)
+                    {
+                        SetEvent(wakeEvents_[worker]);
+                    }
+                }
+
+                task(context, 0, workers_);
+
+                unsigned int spins = 0;
+
+                while (atomicRead(&remaining_) > 0)
+                {
+                    spinWait(&spins);
+                }
+        }
+
+        void ThreadPool::barrier()
+        {
+            if (workers_ == 1) return;
+
+            LONG sense = atomicRead(&barrierSense_);
+
+            if (InterlockedIncrement(&barrierCount_) == (LONG) workers_)
+            {
+                InterlockedExchange(&barrierCount_, 0);
+                InterlockedExchange(&barrierSense_, !sense);
+            }
+            else
+            {
+                unsigned int spins = 0;
+
+                while (atomicRead(&barrierSense_) == sense)
+                {
+                    spinWait(&spins);
+                }
+            }
+        }
+
+        void ThreadPool::waitForTask(const unsigned int worker, LONG* seenGeneration)
+        {
+            for (unsigned int spin = 0; spin < POOL_SPIN_COUNT; spin++)
+            {
+                if (atomicRead(&generation_) != *seenGeneration) break;
+
+                YieldProcessor();
+            }
+
+            while (atomicRead(&generation_) == *seenGeneration)
+            {
+                InterlockedIncrement(&sleeping_);
+
+                // Re-checking after announcing ourselves, so a run() in between cannot be missed:
+                if (atomicRead(&generation_) == *seenGeneration) WaitForSingleObject(wakeEvents_[worker], INFINITE);
+
+                InterlockedDecrement(&sleeping_);
+            }
+
+            *seenGeneration = atomicRead(&generation_);
+        }
+
+        DWORD WINAPI ThreadPool::workerMain(LPVOID start)
+        {
+            ThreadPool*  pool   = ((WorkerStart*) start)->pool;
+            unsigned int worker = ((WorkerStart*) start)->worker;
+
+            LONG seenGeneration = 0;
+
+            while (true)
+            {
+                pool->waitForTask(worker, &seenGeneration);
+
+                if (atomicRead(&pool->quit_)) break;
+
+                pool->task_(pool->context_, worker, pool->workers_);
+
+                InterlockedDecrement(&pool->remaining_);
+            }
+
+            return 0;
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
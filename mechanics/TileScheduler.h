@@ -0,0 +1,151 @@
+#pragma once
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // Shares are padded to a cache line so owners and thieves do not false-share:
+    const size_t SCHEDULER_LINE = 64;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ TileScheduler
+//----------------------------------------------------------------------------
+
+    // Hands out the tasks 0 .. count - 1 of one sweep to the workers of a ThreadPool.
+    // Every worker first takes tasks from its own contiguous share, and once that is empty
+    // steals the remaining tasks of the other workers' shares, so a few expensive tiles
+    // do not leave the rest of the pool idle.
+
+    class TileScheduler
+    {
+        public:
+
+            // Constructor && destructor:
+
+                explicit TileScheduler(const unsigned int workers);
+
+                ~TileScheduler();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Scheduling:
+
+                    // Called by one thread before the workers start:
+                    void reset(const size_t count);
+
+                    // Claims the next task for worker, false when the sweep is finished:
+                    bool next(const unsigned int worker, size_t* task);
+
+        private:
+
+            // Owners and thieves claim a task with one increment of next:
+            struct Share
+            {
+                volatile LONG next;
+                LONG          finish;
+
+                char padding[SCHEDULER_LINE - 2 * sizeof(LONG)];
+            };
+
+            Share* shares_;
+
+            unsigned int workers_;
+
+            TileScheduler(const TileScheduler&);
+            TileScheduler& operator=(const TileScheduler&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        TileScheduler::TileScheduler(const unsigned int workers) :
+            shares_  (nullptr),
+            workers_ ((workers > 0)? workers : 1)
+        {
+            shares_ = (Share*) _aligned_malloc(workers_ * sizeof(*shares_), SCHEDULER_LINE);
+            assert(shares_);
+
+            memset(shares_, 0, workers_ * sizeof(*shares_));
+
+            assert(ok());
+        }
+
+        TileScheduler::~TileScheduler()
+        {
+            assert(ok());
+
+            _aligned_free(shares_);
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        bool TileScheduler::ok() const
+        {
+            bool everythingOk = true;
+
+            if (shares_ == nullptr)
+            {
+                everythingOk = false;
+                printf("TileScheduler::ok(): Shares array is a null pointer.");
+            }
+
+            return everythingOk;
+        }
+
+        void TileScheduler::reset(const size_t count)
+        {
+            assert(ok());
+
+            for (unsigned int worker = 0; worker < workers_; worker++)
+            {
+                shares_[worker].next   = count *  worker      / workers_;
+                shares_[worker].finish = count * (worker + 1) / workers_;
+            }
+        }
+
+        bool TileScheduler::next(const unsigned int worker, size_t* task)
+        {
+            assert(worker < workers_);
+            assert(task);
+
+            // Own share first, then the others starting from the neighbour:
+            for (unsigned int offset = 0; offset < workers_; offset++)
+            {
+                Share* share = &shares_[(worker + offset) % workers_];
+
+                if (atomicRead(&share->next) >= share->finish) continue;
+
+                LONG claimed = InterlockedIncrement(&share->next) - 1;
+
+                if (claimed < share->finish)
+                {
+                    *task = claimed;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------
@@ -0,0 +1,482 @@
+#pragma once
+
+#include "Classes.h"
+
+
+//----------------------------------------------------------------------------
+//{ Constants
+//----------------------------------------------------------------------------
+
+    // Columns of a slab of the volume layout: three planes of a slab (the working set of a sweep)
+    // take 3 * 16 * (height + padding) cells, 100 KB in double for 256 rows, so they stay in L2:
+    const size_t VOLUME_SLAB_WIDTH = 16;
+
+//}
+//----------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+//{ Volume
+//----------------------------------------------------------------------------
+
+    // A 3D Field: the scene is a stack of depth obstacle and conductivity maps, one per z layer,
+    // and every step is the 7-point stencil with weights conductivity * timeStep / SPACE_STEP^2
+    // (stable while they stay below 1/6). Walls hold zero, borders and the outermost cells of the
+    // volume are fixed, exactly like in Field.
+    //
+    // Layout: the volume is cut into slabs of VOLUME_SLAB_WIDTH columns along x, and a slab holds
+    // its planes one after another, each plane being its columns in the padded layout of a Field
+    // column (contiguous y, aligned upper ghosts). A sweep walks a slab plane by plane, streaming
+    // through memory while the three planes it reads stay in cache, and the workers take whole slabs.
+    // Neighbouring columns across slabs or planes are found by index(), so the kernel gets them as
+    // pointers (see volumeScalar()), and the ghosts around the volume are one column of zeros.
+
+    template <typename Real>
+    class Volume
+    {
+        public:
+
+            // Constructor && destructor:
+
+                // Layer z is read from the file the pattern names with printf(pattern, z)
+                // ("resources/obstacles/part-%d.bmp"); a name without %d extrudes one map:
+                Volume(const char* conductivitiesPattern,
+                       const char*      obstaclesPattern,
+                       const size_t width,
+                       const size_t height,
+                       const size_t depth,
+                       const double wallConditions,
+                       const double emptySpaceConditions);
+
+                ~Volume();
+
+            // Functions:
+
+                // Debugging:
+
+                    bool ok() const;
+
+                // Setting conditions:
+
+                    // Adds deltaTemperature to the empty cells of a ball, like Field::adjustTemperature() to a disk:
+                    void adjustTemperature(const unsigned int roundX, const unsigned int roundY, const unsigned int roundZ, const unsigned int radius, const double deltaTemperature);
+
+                // Calculations:
+
+                    void calculate();
+                    void calculate(const unsigned int steps);
+
+                    // The largest stable step (every weight at most 1/6) and the step taken, TIME_STEP unless that is unstable:
+                    double stableTimeStep() const;
+                    double timeStep() const;
+
+                    // 1 (the default) calculates on the calling thread only:
+                    void setThreads(const unsigned int threads);
+
+                    Real temperature(const size_t x, const size_t y, const size_t z) const;
+
+                // Rendering:
+
+                    // The layer z, walls black and cold cells grey by conductivity:
+                    void render(const size_t z, const unsigned int zoom = 1) const;
+
+        private:
+
+            char* obstacles_;
+
+            // conductivity * timeStep_ / SPACE_STEP^2 for empty cells, 0 for walls and borders:
+            Real* weights_;
+
+            // Two buffers swapped by calculate():
+            Real* temperatures_;
+            Real* nextTemperatures_;
+
+            // The ghost column around the volume, zero temperature:
+            Real* zeros_;
+
+            double timeStep_;
+            double stableTimeStep_;
+
+            VolumeKernel<Real> kernel_;
+
+            ThreadPool* pool_;
+
+            size_t  width_;
+            size_t height_;
+            size_t  depth_;
+
+            // Column pitch, cells above (x, 0, z) in a column, cells of a slab and of the volume:
+            size_t  pitch_;
+            size_t  top_;
+            size_t  slabs_;
+            size_t  slabCells_;
+            size_t  cells_;
+
+            inline size_t index(const size_t x, const size_t y, const size_t z) const;
+
+            void sweepSlabs(const size_t start, const size_t finish);
+
+            static void sweepSlabsTask(void* volume, const unsigned int worker, const unsigned int workers);
+
+            Volume(const Volume&);
+            Volume& operator=(const Volume&);
+    };
+
+
+    //----------------------------------------------------------------------------
+    //{ Constructor && destructor:
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        Volume<Real>::Volume(const char* conductivitiesPattern,
+                             const char*      obstaclesPattern,
+                             const size_t width,
+                             const size_t height,
+                             const size_t depth,
+                             const double wallConditions,
+                             const double emptySpaceConditions) :
+            obstacles_        (nullptr),
+            weights_          (nullptr),
+            temperatures_     (nullptr),
+            nextTemperatures_ (nullptr),
+            zeros_            (nullptr),
+            timeStep_         (TIME_STEP),
+            stableTimeStep_   (HUGE_VAL),
+            kernel_           (volumeKernel<Real>(stencilIsa())),
+            pool_             (nullptr),
+            width_            (width),
+            height_           (height),
+            depth_            (depth),
+            pitch_            (paddedLayout(1, height, sizeof(Real)).pitch),
+            top_              (GRID_ALIGNMENT / sizeof(Real)),
+            slabs_            ((width + VOLUME_SLAB_WIDTH - 1) / VOLUME_SLAB_WIDTH),
+            slabCells_        (depth * VOLUME_SLAB_WIDTH * pitch_),
+            cells_            (slabs_ * slabCells_)
+        {
+            // Checking input:
+
+                assert(conductivitiesPattern != nullptr);
+                assert(obstaclesPattern != nullptr);
+
+                assert(width > 2 && height > 2 && depth > 2);
+
+            // Creating arrays (cells outside the volume are zero-temperature walls):
+
+                obstacles_ = (char*) alignedCalloc(cells_, sizeof(*obstacles_));
+                memset(obstacles_, WALL_TILE, cells_ * sizeof(*obstacles_));
+
+                weights_          = (Real*) alignedCalloc(cells_, sizeof(*weights_));
+                temperatures_     = (Real*) alignedCalloc(cells_, sizeof(*temperatures_));
+                nextTemperatures_ = (Real*) alignedCalloc(cells_, sizeof(*nextTemperatures_));
+
+                zeros_ = (Real*) alignedCalloc(pitch_, sizeof(*zeros_));
+
+            // Filling the layers (weights_ holds the conductivities until the step is known):
+
+                for (size_t z = 0; z < depth_; z++)
+                {
+                    char obstaclesName     [FILENAME_MAX] = "";
+                    char conductivitiesName[FILENAME_MAX] = "";
+
+                    snprintf(obstaclesName,      sizeof(obstaclesName),      obstaclesPattern,      (int) z);
+                    snprintf(conductivitiesName, sizeof(conductivitiesName), conductivitiesPattern, (int) z);
+
+                    HDC obstaclesMap      = txLoadImage(obstaclesName);
+                    HDC conductivitiesMap = txLoadImage(conductivitiesName);
+
+                    assert(obstaclesMap && conductivitiesMap);
+
+                    for (size_t x = 0; x < width_; x++)
+                    {
+                        for (size_t y = 0; y < height_; y++)
+                        {
+                            const size_t cell = index(x, y, z);
+
+                            COLORREF currentColor = GetPixel(obstaclesMap, x, y);
+
+                            obstacles_[cell] = (currentColor == RGB(  0, 0, 0))?   WALL_TILE :
+                                               (currentColor == RGB(255, 0, 0))? BORDER_TILE :
+                                                                                  EMPTY_TILE;
+
+                            // The outermost cells are fixed, like the frame of a Field:
+                            bool edge = (x == 0 || y == 0 || z == 0 || x == width_ - 1 || y == height_ - 1 || z == depth_ - 1);
+
+                            if (edge && obstacles_[cell] == EMPTY_TILE) obstacles_[cell] = BORDER_TILE;
+
+                            weights_[cell] = (Real) (THERMAL_CONDUCTIVITY_COEFFICIENT * lerp(0.0, 1.0, (double) txExtractColor(GetPixel(conductivitiesMap, x, y), TX_RED) / 255));
+
+                            if (obstacles_[cell] == EMPTY_TILE && weights_[cell] > 0)
+                            {
+                                stableTimeStep_ = std::min(stableTimeStep_, SPACE_STEP * SPACE_STEP / (6 * weights_[cell]));
+                            }
+                        }
+                    }
+
+                    txDeleteDC(obstaclesMap);
+                    txDeleteDC(conductivitiesMap);
+                }
+
+            // Compiling scene and filling temperatures:
+
+                if (timeStep_ > stableTimeStep_) timeStep_ = stableTimeStep_;
+
+                for (size_t z = 0; z < depth_; z++)
+                {
+                    for (size_t x = 0; x < width_; x++)
+                    {
+                        for (size_t y = 0; y < height_; y++)
+                        {
+                            const size_t cell = index(x, y, z);
+
+                            const char tile = obstacles_[cell];
+
+                            weights_[cell] = (tile == EMPTY_TILE)? (Real) (weights_[cell] * timeStep_ / (SPACE_STEP * SPACE_STEP)) : 0;
+
+                            temperatures_[cell] = (tile ==   WALL_TILE)? 0 :
+                                                  (tile == BORDER_TILE)? (Real) wallConditions :
+                                                                         (Real) emptySpaceConditions;
+                        }
+                    }
+                }
+
+                // Cells that calculate() never changes must be equal in both buffers:
+                memcpy(nextTemperatures_, temperatures_, cells_ * sizeof(*temperatures_));
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        Volume<Real>::~Volume()
+        {
+            assert(ok());
+
+            alignedFree(obstacles_);
+            alignedFree(weights_);
+
+            alignedFree(temperatures_);
+            alignedFree(nextTemperatures_);
+
+            alignedFree(zeros_);
+
+            delete pool_;
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+
+    //----------------------------------------------------------------------------
+    //{ Functions
+    //----------------------------------------------------------------------------
+
+        template <typename Real>
+        bool Volume<Real>::ok() const
+        {
+            bool everythingOk = true;
+
+            if (obstacles_ == nullptr || weights_ == nullptr || zeros_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Volume::ok(): Scene arrays are null pointers.");
+            }
+
+            if (temperatures_ == nullptr || nextTemperatures_ == nullptr)
+            {
+                everythingOk = false;
+                printf("Volume::ok(): Temperature buffers are null pointers.");
+            }
+
+            if (pitch_ < top_ + height_ + 1 || slabs_ * VOLUME_SLAB_WIDTH < width_)
+            {
+                everythingOk = false;
+                printf("Volume::ok(): Layout %dx%d of %d slabs does not hold %dx%d.", pitch_, slabCells_, slabs_, width_, height_);
+            }
+
+            return everythingOk;
+        }
+
+        template <typename Real>
+        inline size_t Volume<Real>::index(const size_t x, const size_t y, const size_t z) const
+        {
+            return (x / VOLUME_SLAB_WIDTH) * slabCells_ + (z * VOLUME_SLAB_WIDTH + x % VOLUME_SLAB_WIDTH) * pitch_ + top_ + y;
+        }
+
+        template <typename Real>
+        void Volume<Real>::adjustTemperature(const unsigned int roundX, const unsigned int roundY, const unsigned int roundZ, const unsigned int radius, const double deltaTemperature)
+        {
+            // Checking input:
+
+                assert(ok());
+
+            // Creating resources:
+
+                const size_t start [3] = {(roundX < radius)? 0 : roundX - radius, (roundY < radius)? 0 : roundY - radius, (roundZ < radius)? 0 : roundZ - radius};
+                const size_t finish[3] = {std::min((size_t) roundX + radius + 1, width_), std::min((size_t) roundY + radius + 1, height_), std::min((size_t) roundZ + radius + 1, depth_)};
+
+            // Main algorithm:
+
+                for (size_t z = start[2]; z < finish[2]; z++)
+                {
+                    for (size_t x = start[0]; x < finish[0]; x++)
+                    {
+                        for (size_t y = start[1]; y < finish[1]; y++)
+                        {
+                            const size_t cell = index(x, y, z);
+
+                            if (obstacles_[cell] != EMPTY_TILE) continue;
+
+                            if (pow((signed) roundX - (signed) x, 2) + pow((signed) roundY - (signed) y, 2) + pow((signed) roundZ - (signed) z, 2) < pow(radius, 2))
+                            {
+                                if  (temperatures_[cell] + deltaTemperature < 0) temperatures_[cell] = 0;
+                                else temperatures_[cell] += deltaTemperature;
+                            }
+                        }
+                    }
+                }
+        }
+
+        template <typename Real>
+        void Volume<Real>::calculate()
+        {
+            // Checking input:
+
+                assert(ok());
+
+            // Main algorithm:
+
+                if (pool_ != nullptr) pool_->run(sweepSlabsTask, this);
+                else                  sweepSlabs(0, slabs_);
+
+                Real* currentTemperatures = temperatures_;
+
+                temperatures_     = nextTemperatures_;
+                nextTemperatures_ = currentTemperatures;
+
+            // Checking output:
+
+                assert(ok());
+        }
+
+        template <typename Real>
+        void Volume<Real>::calculate(const unsigned int steps)
+        {
+            for (unsigned int step = 0; step < steps; step++) calculate();
+        }
+
+        template <typename Real>
+        double Volume<Real>::stableTimeStep() const
+        {
+            return stableTimeStep_;
+        }
+
+        template <typename Real>
+        double Volume<Real>::timeStep() const
+        {
+            return timeStep_;
+        }
+
+        template <typename Real>
+        void Volume<Real>::setThreads(const unsigned int threads)
+        {
+            assert(ok());
+            assert(threads > 0);
+
+            delete pool_;
+            pool_ = (threads > 1)? new ThreadPool(threads) : nullptr;
+        }
+
+        template <typename Real>
+        Real Volume<Real>::temperature(const size_t x, const size_t y, const size_t z) const
+        {
+            assert(x < width_ && y < height_ && z < depth_);
+
+            return temperatures_[index(x, y, z)];
+        }
+
+        // Slabs [start, finish), plane by plane:
+        template <typename Real>
+        void Volume<Real>::sweepSlabs(const size_t start, const size_t finish)
+        {
+            const Real* current = temperatures_;
+            const Real* zeros   = zeros_ + top_;
+
+            for (size_t slab = start; slab < finish; slab++)
+            {
+                const size_t firstX = slab * VOLUME_SLAB_WIDTH;
+                const size_t lastX  = std::min(firstX + VOLUME_SLAB_WIDTH, width_);
+
+                for (size_t z = 0; z < depth_; z++)
+                {
+                    for (size_t x = firstX; x < lastX; x++)
+                    {
+                        const size_t column = index(x, 0, z);
+
+                        const Real* left  = (x > 0)?          current + index(x - 1, 0, z) : zeros;
+                        const Real* right = (x + 1 < width_)? current + index(x + 1, 0, z) : zeros;
+                        const Real* front = (z > 0)?          current + index(x, 0, z - 1) : zeros;
+                        const Real* back  = (z + 1 < depth_)? current + index(x, 0, z + 1) : zeros;
+
+                        kernel_(nextTemperatures_ + column, current + column, left, right, front, back, weights_ + column, height_);
+                    }
+                }
+            }
+        }
+
+        template <typename Real>
+        void Volume<Real>::sweepSlabsTask(void* volume, const unsigned int worker, const unsigned int workers)
+        {
+            Volume* self = (Volume*) volume;
+
+            self->sweepSlabs(self->slabs_ *  worker      / workers,
+                             self->slabs_ * (worker + 1) / workers);
+        }
+
+        template <typename Real>
+        void Volume<Real>::render(const size_t z, const unsigned int zoom /*= 1*/) const
+        {
+            // Checking input:
+
+                assert(ok());
+                assert(z < depth_);
+
+            // Main algorithm:
+
+                txSetFillColor (TX_BLACK);
+                txClear();
+
+                // Weights back to conductivities relative to the coefficient:
+                const double scale = SPACE_STEP * SPACE_STEP / (timeStep_ * THERMAL_CONDUCTIVITY_COEFFICIENT);
+
+                for (size_t x = 0; x < width_; x++)
+                {
+                    for (size_t y = 0; y < height_; y++)
+                    {
+                        const size_t cell = index(x, y, z);
+
+                        const int grey = (int) (255 * std::min(1.0, weights_[cell] * scale));
+
+                        COLORREF currentColor = (obstacles_[cell] == WALL_TILE)? WALL_COLOR :
+                                                colorLerp(log(log(temperatures_[cell] + 1) + 1), RGB(grey, grey, grey), MID_COLOR, WARM_COLOR);
+
+                        if (zoom >= 3)
+                        {
+                            txSetColor    (currentColor);
+                            txSetFillColor(currentColor);
+
+                            txRectangle(x * zoom, y * zoom, (x + 1) * zoom, (y + 1) * zoom);
+                        }
+                        else
+                        {
+                            txSetPixel(x * zoom, y * zoom, currentColor);
+                        }
+                    }
+                }
+        }
+
+    //}
+    //----------------------------------------------------------------------------
+
+//}
+//----------------------------------------------------------------------------